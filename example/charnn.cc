@@ -18,7 +18,8 @@ int main()
     int num_epoch = 10;
     T learning_rate = 0.01;
     bool use_embedding = true;
-    RNN<T> model(seq_length, input_size, output_size, hidden_sizes, batch_size, num_epoch, learning_rate, "sgd", use_embedding);
+    bool stateful = true;
+    RNN<T> model(seq_length, input_size, output_size, hidden_sizes, batch_size, num_epoch, learning_rate, "sgd", use_embedding, stateful);
     
     model.add_train_dataset(article.get_input_sequence(), article.get_target_sequence());
     model.fit();
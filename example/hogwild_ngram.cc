@@ -0,0 +1,76 @@
+#include "galois/models.h"
+#include "galois/filters.h"
+#include "galois/dataset/chartxt.h"
+#include <string>
+
+using namespace std;
+using namespace gs;
+
+// predict the next char from an embedding of the hashed previous chars, the lookups touch few rows
+// of a large table, which suits lock free sgd. trains one epoch for each number of workers given
+// as arguments, 1, 2 and 4 by default, and reports the throughput of the training alone
+int main(int argc, char *argv[])
+{
+    using T = float;
+
+    chartxt::Article<T> article("./data/tinyshakespeare.txt");
+    auto chars = article.get_input_sequence();
+    auto next_chars = article.get_target_sequence();
+
+    size_t context = 3;
+    size_t num_buckets = 1 << 16;
+    size_t embedding_size = 32;
+    size_t num_chars = article.get_num_diff_chars();
+    size_t batch_size = 32;
+    T learning_rate = 0.1;
+
+    // hash of the context ending at every position
+    size_t count = chars->get_size() - context;
+    auto contexts = make_shared<NArray<T>>(count);
+    auto targets = make_shared<NArray<T>>(count);
+    for (size_t i = 0; i < count; i++) {
+        size_t h = 0;
+        for (size_t k = 0; k < context; k++) {
+            h = h * 131 + size_t(chars->get_data()[i+k]);
+        }
+        contexts->get_data()[i] = T(h % num_buckets);
+        targets->get_data()[i] = next_chars->get_data()[i+context-1];
+    }
+    size_t test_count = count / 10 / batch_size * batch_size;
+    size_t train_count = count - test_count;
+    auto train_contexts = contexts->slice(0, train_count);
+    auto train_targets = targets->slice(0, train_count);
+    auto test_contexts = contexts->slice(train_count, count);
+    auto test_targets = targets->slice(train_count, count);
+
+    vector<size_t> worker_counts{1, 2, 4};
+    if (argc > 1) {
+        worker_counts.clear();
+        for (int i = 1; i < argc; i++) {
+            worker_counts.push_back(stoul(argv[i]));
+        }
+    }
+
+    double base_throughput = 0;
+    for (auto num_workers : worker_counts) {
+        Model<T> model(batch_size, 1, learning_rate, "sgd");
+        model.add_link("contexts", "embedded", make_shared<Embedding<T>>(num_buckets, embedding_size));
+        model.add_link("embedded", "hidden", make_shared<Tanh<T>>());
+        model.add_link("hidden", "logits", make_shared<Linear<T>>(embedding_size, num_chars));
+        model.add_link("logits", "predictions", make_shared<CrossEntropy<T>>());
+        model.add_input_ids("contexts");
+        model.add_output_ids("predictions");
+        model.add_train_dataset(train_contexts, train_targets);
+        model.add_test_dataset(test_contexts, test_targets);
+        model.set_hogwild(num_workers);
+
+        printf("Workers: %zu\n", num_workers);
+        model.fit();
+        double throughput = train_count / batch_size * batch_size / model.get_train_seconds();
+        // speedup is over the first count given
+        if (base_throughput == 0) {
+            base_throughput = throughput;
+        }
+        printf("Throughput: %.0f samples/s, speedup: %.2f\n", throughput, throughput / base_throughput);
+    }
+}
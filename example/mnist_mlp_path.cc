@@ -14,8 +14,7 @@ int main()
     T learning_rate = 0.05;
     MLPModel<T> model(batch_size, num_epoch, learning_rate, "sgd");
 
-    model.add_filter(make_shared<Linear<T>>(28*28, 1024));
-    model.add_filter(make_shared<Tanh<T>>());
+    model.add_filter(make_shared<LinearTanh<T>>(28*28, 1024));
     model.add_filter(make_shared<Linear<T>>(1024, 10));
     model.add_filter(make_shared<CrossEntropy<T>>());
 
@@ -39,6 +39,8 @@ int main()
     model2.add_link("output", "predicitons", make_shared<CrossEntropy<T>>());
     model2.add_input_ids("images");
     model2.add_output_ids("predicitons");
+    // path1 is fixed and reads the images only, so its outputs are computed once per image
+    model2.enable_frozen_cache();
     model2.add_train_dataset(train_images, train_labels);
     model2.add_test_dataset(test_images, test_labels);
     model2.fit();
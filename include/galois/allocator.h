@@ -0,0 +1,106 @@
+#ifndef _GALOIS_ALLOCATOR_H_
+#define _GALOIS_ALLOCATOR_H_
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+namespace gs
+{
+
+    // counters of an allocator, bytes are counted as requested by the caller
+    struct AllocatorStats
+    {
+        size_t allocations = 0;         // calls of allocate
+        size_t deallocations = 0;       // calls of deallocate
+        size_t system_allocations = 0;  // allocations that went to the system
+        size_t pool_hits = 0;           // allocations served by a cached block
+        size_t bytes_in_use = 0;
+        size_t peak_bytes_in_use = 0;
+        size_t bytes_cached = 0;        // bytes of blocks kept for reuse
+    };
+
+    // storage policy of NArray, every block is aligned to ALIGNMENT bytes
+    // allocators are thread safe
+    class Allocator
+    {
+    public:
+        static const size_t ALIGNMENT = 64;
+
+        virtual ~Allocator() {}
+        virtual void* allocate(size_t bytes) = 0;
+        // bytes should be the same as those passed to allocate
+        virtual void deallocate(void *ptr, size_t bytes) = 0;
+        // give cached blocks back to the system
+        virtual void release() {}
+
+        AllocatorStats get_stats();
+        void reset_stats();
+
+    protected:
+        mutex m;
+        AllocatorStats stats;
+
+        void _count_allocation(size_t bytes);
+        void _count_deallocation(size_t bytes);
+    };
+    typedef shared_ptr<Allocator> SP_Allocator;
+
+    // aligned memory straight from the system, nothing is cached
+    class SystemAllocator : public Allocator
+    {
+    public:
+        void* allocate(size_t bytes) override;
+        void deallocate(void *ptr, size_t bytes) override;
+    };
+
+    // blocks are rounded up to size classes, four classes for each power of two from 64 bytes,
+    // so at most a quarter of a block is wasted. freed blocks stay in a list of their class and
+    // are handed out again, blocks larger than the largest class go to the system directly
+    class PoolAllocator : public Allocator
+    {
+    public:
+        static const size_t MAX_POOLED_BYTES = size_t(1) << 28;
+
+        PoolAllocator();
+        PoolAllocator(const PoolAllocator& other) = delete;
+        PoolAllocator& operator=(const PoolAllocator&) = delete;
+        ~PoolAllocator();
+
+        void* allocate(size_t bytes) override;
+        void deallocate(void *ptr, size_t bytes) override;
+        void release() override;
+
+        static size_t size_class(size_t bytes);
+        static size_t class_bytes(size_t cls);
+
+    private:
+        vector<vector<void*>> free_lists;
+    };
+
+    // every block is a shared map of an unlinked file in dir, so the kernel writes pages back to the file
+    // instead of swap and an array could be larger than memory, such as a cache of features
+    class MmapAllocator : public Allocator
+    {
+    public:
+        explicit MmapAllocator(const string &dir = "/tmp") : dir(dir) {}
+
+        void* allocate(size_t bytes) override;
+        void deallocate(void *ptr, size_t bytes) override;
+
+    private:
+        string dir;
+    };
+
+    // the allocator used by arrays constructed without one, it is a PoolAllocator unless
+    // the environment variable GALOIS_ALLOCATOR=system is set
+    SP_Allocator get_default_allocator();
+    void set_default_allocator(SP_Allocator allocator);
+
+}
+
+#endif
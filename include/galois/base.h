@@ -29,6 +29,13 @@ namespace gs
         SP_NArray<T> target = nullptr;
         shared_ptr<T> loss = nullptr;
 
+        // grad of an inner signal could be disabled when only forward propagation is needed
+        bool grad_enabled = true;
+
+        // own arrays of data and target while views are bound in their place
+        SP_NArray<T> unbound_data = nullptr;
+        SP_NArray<T> unbound_target = nullptr;
+
     public:
         Signal() = delete;
         explicit Signal(SignalType type) : type(type) {};
@@ -48,6 +55,13 @@ namespace gs
         SP_NArray<T>    get_target()    { return target;}
         shared_ptr<T>   get_loss()      { return loss;  }
 
+        void disable_grad() {
+            CHECK(!data, "grad should be disabled before initialization");
+            grad_enabled = false;
+        }
+        // only an inner signal with grad enabled has its grad written by backward
+        bool requires_grad() { return type == InnerSignal && grad_enabled; }
+
         void reopaque() {
             if (data)   { data->reopaque(); }
             if (grad)   { grad->reopaque(); }
@@ -60,17 +74,24 @@ namespace gs
         void set_data_dims(size_t m, size_t n, size_t o)            { set_data_dims({m,n,o}); }
         void set_data_dims(size_t m, size_t n, size_t o, size_t k)  { set_data_dims({m,n,o,k}); }
         void set_data_dims(initializer_list<size_t> nums) {
-            set_data_dims(vector<size_t>(nums));
+            set_data_dims(Shape(nums));
         }
-        void set_data_dims(vector<size_t> nums) {
+        void set_data_dims(const Shape &nums) {
             CHECK(!data, "data should be nullptr before initialization");
             data = make_shared<NArray<T>>(nums);
-            if (type == InnerSignal) {
+            if (type == InnerSignal && grad_enabled) {
                 CHECK(!grad, "grad should be nullptr before initialization");
                 grad = make_shared<NArray<T>>(nums);
             }
         }
-        vector<size_t> get_data_dims() {
+        // exchange data with an array of the same dimensions, such as a batch prepared in background
+        void swap_data(SP_NArray<T> &other) {
+            CHECK(type == InputSignal, "only data of InputSignal could be swapped");
+            CHECK(!unbound_data, "data should not be bound");
+            CHECK(data && other && data->get_dims() == other->get_dims(), "dimensions of data should match");
+            data.swap(other);
+        }
+        Shape get_data_dims() {
             CHECK(data, "data should be non-empty");
             return data->get_dims();
         }
@@ -80,17 +101,52 @@ namespace gs
         void set_target_dims(size_t m, size_t n, size_t o)           { set_target_dims({m,n,o}); }
         void set_target_dims(size_t m, size_t n, size_t o, size_t k)    { set_target_dims({m,n,o,k}); }
         void set_target_dims(initializer_list<size_t> nums) {
-            set_target_dims(vector<size_t>(nums));
+            set_target_dims(Shape(nums));
         }
-        void set_target_dims(vector<size_t> nums) {
+        void set_target_dims(const Shape &nums) {
             CHECK(type == OutputSignal, "only OutputSignal could set target");
             CHECK(!target, "target should be nullptr before initialization");
             target = make_shared<NArray<T>>(nums);
         }
-        vector<size_t> get_target_dims() {
+        void swap_target(SP_NArray<T> &other) {
+            CHECK(!unbound_target, "target should not be bound");
+            CHECK(target && other && target->get_dims() == other->get_dims(), "dimensions of target should match");
+            target.swap(other);
+        }
+        Shape get_target_dims() {
             CHECK(target, "target should be non-empty");
             return target->get_dims();
         }
+        // read a view, such as a slice of a dataset, as data or target instead of copying it, it is
+        // seen as written, and the own array comes back with unbind
+        void bind_data(const SP_NArray<T> &view) {
+            CHECK(type == InputSignal, "only data of InputSignal could be bound");
+            CHECK(data && view && data->get_dims() == view->get_dims(), "dimensions of data should match");
+            if (!unbound_data) {
+                unbound_data = data;
+            }
+            data = view;
+            data->setclear();
+        }
+        void bind_target(const SP_NArray<T> &view) {
+            CHECK(type == OutputSignal, "only target of OutputSignal could be bound");
+            CHECK(target && view && target->get_dims() == view->get_dims(), "dimensions of target should match");
+            if (!unbound_target) {
+                unbound_target = target;
+            }
+            target = view;
+            target->setclear();
+        }
+        void unbind() {
+            if (unbound_data) {
+                data = unbound_data;
+                unbound_data = nullptr;
+            }
+            if (unbound_target) {
+                target = unbound_target;
+                unbound_target = nullptr;
+            }
+        }
         // initialize loss
         void initialize_loss() {
             CHECK(type == OutputSignal, "only OutputSignal could set loss");
@@ -106,7 +162,27 @@ namespace gs
     template<typename T>
     class Filter
     {
+    private:
+        bool inference = false;
+        bool backward_needed = true;
+        bool backward_planned = false;
     public:
+        // in inference mode only forward is called, so grads and buffers only used by backward are not allocated
+        // it should be set before set_dims
+        virtual void set_inference() { inference = true; }
+        bool is_inference() { return inference; }
+        // the enclosing network skips backward of a filter with nothing trainable at or before it,
+        // it is set when signals are installed, and buffers only used by backward are not allocated either.
+        // a filter shared by several networks keeps backward if one of them needs it, each network
+        // decides by its own plan whether to call it
+        void set_backward_needed(bool needed) {
+            backward_needed = (backward_planned && backward_needed) || needed;
+            backward_planned = true;
+        }
+        bool is_backward_needed() { return !inference && backward_needed; }
+        // whether some params of the filter are updated by training
+        virtual bool is_trainable() { return false; }
+
         virtual void forward() = 0;
         virtual void backward() = 0;
         virtual void install_signals(const vector<SP_Signal<T>> &in_signals, const vector<SP_Signal<T>> &out_signals) = 0;
@@ -133,6 +209,7 @@ namespace gs
         virtual vector<SP_NArray<T>> get_grads() = 0;
         void fix_params() { params_fixed = true; }
         bool is_params_fixed() { return params_fixed; }
+        bool is_trainable() override { return !params_fixed; }
     };
     template<typename T>
     using SP_PFilter = shared_ptr<PFilter<T>>;
@@ -144,6 +221,8 @@ namespace gs
         bool params_fixed = false;
     public:
         virtual set<SP_PFilter<T>> get_pfilters() = 0;
+        // direct sub filters in the order of links, clone() keeps this order
+        virtual vector<SP_Filter<T>> get_filters() = 0;
         void fix_params() {
             for (auto sp : get_pfilters()) {
                 sp->fix_params();
@@ -151,6 +230,14 @@ namespace gs
             params_fixed = true;
         }
         bool is_params_fixed() { return params_fixed; }
+        bool is_trainable() override {
+            for (auto sp : get_pfilters()) {
+                if (!sp->is_params_fixed()) {
+                    return true;
+                }
+            }
+            return false;
+        }
     };
 
 }
@@ -1,7 +1,10 @@
 #include "galois/filters/tanh.h"
 #include "galois/filters/general_tanh.h"
 #include "galois/filters/linear.h"
+#include "galois/filters/linear_tanh.h"
 #include "galois/filters/embedding.h"
 #include "galois/filters/cross_entropy.h"
+#include "galois/filters/seq_cross_entropy.h"
 #include "galois/filters/convolution.h"
-#include "galois/filters/max_pooling.h"
\ No newline at end of file
+#include "galois/filters/max_pooling.h"
+#include "galois/filters/recurrent_layer.h"
\ No newline at end of file
@@ -26,6 +26,10 @@ namespace gs {
         SP_NArray<T> dw = nullptr;
         SP_NArray<T> db = nullptr;
 
+        // lowered input (im2col), set in set_dims and reused by every batch
+        // [batch_size * out_rows * out_columns, kernel_rows * kernel_columns * in_channels]
+        SP_NArray<T> col = nullptr;
+
     public:
         Convolution(const bool for_clone_or_share) {}
         Convolution(const Convolution&) = delete;
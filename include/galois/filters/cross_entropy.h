@@ -11,15 +11,16 @@ namespace gs {
         SP_Signal<T> in_signal = nullptr;
         SP_Signal<T> out_signal = nullptr;
 
-        // for optimization
-        SP_NArray<T> softmax_output = nullptr;
+        // grad of in signal, computed by forward in the same sweep as the loss and used by backward
+        SP_NArray<T> in_grad_cache = nullptr;
+
     public:
         CrossEntropy() {}
         CrossEntropy(const CrossEntropy&) = delete;
         CrossEntropy& operator=(const CrossEntropy&) = delete;
 
         SP_Filter<T> share() override;
-        void reopaque() override { softmax_output->reopaque(); }
+        void reopaque() override { if (in_grad_cache) { in_grad_cache->reopaque(); } }
 
         void install_signals(const vector<SP_Signal<T>> &in_signals, const vector<SP_Signal<T>> &out_signals) override;
         void set_dims(size_t batch_size) override;
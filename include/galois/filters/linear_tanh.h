@@ -0,0 +1,50 @@
+#ifndef _GALOIS_LINEAR_TANH_H_
+#define _GALOIS_LINEAR_TANH_H_
+
+#include "galois/base.h"
+
+namespace gs {
+
+    // Linear followed by Tanh in one filter, y = tanh(x*w + b)
+    // rows of the batch are done in blocks, the bias and tanh are applied to a block right after its GEMM,
+    // and backward turns a block of dy into dy*(1-y*y) just before the GEMMs that read it
+    template<typename T>
+    class LinearTanh : public PFilter<T> {
+    private:
+        SP_Signal<T> in_signal = nullptr;
+        SP_Signal<T> out_signal = nullptr;
+        size_t in_size = 0;
+        size_t out_size = 0;
+
+        SP_NArray<T> w = nullptr;
+        SP_NArray<T> b = nullptr;
+        SP_NArray<T> dw = nullptr;
+        SP_NArray<T> db = nullptr;
+
+        // rows of a block, and grad of the pre-activation of one block, set in set_dims
+        size_t block_rows = 0;
+        SP_NArray<T> block_grad = nullptr;
+
+    public:
+        LinearTanh(const bool for_clone_or_share) {}
+        LinearTanh(const LinearTanh&) = delete;
+        LinearTanh& operator=(const LinearTanh&) = delete;
+        LinearTanh(size_t in_size, size_t out_size);
+
+        SP_Filter<T> share() override;
+        SP_Filter<T> clone() override;
+
+        void install_signals(const vector<SP_Signal<T>> &in_signals, const vector<SP_Signal<T>> &out_signals) override;
+        void set_dims(size_t batch_size) override;
+        void reopaque() override;
+
+        vector<SP_NArray<T>> get_params() override;
+        vector<SP_NArray<T>> get_grads() override;
+
+        void forward() override;
+        void backward() override;
+    };
+
+}
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef _GALOIS_RECURRENT_LAYER_H_
+#define _GALOIS_RECURRENT_LAYER_H_
+
+#include "galois/base.h"
+
+namespace gs {
+
+    // one tanh layer of a recurrent network over a whole sequence
+    // h[t] = tanh(x[t]*wx + h[t-1]*wh + b), where x[t]*wx is a row lookup of wx if use_embedding
+    // in signals are x[0..n-1] and optionally the initial state h[-1], out signals are h[0..n-1]
+    // the input projection of all steps is done by one GEMM, and bias and tanh are fused into the steps
+    // with lengths set, a row past its length keeps its last state and no grad flows through the padded steps
+    template<typename T>
+    class RecurrentLayer : public PFilter<T> {
+    private:
+        vector<SP_Signal<T>> in_signals = {};
+        vector<SP_Signal<T>> out_signals = {};
+        SP_Signal<T> initial_signal = nullptr;
+        size_t in_size = 0;
+        size_t hidden_size = 0;
+        bool use_embedding = false;
+
+        size_t num_steps = 0;
+        size_t batch_size = 0;
+        // length of the sequence of each row of a batch, empty when every row runs all steps
+        vector<size_t> lengths = {};
+
+        SP_NArray<T> wx = nullptr;
+        SP_NArray<T> wh = nullptr;
+        SP_NArray<T> b = nullptr;
+        SP_NArray<T> dwx = nullptr;
+        SP_NArray<T> dwh = nullptr;
+        SP_NArray<T> db = nullptr;
+
+        // buffers of all steps, set in set_dims, step t takes rows [t*batch_size, (t+1)*batch_size)
+        SP_NArray<T> xs = nullptr;      // packed inputs [num_steps * batch_size, in_size], or [num_steps * batch_size] of indexes
+        SP_NArray<T> hs = nullptr;      // hidden states [num_steps * batch_size, hidden_size]
+        SP_NArray<T> dhs = nullptr;     // grads before tanh [num_steps * batch_size, hidden_size]
+        SP_NArray<T> dxs = nullptr;     // grads of inputs [num_steps * batch_size, in_size]
+        SP_NArray<T> carry = nullptr;   // grads of states kept over padded steps [batch_size, hidden_size]
+
+    private:
+        size_t _active_rows(size_t t);
+
+    public:
+        RecurrentLayer(const bool for_clone_or_share) {}
+        RecurrentLayer(const RecurrentLayer&) = delete;
+        RecurrentLayer& operator=(const RecurrentLayer&) = delete;
+        RecurrentLayer(size_t in_size, size_t hidden_size, bool use_embedding=false);
+
+        // rows [0, k) of step t are computed for the last row k-1 still inside its sequence, so it is cheapest
+        // when rows are sorted by decreasing length. it could change between batches
+        void set_lengths(const vector<size_t> &lengths);
+
+        SP_Filter<T> share() override;
+        SP_Filter<T> clone() override;
+
+        void install_signals(const vector<SP_Signal<T>> &in_signals, const vector<SP_Signal<T>> &out_signals) override;
+        void set_dims(size_t batch_size) override;
+        void reopaque() override;
+
+        vector<SP_NArray<T>> get_params() override;
+        vector<SP_NArray<T>> get_grads() override;
+
+        void forward() override;
+        void backward() override;
+    };
+
+}
+
+#endif
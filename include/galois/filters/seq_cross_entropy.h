@@ -0,0 +1,77 @@
+#ifndef _GALOIS_SEQ_CROSS_ENTROPY_H_
+#define _GALOIS_SEQ_CROSS_ENTROPY_H_
+
+#include "galois/base.h"
+#include "galois/thread_pool.h"
+
+namespace gs {
+
+    // a Linear shared by every step of a sequence followed by a CrossEntropy for each step, in_signals[i] is
+    // the state of step i and out_signals[i] gets its predictions and loss, like CrossEntropy
+    // states of all steps are stacked, so the projection is one [steps*batch, in] x [in, out] GEMM, and the
+    // softmax of every step runs over one buffer of logits
+    // with lengths set, steps of a row past its length are left out of the buffers, so they cost nothing and
+    // have no loss, and their predictions are 0
+    // the softmax of all rows is one call of the kernel, which splits the rows over a pool if there is one
+    template<typename T>
+    class SeqCrossEntropy : public PFilter<T> {
+    private:
+        vector<SP_Signal<T>> in_signals = {};
+        vector<SP_Signal<T>> out_signals = {};
+        size_t in_size = 0;
+        size_t out_size = 0;
+        size_t batch_size = 0;
+        // length of the sequence of each row of a batch, empty when every row runs all steps
+        vector<size_t> lengths = {};
+        // rows of each step in the buffers, and the number of all of them
+        vector<size_t> step_rows = {};
+        size_t num_rows = 0;
+
+        SP_NArray<T> w = nullptr;
+        SP_NArray<T> b = nullptr;
+        SP_NArray<T> dw = nullptr;
+        SP_NArray<T> db = nullptr;
+
+        // the following are [steps*batch, ...], set in set_dims, and grads only when backward is needed
+        SP_NArray<T> states = nullptr;
+        SP_NArray<T> logits = nullptr;
+        SP_NArray<T> logits_grad = nullptr;
+        SP_NArray<T> states_grad = nullptr;
+        // targets, predictions and losses of the rows in the buffers, in the same order
+        SP_NArray<T> row_targets = nullptr;
+        SP_NArray<T> row_predictions = nullptr;
+        SP_NArray<T> row_losses = nullptr;
+
+        shared_ptr<ThreadPool> pool = nullptr;
+
+    private:
+        bool _is_active(size_t t, size_t i) { return lengths.empty() || t < lengths[i]; }
+
+    public:
+        SeqCrossEntropy(const bool for_clone_or_share) {}
+        SeqCrossEntropy(const SeqCrossEntropy&) = delete;
+        SeqCrossEntropy& operator=(const SeqCrossEntropy&) = delete;
+        SeqCrossEntropy(size_t in_size, size_t out_size);
+
+        // it could change between batches
+        void set_lengths(const vector<size_t> &lengths);
+        // run the softmax of the rows on num_threads threads (the caller included), 1 by default
+        void set_num_threads(size_t num_threads);
+
+        SP_Filter<T> share() override;
+        SP_Filter<T> clone() override;
+
+        void install_signals(const vector<SP_Signal<T>> &in_signals, const vector<SP_Signal<T>> &out_signals) override;
+        void set_dims(size_t batch_size) override;
+        void reopaque() override;
+
+        vector<SP_NArray<T>> get_params() override;
+        vector<SP_NArray<T>> get_grads() override;
+
+        void forward() override;
+        void backward() override;
+    };
+
+}
+
+#endif
@@ -7,6 +7,7 @@
 #include <set>
 #include <map>
 #include <algorithm>
+#include <memory>
 
 using namespace std;
 
@@ -29,14 +30,33 @@ namespace gs
         // the network can be fixed only when members in above are set
         bool fixed = false;
 
+        // compiled plan, built when the network is fixed
+        // signals get dense integer ids, inputs first, then outputs, then inner signals
+        // and propagation runs over flat arrays without any lookup by name
+        vector<string> signal_ids = {};
+        vector<vector<int>> link_in_ids = {};
+        vector<vector<int>> link_out_ids = {};
+        vector<int> fp_order = {};     // index of link for each filter in fp_plan
+        vector<Filter<T>*> fp_plan = {};
+        vector<bool> bp_needed = {};   // whether backward of each filter in fp_plan is needed in this network
+        vector<Signal<T>*> inner_plan = {};
+
+        // memory plan, inner signals are placed in one arena, see plan_memory
+        SP_NArray<T> arena = nullptr;
+        size_t planned_bytes = 0;
+        size_t naive_bytes = 0;
+
+        // gradient checkpointing, see set_checkpoints. fp_plan is split into segments starting at segment_starts,
+        // the filters marked in recomputed are run again by backward to restore the data of signals in dropped
+        vector<int> segment_starts = {};
+        vector<bool> recomputed = {};          // indexed by position in fp_plan
+        vector<vector<Signal<T>*>> dropped = {};    // indexed by segment
+
     protected:
         void _remove_signal(string);
-        SP_Signal<T> _get_signal(string id,
-                                 const vector<SP_Signal<T>> in_signals,
-                                 const vector<SP_Signal<T>> out_signals);
-        vector<SP_Signal<T>> _get_signal(vector<string> id,
-                                         const vector<SP_Signal<T>> in_signals,
-                                         const vector<SP_Signal<T>> out_signals);
+        void _index_signals();
+        void _build_plan();
+        void _set_requires_grad(const vector<SP_Signal<T>> &signals);
 
     public:
         BaseNet() {}
@@ -51,11 +71,43 @@ namespace gs
 
         // in order to share a net, methods above should be called and methods below should not be called
         set<SP_PFilter<T>> get_pfilters() override;
+        vector<SP_Filter<T>> get_filters() override;
+
+        // inner signal by its id, for reading results of intermediate steps
+        SP_Signal<T> get_inner_signal(const string &id) {
+            CHECK(inner_signals.count(id) > 0, "inner signal %s does not exist", id.c_str());
+            return inner_signals[id];
+        }
+        // all inner signals in the order of their indexes, for a filter that runs the net step by step, such as Scan
+        vector<SP_Signal<T>> get_inner_signals() {
+            CHECK(fixed, "network should be fixed");
+            vector<SP_Signal<T>> res{};
+            for (size_t i = input_ids.size() + output_ids.size(); i < signal_ids.size(); i++) {
+                res.push_back(inner_signals[signal_ids[i]]);
+            }
+            return res;
+        }
 
+        void set_inference() override;
         void install_signals(const vector<SP_Signal<T>> &in_signals, const vector<SP_Signal<T>> &out_signals) override;
         void set_dims(size_t batch_size) override;
         void reopaque() override;
 
+        // place data and grads of inner signals in one arena at static offsets, signals whose lifetimes
+        // in the propagation order do not overlap share memory. it should be called after set_dims
+        void plan_memory();
+        bool is_memory_planned() { return arena != nullptr; }
+        size_t get_planned_bytes() { return planned_bytes; }
+        size_t get_naive_bytes() { return naive_bytes; }
+
+        // only the data of signals read across segments is kept from forward to backward, a segment ends after
+        // the last producer of each checkpoint. backward runs the links of a segment again when their outputs
+        // are only read inside of it, and the memory plan lets those outputs share memory with the ones of the
+        // other segments, so about sqrt(n) segments of a chain of n links keep O(sqrt(n)) signals for one more
+        // forward. links are assumed to be deterministic. it should be called after set_dims and before plan_memory
+        void set_checkpoints(const vector<string> &ids);
+        bool is_checkpointed() { return !segment_starts.empty(); }
+
         void forward() override;
         void backward() override;
     };
@@ -92,31 +144,94 @@ namespace gs
     }
 
     template<typename T>
-    SP_Signal<T> BaseNet<T>::_get_signal(string id,
-                                         const vector<SP_Signal<T>> in_signals,
-                                         const vector<SP_Signal<T>> out_signals) {
-        auto in_idx = find(input_ids.begin(), input_ids.end(), id);
-        if (in_idx != input_ids.end()) {
-            auto idx = in_idx - input_ids.begin();
-            return in_signals[idx];
+    void BaseNet<T>::_index_signals() {
+        CHECK(signal_ids.empty(), "signals should not be indexed before");
+        map<string, int> idx_of{};
+        auto index = [&](const string &id) {
+            auto it = idx_of.find(id);
+            if (it != idx_of.end()) {
+                return it->second;
+            }
+            int idx = signal_ids.size();
+            idx_of[id] = idx;
+            signal_ids.push_back(id);
+            return idx;
+        };
+        for (auto id : input_ids) {
+            index(id);
         }
-        auto out_idx = find(output_ids.begin(), output_ids.end(), id);
-        if (out_idx != output_ids.end()) {
-            auto idx = out_idx - output_ids.begin();
-            return out_signals[idx];
+        for (auto id : output_ids) {
+            index(id);
+        }
+        CHECK(signal_ids.size() == input_ids.size() + output_ids.size(), "input and output ids should be distinct");
+        for (auto &t : links) {
+            vector<int> ins{};
+            vector<int> outs{};
+            for (auto &id : get<0>(t)) {
+                ins.push_back(index(id));
+            }
+            for (auto &id : get<1>(t)) {
+                outs.push_back(index(id));
+            }
+            link_in_ids.push_back(ins);
+            link_out_ids.push_back(outs);
+        }
+        for (size_t i = input_ids.size() + output_ids.size(); i < signal_ids.size(); i++) {
+            inner_plan.push_back(inner_signals[signal_ids[i]].get());
+        }
+    }
+
+    template<typename T>
+    void BaseNet<T>::_build_plan() {
+        CHECK(fp_plan.empty(), "plan should not be built before");
+        CHECK(fp_order.size() == fp_filters.size(), "every filter should have its link");
+        for (auto &filter : fp_filters) {
+            fp_plan.push_back(filter.get());
         }
-        return inner_signals[id];
     }
 
+    // a link needs backward when its filter is trainable or some in signal requires grad, and then its out
+    // signals require grad. other links skip backward and grads of their out signals are not allocated
+    // links are not always in topological order, so it runs to a fixed point
     template<typename T>
-    vector<SP_Signal<T>> BaseNet<T>::_get_signal(vector<string> ids,
-                                                 const vector<SP_Signal<T>> in_signals,
-                                                 const vector<SP_Signal<T>> out_signals) {
-        vector<SP_Signal<T>> res{};
-        for (auto id : ids) {
-            res.push_back(_get_signal(id, in_signals, out_signals));
+    void BaseNet<T>::_set_requires_grad(const vector<SP_Signal<T>> &signals) {
+        vector<bool> requires(signals.size(), false);
+        for (size_t i = 0; i < input_ids.size(); i++) {
+            requires[i] = signals[i]->requires_grad();
+        }
+        vector<bool> needed(links.size(), false);
+        for (bool changed = true; changed; ) {
+            changed = false;
+            for (size_t i = 0; i < links.size(); i++) {
+                if (needed[i]) {
+                    continue;
+                }
+                bool need = get<2>(links[i])->is_trainable();
+                for (auto id : link_in_ids[i]) {
+                    need = need || requires[id];
+                }
+                if (need) {
+                    needed[i] = true;
+                    for (auto id : link_out_ids[i]) {
+                        requires[id] = true;
+                    }
+                    changed = true;
+                }
+            }
+        }
+        for (size_t i = 0; i < links.size(); i++) {
+            get<2>(links[i])->set_backward_needed(needed[i]);
+        }
+        bp_needed.clear();
+        for (auto i : fp_order) {
+            bp_needed.push_back(needed[i]);
+        }
+        for (size_t id = input_ids.size() + output_ids.size(); id < signals.size(); id++) {
+            // a signal reused from another network might be allocated already
+            if (!requires[id] && signals[id]->get_data() == nullptr && signals[id]->requires_grad()) {
+                signals[id]->disable_grad();
+            }
         }
-        return res;
     }
 
     template<typename T>
@@ -135,23 +250,59 @@ namespace gs
         return pfilters;
     }
 
+    template<typename T>
+    vector<SP_Filter<T>> BaseNet<T>::get_filters() {
+        vector<SP_Filter<T>> filters{};
+        for (auto &t : links) {
+            filters.push_back(get<2>(t));
+        }
+        return filters;
+    }
+
+    template<typename T>
+    void BaseNet<T>::set_inference() {
+        CHECK(fixed, "network should be fixed");
+        GFilter<T>::set_inference();
+        for (auto &kv : inner_signals) {
+            kv.second->disable_grad();
+        }
+        for (auto &t : links) {
+            get<2>(t)->set_inference();
+        }
+    }
+
     template<typename T>
     void BaseNet<T>::install_signals(const vector<SP_Signal<T>> &in_signals, const vector<SP_Signal<T>> &out_signals) {
         CHECK(fixed, "network should be fixed");
-        for (auto t : links) {
-            auto ins = get<0>(t);
-            auto outs = get<1>(t);
-            auto filter = get<2>(t);
-            filter->install_signals(_get_signal(ins, in_signals, out_signals),
-                                    _get_signal(outs, in_signals, out_signals));
+        CHECK(in_signals.size() == input_ids.size(), "number of input signals should match input ids");
+        CHECK(out_signals.size() == output_ids.size(), "number of output signals should match output ids");
+        vector<SP_Signal<T>> signals{};
+        signals.insert(signals.end(), in_signals.begin(), in_signals.end());
+        signals.insert(signals.end(), out_signals.begin(), out_signals.end());
+        for (size_t i = signals.size(); i < signal_ids.size(); i++) {
+            signals.push_back(inner_signals[signal_ids[i]]);
+        }
+        if (!this->is_inference()) {
+            _set_requires_grad(signals);
+        }
+        for (size_t i = 0; i < links.size(); i++) {
+            vector<SP_Signal<T>> ins{};
+            vector<SP_Signal<T>> outs{};
+            for (auto idx : link_in_ids[i]) {
+                ins.push_back(signals[idx]);
+            }
+            for (auto idx : link_out_ids[i]) {
+                outs.push_back(signals[idx]);
+            }
+            get<2>(links[i])->install_signals(ins, outs);
         }
     }
 
     template<typename T>
     void BaseNet<T>::set_dims(size_t batch_size) {
         CHECK(fixed, "network should be fixed");
-        CHECK(!fp_filters.empty(), "fp filters should have been set");
-        for (auto filter : fp_filters) {
+        CHECK(!fp_plan.empty(), "fp plan should have been built");
+        for (auto filter : fp_plan) {
             filter->set_dims(batch_size);
         }
     }
@@ -159,19 +310,263 @@ namespace gs
     template<typename T>
     void BaseNet<T>::reopaque() {
         CHECK(fixed, "network should be fixed");
-        for (auto &kv : inner_signals) {
-            auto signal = kv.second;
+        for (auto signal : inner_plan) {
             signal->reopaque();
         }
-        for (auto filter : fp_filters) {
+        for (auto filter : fp_plan) {
             filter->reopaque();
         }
     }
 
+    template<typename T>
+    void BaseNet<T>::set_checkpoints(const vector<string> &ids) {
+        CHECK(fixed, "network should be fixed");
+        CHECK(!this->is_inference(), "checkpoints are only needed by backward");
+        CHECK(segment_starts.empty(), "checkpoints should not be set before");
+        CHECK(arena == nullptr, "checkpoints should be set before the memory plan");
+        CHECK(!fp_plan.empty(), "fp plan should have been built");
+
+        int n = fp_plan.size();
+        int num_signals = signal_ids.size();
+        int num_outer = input_ids.size() + output_ids.size();
+        vector<vector<int>> producers(num_signals, vector<int>());
+        vector<vector<int>> consumers(num_signals, vector<int>());
+        for (int p = 0; p < n; p++) {
+            for (auto id : link_out_ids[fp_order[p]]) {
+                producers[id].push_back(p);
+            }
+            for (auto id : link_in_ids[fp_order[p]]) {
+                consumers[id].push_back(p);
+            }
+        }
+
+        // a segment starts after the last producer of a checkpoint
+        vector<bool> starts(n, false);
+        starts[0] = true;
+        for (auto &id : ids) {
+            auto it = find(signal_ids.begin(), signal_ids.end(), id);
+            CHECK(it != signal_ids.end(), "signal %s does not exist", id.c_str());
+            int idx = it - signal_ids.begin();
+            CHECK(idx >= num_outer, "checkpoint %s should be an inner signal", id.c_str());
+            CHECK(!producers[idx].empty(), "checkpoint %s should be produced by some link", id.c_str());
+            int last = *max_element(producers[idx].begin(), producers[idx].end());
+            if (last+1 < n) {
+                starts[last+1] = true;
+            }
+        }
+        vector<int> segment_of(n, 0);
+        for (int p = 0; p < n; p++) {
+            if (starts[p]) {
+                segment_starts.push_back(p);
+            }
+            segment_of[p] = segment_starts.size() - 1;
+        }
+
+        // a signal is local when it is only produced and read inside of one segment, and a link is run again
+        // when all its out signals are local and only produced by links run again, so the sum is restored
+        vector<bool> local(num_signals, false);
+        for (int id = num_outer; id < num_signals; id++) {
+            if (producers[id].empty()) {
+                continue;
+            }
+            int s = segment_of[producers[id][0]];
+            bool l = true;
+            for (auto p : producers[id]) {
+                l = l && segment_of[p] == s;
+            }
+            for (auto p : consumers[id]) {
+                l = l && segment_of[p] == s;
+            }
+            local[id] = l;
+        }
+        recomputed.assign(n, false);
+        for (int p = 0; p < n; p++) {
+            bool r = true;
+            for (auto id : link_out_ids[fp_order[p]]) {
+                r = r && local[id];
+            }
+            recomputed[p] = r;
+        }
+        for (bool changed = true; changed; ) {
+            changed = false;
+            for (int p = 0; p < n; p++) {
+                if (!recomputed[p]) {
+                    continue;
+                }
+                for (auto id : link_out_ids[fp_order[p]]) {
+                    for (auto q : producers[id]) {
+                        if (!recomputed[q]) {
+                            recomputed[p] = false;
+                            changed = true;
+                        }
+                    }
+                }
+            }
+        }
+
+        dropped.assign(segment_starts.size(), vector<Signal<T>*>());
+        for (int id = num_outer; id < num_signals; id++) {
+            if (local[id] && recomputed[producers[id][0]] && inner_signals[signal_ids[id]]->get_data()) {
+                dropped[segment_of[producers[id][0]]].push_back(inner_signals[signal_ids[id]].get());
+            }
+        }
+    }
+
+    template<typename T>
+    void BaseNet<T>::plan_memory() {
+        CHECK(fixed, "network should be fixed");
+        CHECK(arena == nullptr, "memory should not be planned before");
+        CHECK(!fp_plan.empty(), "fp plan should have been built");
+
+        // step of the first producer and of the last consumer of each signal in fp_plan
+        int n = fp_plan.size();
+        int num_signals = signal_ids.size();
+        vector<int> first_producer(num_signals, n);
+        vector<int> last_consumer(num_signals, -1);
+        for (int p = 0; p < n; p++) {
+            for (auto id : link_out_ids[fp_order[p]]) {
+                first_producer[id] = min(first_producer[id], p);
+            }
+            for (auto id : link_in_ids[fp_order[p]]) {
+                last_consumer[id] = max(last_consumer[id], p);
+            }
+        }
+
+        // lifetimes over steps, forward runs step p and backward runs step 2n-1-p after all forward steps
+        // data is written by its first producer and read up to the backward of that producer
+        // grad is written by the backward of its last consumer and read up to the backward of its first producer
+        // signals dropped by a segment are only alive while the segment runs, so their steps are counted from the
+        // start of the segment and the segments are placed at the same offsets, after all the other signals
+        struct Buffer { NArray<T> *array; int start; int end; size_t size; int segment; };
+        vector<Buffer> buffers{};
+        const size_t align = max(size_t(1), 64 / sizeof(T));
+        map<Signal<T>*, int> segment_of{};
+        for (size_t s = 0; s < dropped.size(); s++) {
+            for (auto signal : dropped[s]) {
+                segment_of[signal] = s;
+            }
+        }
+        for (int id = input_ids.size() + output_ids.size(); id < num_signals; id++) {
+            auto signal = inner_signals[signal_ids[id]];
+            if (first_producer[id] == n || signal->get_data() == nullptr) {
+                continue;
+            }
+            int start = first_producer[id];
+            int end = max(last_consumer[id], start);
+            int segment = -1;
+            int m = n;
+            if (segment_of.count(signal.get()) > 0) {
+                segment = segment_of[signal.get()];
+                int begin = segment_starts[segment];
+                m = (segment+1 < int(segment_starts.size()) ? segment_starts[segment+1] : n) - begin;
+                start -= begin;
+                end -= begin;
+            }
+            if (this->is_inference()) {
+                buffers.push_back(Buffer{signal->get_data().get(), start, end, 0, segment});
+            } else {
+                buffers.push_back(Buffer{signal->get_data().get(), start, 2*m-1-start, 0, segment});
+                if (signal->get_grad()) {
+                    buffers.push_back(Buffer{signal->get_grad().get(), 2*m-1-end, 2*m-1-start, 0, segment});
+                }
+            }
+        }
+        naive_bytes = 0;
+        for (auto &b : buffers) {
+            naive_bytes += b.array->get_size() * sizeof(T);
+            b.size = (b.array->get_size() + align - 1) / align * align;
+        }
+
+        // sweep over steps, memory of dead buffers goes back to a free list and is reused with best fit
+        vector<size_t> offsets(buffers.size(), 0);
+        auto place = [&](int segment) {
+            vector<size_t> order{};
+            for (size_t i = 0; i < buffers.size(); i++) {
+                if (buffers[i].segment == segment) {
+                    order.push_back(i);
+                }
+            }
+            stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return buffers[a].start < buffers[b].start; });
+            map<size_t, size_t> free_blocks{};    // offset -> size
+            size_t top = 0;
+            auto release = [&](size_t offset, size_t size) {
+                auto it = free_blocks.insert(make_pair(offset, size)).first;
+                auto next = it;
+                next++;
+                if (next != free_blocks.end() && it->first + it->second == next->first) {
+                    it->second += next->second;
+                    free_blocks.erase(next);
+                }
+                if (it != free_blocks.begin()) {
+                    auto prev = it;
+                    prev--;
+                    if (prev->first + prev->second == it->first) {
+                        prev->second += it->second;
+                        free_blocks.erase(it);
+                    }
+                }
+            };
+            auto later_end = [&](size_t a, size_t b) { return buffers[a].end > buffers[b].end; };
+            vector<size_t> alive{};     // heap, the earliest end at front
+            for (auto i : order) {
+                auto &b = buffers[i];
+                while (!alive.empty() && buffers[alive.front()].end < b.start) {
+                    auto j = alive.front();
+                    pop_heap(alive.begin(), alive.end(), later_end);
+                    alive.pop_back();
+                    release(offsets[j], buffers[j].size);
+                }
+                auto best = free_blocks.end();
+                for (auto it = free_blocks.begin(); it != free_blocks.end(); it++) {
+                    if (it->second >= b.size && (best == free_blocks.end() || it->second < best->second)) {
+                        best = it;
+                    }
+                }
+                if (best != free_blocks.end()) {
+                    offsets[i] = best->first;
+                    if (best->second > b.size) {
+                        free_blocks[best->first + b.size] = best->second - b.size;
+                    }
+                    free_blocks.erase(best);
+                } else if (!free_blocks.empty() && free_blocks.rbegin()->first + free_blocks.rbegin()->second == top) {
+                    // grow the arena from the last free block
+                    offsets[i] = free_blocks.rbegin()->first;
+                    free_blocks.erase(offsets[i]);
+                    top = offsets[i] + b.size;
+                } else {
+                    offsets[i] = top;
+                    top += b.size;
+                }
+                alive.push_back(i);
+                push_heap(alive.begin(), alive.end(), later_end);
+            }
+            return top;
+        };
+        size_t top = place(-1);
+        size_t segments_top = 0;
+        for (size_t s = 0; s < dropped.size(); s++) {
+            segments_top = max(segments_top, place(s));
+        }
+        for (size_t i = 0; i < buffers.size(); i++) {
+            if (buffers[i].segment >= 0) {
+                offsets[i] += top;
+            }
+        }
+        top += segments_top;
+        planned_bytes = top * sizeof(T);
+
+        // storage of arrays is aligned, and so is every offset
+        arena = make_shared<NArray<T>>(max(top, align));
+        auto base = arena->get_data();
+        for (size_t i = 0; i < buffers.size(); i++) {
+            buffers[i].array->set_external_data(base + offsets[i], arena);
+        }
+    }
+
     template<typename T>
     void BaseNet<T>::forward() {
         CHECK(fixed, "network should be fixed");
-        for (auto filter : fp_filters) {
+        for (auto filter : fp_plan) {
             filter->forward();
         }
     }
@@ -179,9 +574,36 @@ namespace gs
     template<typename T>
     void BaseNet<T>::backward() {
         CHECK(fixed, "network should be fixed");
-        for (int i = fp_filters.size()-1; i >= 0; i--) {
-            auto filter = fp_filters[i];
-            filter->backward();
+        CHECK(!this->is_inference(), "backward should not be called in inference mode");
+        if (segment_starts.empty()) {
+            for (int i = fp_plan.size()-1; i >= 0; i--) {
+                if (bp_needed[i]) {
+                    fp_plan[i]->backward();
+                }
+            }
+            return;
+        }
+
+        // outputs of the last segment are still there, every segment before it runs forward again
+        int end = fp_plan.size();
+        for (int s = segment_starts.size()-1; s >= 0; s--) {
+            int begin = segment_starts[s];
+            if (s+1 < int(segment_starts.size())) {
+                for (auto signal : dropped[s]) {
+                    signal->get_data()->reopaque();
+                }
+                for (int i = begin; i < end; i++) {
+                    if (recomputed[i]) {
+                        fp_plan[i]->forward();
+                    }
+                }
+            }
+            for (int i = end-1; i >= begin; i--) {
+                if (bp_needed[i]) {
+                    fp_plan[i]->backward();
+                }
+            }
+            end = begin;
         }
     }
 
@@ -3,6 +3,9 @@
 
 #include "galois/base.h"
 #include "galois/gfilters/base_net.h"
+#include "galois/thread_pool.h"
+#include <atomic>
+#include <mutex>
 #include <string>
 #include <vector>
 #include <set>
@@ -17,11 +20,30 @@ namespace gs
     class Net : public BaseNet<T>
     {
     private:
-        map<string, vector<tuple<string, int>>> fp_graph = {};
-        map<string, vector<tuple<string, int>>> bp_graph = {};
+        // indexed by signal id, the links that consume / produce the signal
+        vector<vector<int>> fp_graph = {};
+        vector<vector<int>> bp_graph = {};
+
+        // optional parallel executor, the members below are indexed by position in fp_plan
+        // a filter is run once all the filters it depends on are finished, and filters writing
+        // to the same signal or the same gradient of parameters hold a common lock
+        shared_ptr<ThreadPool> pool = nullptr;
+        vector<vector<int>> fp_next = {};
+        vector<vector<int>> bp_next = {};
+        vector<int> fp_deps = {};
+        vector<int> bp_deps = {};
+        vector<vector<int>> fp_locks = {};
+        vector<vector<int>> bp_locks = {};
+        unique_ptr<mutex[]> locks = nullptr;
+        unique_ptr<atomic<int>[]> counters = nullptr;
+
+        // indexed by position in fp_plan, filters skipped by forward since their outputs are cached, see skip_frozen
+        vector<bool> frozen = {};
 
     private:
-        void _set_fp_order(const string, vector<int>&);
+        void _set_fp_order(const int, vector<bool>&, vector<bool>&);
+        void _build_parallel_plan();
+        void _parallel_propagate(const bool);
 
     public:
         Net() {}
@@ -37,6 +59,20 @@ namespace gs
         void add_output_ids(const vector<string>&);
         void set_p_order();
 
+        // run independent filters concurrently on num_threads threads (the caller included)
+        // 1 means sequential propagation, which is the default
+        void set_num_threads(size_t num_threads);
+
+        // a link is frozen when its params are fixed and its in signals are inputs or only produced by frozen
+        // links, so its outputs are a function of the input samples. forward skips frozen links from now on,
+        // and the returned signals, read by the other links, should be filled before each forward with the
+        // sum of what frozen links write to them, as computed by forward_frozen. it should be called after set_dims
+        vector<SP_Signal<T>> skip_frozen();
+        void forward_frozen();
+
+        void forward() override;
+        void backward() override;
+
         SP_Filter<T> share() override;
         SP_Filter<T> clone() override;
     };
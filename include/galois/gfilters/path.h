@@ -20,6 +20,7 @@ namespace gs
         set<SP_PFilter<T>> pfilters;
 
         vector<SP_Signal<T>> inner_signals;
+        vector<bool> bp_needed;   // whether backward of each filter is needed in this path
 
     public:
         Path() {}
@@ -31,7 +32,9 @@ namespace gs
         SP_Filter<T> share() override;
         SP_Filter<T> clone() override;
         set<SP_PFilter<T>> get_pfilters() override;
+        vector<SP_Filter<T>> get_filters() override;
 
+        void set_inference() override;
         void install_signals(const vector<SP_Signal<T>>& in_signals, const vector<SP_Signal<T>>& out_signals) override;
         void set_dims(size_t batch_size) override;
         void reopaque() override;
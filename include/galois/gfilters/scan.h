@@ -0,0 +1,79 @@
+#ifndef _GALOIS_SCAN_H_
+#define _GALOIS_SCAN_H_
+
+#include "galois/base.h"
+#include "galois/gfilters/base_net.h"
+#include <vector>
+#include <set>
+
+using namespace std;
+
+namespace gs
+{
+
+    // runs one cell over the steps of a sequence instead of unrolling a copy of the cell for each step
+    // the cell is a fixed net with 2 input ids, the input of a step and the previous state, and 1 output id,
+    // the new state. in signals are X [batch, steps, in_size] ([batch, steps] of indexes if use_embedding) and
+    // optionally the initial state [batch, state_size], out signals are H [batch, steps, state_size] and optionally
+    // the last state. only the first num_steps steps are run, steps after them are zero in H
+    // every step has a frame in one stack allocated by set_dims, signals of the cell are pointed at the frame of
+    // the step before it runs, so backward finds what forward wrote. per-step values kept by filters in members
+    // other than signals are not saved, so the cell should only keep them in signals
+    template<typename T>
+    class Scan : public GFilter<T>
+    {
+    private:
+        shared_ptr<BaseNet<T>> cell = nullptr;
+        size_t in_size = 0;
+        size_t state_size = 0;
+        size_t max_steps = 0;
+        size_t num_steps = 0;
+        bool use_embedding = false;
+        size_t batch_size = 0;
+
+        SP_Signal<T> in_signal = nullptr;
+        SP_Signal<T> initial_signal = nullptr;
+        SP_Signal<T> out_signal = nullptr;
+        SP_Signal<T> last_signal = nullptr;
+
+        // signals of one step installed in the cell
+        SP_Signal<T> step_in = nullptr;
+        SP_Signal<T> step_prev = nullptr;
+        SP_Signal<T> step_out = nullptr;
+        vector<SP_Signal<T>> cell_signals = {};
+
+        // frame t holds the state before step t, and the input and inner data of step t when backward is needed
+        SP_NArray<T> stack = nullptr;
+        size_t frame_size = 0;
+        vector<NArray<T>*> framed = {};
+        vector<size_t> framed_offsets = {};
+
+    private:
+        void _point_to(size_t t);
+
+    public:
+        Scan(shared_ptr<BaseNet<T>> cell, size_t in_size, size_t state_size, size_t max_steps, bool use_embedding=false);
+        Scan(const Scan& other) = delete;
+        Scan& operator=(const Scan&) = delete;
+
+        // the length of sequences could change between batches without building anything again
+        void set_num_steps(size_t num_steps);
+        size_t get_num_steps() { return num_steps; }
+
+        SP_Filter<T> share() override;
+        SP_Filter<T> clone() override;
+        set<SP_PFilter<T>> get_pfilters() override;
+        vector<SP_Filter<T>> get_filters() override;
+
+        void set_inference() override;
+        void install_signals(const vector<SP_Signal<T>> &in_signals, const vector<SP_Signal<T>> &out_signals) override;
+        void set_dims(size_t batch_size) override;
+        void reopaque() override;
+
+        void forward() override;
+        void backward() override;
+    };
+
+}
+
+#endif
@@ -3,3 +3,4 @@
 #include "galois/models/mlp.h"
 #include "galois/models/rnn.h"
 #include "galois/models/seq_encoder_decoder.h"
+#include "galois/models/bi_seq_encoder_decoder.h"
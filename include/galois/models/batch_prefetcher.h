@@ -0,0 +1,60 @@
+#ifndef _GALOIS_BATCHPREFETCHER_H_
+#define _GALOIS_BATCHPREFETCHER_H_
+
+#include "galois/narray.h"
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace gs
+{
+
+    // gathers the next batch on a background thread while the current one is being trained
+    // rows next_ids(ids) of every source go to a buffer, and next() hands the buffers over by swapping
+    // them with the arrays in use, which are then filled with the batch after
+    template<typename T>
+    class BatchPrefetcher
+    {
+    private:
+        vector<SP_NArray<T>> sources = {};
+        vector<SP_NArray<T>> buffers = {};
+        function<void(vector<size_t>&)> next_ids;
+        // ids of the batch being gathered, filled in place so that a batch allocates nothing
+        vector<size_t> ids = {};
+
+        thread worker;
+        mutex m;
+        condition_variable cv;
+        bool requested = false;
+        bool ready = false;
+        bool stop = false;
+
+        // time the training thread spent waiting for batches
+        double wait_seconds = 0;
+        size_t num_batches = 0;
+
+    private:
+        void _work();
+
+    public:
+        // dims[k] is the dimensions of a batch of sources[k]
+        BatchPrefetcher(const vector<SP_NArray<T>> &sources,
+                        const vector<Shape> &dims,
+                        function<void(vector<size_t>&)> next_ids);
+        BatchPrefetcher(const BatchPrefetcher& other) = delete;
+        BatchPrefetcher& operator=(const BatchPrefetcher&) = delete;
+        ~BatchPrefetcher();
+
+        // wait for the prefetched batch, install(k, buffer) should swap the buffer of sources[k] with the
+        // array in use, and the swapped out arrays are filled with the next batch
+        void next(function<void(size_t, SP_NArray<T>&)> install);
+
+        double get_wait_seconds() { return wait_seconds; }
+        size_t get_num_batches() { return num_batches; }
+        void reset_stats() { wait_seconds = 0; num_batches = 0; }
+    };
+
+}
+
+#endif
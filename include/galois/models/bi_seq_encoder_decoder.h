@@ -10,11 +10,36 @@
 namespace gs
 {
 
+    template<typename T>
+    class Encoder;
+    template<typename T>
+    class Decoder;
+
+    // sentences are arrays of indexes, 0 is <EOS> and pads a sentence after its last token. both sentences of
+    // a pair are encoded, and each state is decoded to both sentences, the decoders read <EOS> and then their
+    // own predictions, and they learn the <EOS> after the last token as well
     template<typename T>
     class BiSeqEncoderDecoder : protected OrderedModel<T>
     {
         static default_random_engine galois_rn_generator;
 
+        // the network unrolled to len_one and len_another steps, a batch of pairs not longer than these is
+        // trained on it, and rows past their lengths are masked. nets of every bucket share params
+        struct Bucket {
+            size_t len_one;
+            size_t len_another;
+            OrderedNet<T> *net;
+            shared_ptr<OrderedNet<T>> own_net;
+            vector<SP_Signal<T>> input_signals;
+            vector<SP_Signal<T>> output_signals;
+            shared_ptr<Encoder<T>> encoder_one;
+            shared_ptr<Encoder<T>> encoder_another;
+            // decoders from the states of one and from the states of another
+            vector<shared_ptr<Decoder<T>>> decoders_one;
+            vector<shared_ptr<Decoder<T>>> decoders_another;
+            vector<size_t> ids;     // train pairs in the bucket
+        };
+
     protected:
         size_t max_len_one;
         size_t max_len_another;
@@ -22,9 +47,32 @@ namespace gs
         size_t input_size_another;
         vector<size_t> hidden_sizes;
 
+        // nets holding the params, links of every bucket are shares of them
+        shared_ptr<Encoder<T>> encoder_one = nullptr;
+        shared_ptr<Encoder<T>> encoder_another = nullptr;
+        shared_ptr<Decoder<T>> decoder_one = nullptr;
+        shared_ptr<Decoder<T>> decoder_another = nullptr;
+        // the first bucket is the one of the longest sentences, on the net of the model
+        vector<Bucket> buckets = {};
+
         size_t train_seq_count = 0;
         SP_NArray<T> train_one = nullptr;
         SP_NArray<T> train_another = nullptr;
+        // lengths read by the encoders, and lengths learned by the decoders with the <EOS> after the last token
+        vector<size_t> train_len_one = {};
+        vector<size_t> train_len_another = {};
+        vector<size_t> train_len_one_decoded = {};
+        vector<size_t> train_len_another_decoded = {};
+        // lengths of the rows of a batch
+        vector<size_t> len_one = {};
+        vector<size_t> len_another = {};
+        vector<size_t> len_one_decoded = {};
+        vector<size_t> len_another_decoded = {};
+
+    protected:
+        void _link(OrderedNet<T> &net, Bucket &bucket, vector<string> &x_ids, vector<string> &y_ids);
+        size_t _length(const SP_NArray<T> &sentences, size_t idx);
+
     public:
         BiSeqEncoderDecoder(
             size_t max_len_one,
@@ -42,6 +90,11 @@ namespace gs
         using OrderedModel<T>::get_params;
         using OrderedModel<T>::get_grads;
 
+        // pairs up to len_one and len_another long are trained on a network of these lengths instead of the
+        // longest one, it should be called before the train dataset is added. the network of a bucket is built
+        // outside of compile, so options of the model such as inference, replicas, hogwild workers and prefetch
+        // are not supported with buckets
+        void add_bucket(size_t len_one, size_t len_another);
         void add_train_dataset(const SP_NArray<T> data, const SP_NArray<T> target);
         T train_one_batch(const bool update=true);
         void fit();
@@ -0,0 +1,55 @@
+#ifndef _GALOIS_DATAPARALLEL_H_
+#define _GALOIS_DATAPARALLEL_H_
+
+#include "galois/base.h"
+#include "galois/narray.h"
+#include "galois/thread_pool.h"
+#include "galois/models/replica.h"
+
+namespace gs
+{
+
+    // synchronous data parallel training over replicas of a compiled network
+    // a batch is split into equal slices, one per replica, the replicas run forward and backward
+    // concurrently, and their grads are averaged into the master grads, so the optimizer updates
+    // the master params once per batch as usual
+    template<typename T>
+    class DataParallel
+    {
+    private:
+        vector<SP_Replica<T>> replicas = {};
+        vector<vector<size_t>> batch_ids = {};  // rows of the batch taken by each replica
+        vector<SP_NArray<T>> grads = {};
+        // indexed as grads, the grads of replicas to be reduced into it
+        vector<vector<SP_NArray<T>>> replica_grads = {};
+        ThreadPool pool;
+
+        // time of propagation in replicas and of the reduction
+        double propagate_seconds = 0;
+        double reduce_seconds = 0;
+
+    private:
+        void _reduce(size_t part);
+
+    public:
+        // master should be fixed and have no signals installed yet
+        // grads are the grads updated by the optimizer, in the order of its params
+        DataParallel(GFilter<T> &master, const vector<SP_NArray<T>> &grads,
+                     size_t num_inputs, size_t num_outputs, size_t batch_size, size_t num_replicas);
+        DataParallel(const DataParallel& other) = delete;
+        DataParallel& operator=(const DataParallel&) = delete;
+
+        size_t get_num_replicas() { return replicas.size(); }
+
+        // train on the batch in the data of input_signals and the target of output_signals,
+        // return the loss summed over outputs, each averaged over the batch
+        T train_one_batch(const vector<SP_Signal<T>> &input_signals, const vector<SP_Signal<T>> &output_signals);
+
+        double get_propagate_seconds() { return propagate_seconds; }
+        double get_reduce_seconds() { return reduce_seconds; }
+        void reset_stats() { propagate_seconds = 0; reduce_seconds = 0; }
+    };
+
+}
+
+#endif
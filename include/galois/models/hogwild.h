@@ -0,0 +1,51 @@
+#ifndef _GALOIS_HOGWILD_H_
+#define _GALOIS_HOGWILD_H_
+
+#include "galois/base.h"
+#include "galois/narray.h"
+#include "galois/optimizer.h"
+#include "galois/thread_pool.h"
+#include "galois/models/replica.h"
+#include <random>
+
+namespace gs
+{
+
+    // asynchronous sgd without locks (hogwild) over replicas of a compiled network
+    // every worker draws its own batches and updates the shared params with its own grads right
+    // after its backward, through an optimizer of its own, so moments of stateful optimizers are
+    // per worker. updates of different workers may interleave with each other and with forward of
+    // others, which costs little when most updates are sparse, as those of embeddings
+    // with deterministic, workers run in rounds instead: they propagate concurrently against the
+    // params of the previous round, then apply their updates one by one in the order of workers
+    template<typename T>
+    class Hogwild
+    {
+    private:
+        vector<SP_Replica<T>> replicas = {};
+        vector<SP_Optimizer<T>> optimizers = {};
+        vector<default_random_engine> generators = {};
+        size_t batch_size;
+        bool deterministic;
+        ThreadPool pool;
+
+    private:
+        // copy a batch drawn by worker w into the signals of its replica
+        void _load(size_t w, const vector<SP_NArray<T>> &data, const vector<SP_NArray<T>> &target);
+
+    public:
+        // master should be fixed and have no signals installed yet
+        Hogwild(GFilter<T> &master, size_t num_inputs, size_t num_outputs, size_t batch_size,
+                size_t num_workers, string optimizer_name, T learning_rate, bool deterministic=false);
+        Hogwild(const Hogwild& other) = delete;
+        Hogwild& operator=(const Hogwild&) = delete;
+
+        size_t get_num_workers() { return replicas.size(); }
+
+        // train num_batches batches drawn with replacement from the dataset, return the mean loss
+        T train(const vector<SP_NArray<T>> &data, const vector<SP_NArray<T>> &target, size_t num_batches);
+    };
+
+}
+
+#endif
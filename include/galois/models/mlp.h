@@ -5,6 +5,10 @@
 #include "galois/narray.h"
 #include "galois/gfilters/path.h"
 #include "galois/optimizer.h"
+#include "galois/models/batch_prefetcher.h"
+#include "galois/models/data_parallel.h"
+#include "galois/models/hogwild.h"
+#include <atomic>
 #include <vector>
 
 using namespace std;
@@ -15,7 +19,10 @@ namespace gs
     template<typename T>
     class MLPModel
     {
-        static default_random_engine galois_rn_generator;
+        // every model draws its batches from its own generator, so models do not shift the batches of each other.
+        // generators are seeded in the order models are created, so each model draws different batches
+        static atomic<unsigned> num_models;
+        default_random_engine galois_rn_generator{++num_models};
 
     protected:
         Path<T> path;
@@ -25,10 +32,16 @@ namespace gs
         vector<SP_PFilter<T>> pfilters = {};
         vector<SP_NArray<T>>  params = {};
         vector<SP_NArray<T>>  grads = {};
+        // params and grads are views into these, built by compile
+        SP_NArray<T> param_buffer = nullptr;
+        SP_NArray<T> grad_buffer = nullptr;
 
         size_t batch_size;
+        bool compiled = false;
+        bool inference = false;
         int num_epoch;
         T learning_rate;
+        string optimizer_name;
         SP_Optimizer<T> optimizer;
 
         size_t train_count = 0;
@@ -38,13 +51,33 @@ namespace gs
         SP_NArray<T> test_data = nullptr;
         SP_NArray<T> test_target = nullptr;
 
+        // batches for training are gathered in background when prefetch is enabled, it is started by the first
+        // train_one_batch and stopped at the end of fit
+        bool prefetch = false;
+        unique_ptr<BatchPrefetcher<T>> prefetcher = nullptr;
+        // ids of a batch gathered on the training thread, kept so that its storage is reused
+        vector<size_t> batch_ids = {};
+
+        // batches are split over replicas of the network when num_replicas > 1, built by compile
+        size_t num_replicas = 1;
+        unique_ptr<DataParallel<T>> data_parallel = nullptr;
+
+        // epochs are trained by num_workers asynchronous workers when it is positive, built by compile
+        size_t num_workers = 0;
+        bool deterministic_workers = false;
+        unique_ptr<Hogwild<T>> hogwild = nullptr;
+
+    protected:
+        void _start_prefetch();
+
     public:
         MLPModel(size_t batch_size, int num_epoch, T learning_rate, string optimizer_name);
         MLPModel(const MLPModel& other) = delete;
         MLPModel& operator=(const MLPModel&) = delete;
 
         void add_filter(SP_Filter<T>);
-        void compile();
+        // fit compiles a model that is not compiled yet
+        void compile(const bool inference=false);
 
         vector<SP_NArray<T>> get_params() {
             return params;
@@ -56,15 +89,34 @@ namespace gs
         void add_train_dataset(SP_NArray<T> data, SP_NArray<T> target);
         void add_test_dataset(const SP_NArray<T> data, const SP_NArray<T> target);
 
+        // write or read all params updated by the optimizer in one go, it should be called after compile
+        void save_params(const string &path) { CHECK(param_buffer, "there should be params to save"); param_buffer->save(path); }
+        void load_params(const string &path) { CHECK(param_buffer, "there should be params to load"); param_buffer->load(path); }
         void fix_params() { path.fix_params(); }
 
+        // gather batches on a background thread while the current one is trained, it should be called before training
+        void enable_prefetch() { CHECK(!prefetcher, "prefetch has started"); prefetch = true; }
+        // train each batch with num_replicas replicas running concurrently, it should be called before compile
+        void set_num_replicas(size_t num_replicas) {
+            CHECK(!data_parallel, "replicas have been built");
+            CHECK(num_replicas > 0, "at least one replica is needed");
+            this->num_replicas = num_replicas;
+        }
+        // train epochs with lock free sgd over num_workers workers, see Hogwild, it should be called before compile
+        void set_hogwild(size_t num_workers, bool deterministic=false) {
+            CHECK(!hogwild, "workers have been built");
+            CHECK(num_workers > 0, "at least one worker is needed");
+            this->num_workers = num_workers;
+            this->deterministic_workers = deterministic;
+        }
+
         T train_one_batch(const bool update=true);
         double compute_correctness(SP_Signal<T>); // for most application, this one should be override
         double test();
         void fit();
     };
     template<typename T>
-    default_random_engine MLPModel<T>::galois_rn_generator(0);
+    atomic<unsigned> MLPModel<T>::num_models(0);
 
 }
 
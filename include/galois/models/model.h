@@ -5,6 +5,10 @@
 #include "galois/narray.h"
 #include "galois/gfilters/net.h"
 #include "galois/optimizer.h"
+#include "galois/models/batch_prefetcher.h"
+#include "galois/models/data_parallel.h"
+#include "galois/models/hogwild.h"
+#include <atomic>
 
 namespace gs
 {
@@ -12,7 +16,10 @@ namespace gs
     template<typename T>
     class Model
     {
-        static default_random_engine galois_rn_generator;
+        // every model draws its batches from its own generator, so models do not shift the batches of each other.
+        // generators are seeded in the order models are created, so each model draws different batches
+        static atomic<unsigned> num_models;
+        default_random_engine galois_rn_generator{++num_models};
 
     protected:
         Net<T> net;
@@ -20,6 +27,9 @@ namespace gs
         vector<SP_PFilter<T>> pfilters = {};
         vector<SP_NArray<T>>  params = {};
         vector<SP_NArray<T>>  grads = {};
+        // params and grads are views into these, built by compile
+        SP_NArray<T> param_buffer = nullptr;
+        SP_NArray<T> grad_buffer = nullptr;
 
         vector<string>          input_ids = {};
         vector<SP_Signal<T>>    input_signals = {};
@@ -27,8 +37,11 @@ namespace gs
         vector<SP_Signal<T>>    output_signals = {};
 
         size_t batch_size;
+        bool compiled = false;
+        bool inference = false;
         int num_epoch;
         T learning_rate;
+        string optimizer_name;
         SP_Optimizer<T> optimizer;
 
         size_t train_count = 0;
@@ -38,6 +51,36 @@ namespace gs
         vector<SP_NArray<T>> test_data = {};
         vector<SP_NArray<T>> test_target = {};
 
+        // batches for training are gathered in background when prefetch is enabled, it is started by the first
+        // train_one_batch and stopped at the end of fit
+        bool prefetch = false;
+        unique_ptr<BatchPrefetcher<T>> prefetcher = nullptr;
+        // ids of a batch gathered on the training thread, kept so that its storage is reused
+        vector<size_t> batch_ids = {};
+
+        // batches are split over replicas of the network when num_replicas > 1, built by compile
+        size_t num_replicas = 1;
+        unique_ptr<DataParallel<T>> data_parallel = nullptr;
+
+        // epochs are trained by num_workers asynchronous workers when it is positive, built by compile
+        size_t num_workers = 0;
+        bool deterministic_workers = false;
+        unique_ptr<Hogwild<T>> hogwild = nullptr;
+
+        // time spent by the last fit in training, without the tests after epochs
+        double train_seconds = 0;
+
+        // outputs of frozen links for every sample of the datasets, indexed as cached_signals, see enable_frozen_cache
+        bool frozen_cache = false;
+        SP_Allocator cache_allocator = nullptr;
+        vector<SP_Signal<T>> cached_signals = {};
+        vector<SP_NArray<T>> train_cache = {};
+        vector<SP_NArray<T>> test_cache = {};
+
+    protected:
+        void _start_prefetch();
+        vector<SP_NArray<T>> _fill_cache(const vector<SP_NArray<T>> &data, size_t count);
+
     public:
         Model(size_t batch_size, int num_epoch, T learning_rate, string optimizer_name);
         Model(const Model& other) = delete;
@@ -54,7 +97,18 @@ namespace gs
         void add_output_ids(const string);
         void add_output_ids(const initializer_list<string>);
         void add_output_ids(const vector<string>);
-        void compile();
+        // in inference mode only forward propagation is available, and no grad of signals is allocated
+        // fit compiles a model that is not compiled yet
+        void compile(const bool inference=false);
+        // let inner signals share memory when their lifetimes do not overlap, it should be called after compile
+        void plan_memory();
+        // bytes of inner signals with the memory plan and without it
+        size_t get_planned_bytes() { return net.get_planned_bytes(); }
+        size_t get_naive_bytes() { return net.get_naive_bytes(); }
+        // recompute signals read only inside of the segments ended by checkpoints in backward instead of keeping
+        // them, see BaseNet::set_checkpoints. it should be called after compile and before plan_memory, which
+        // is needed for training, as dropped signals only give their memory back through the plan
+        void set_checkpoints(const vector<string> &ids) { net.set_checkpoints(ids); }
 
         vector<SP_NArray<T>> get_params() {
             return params;
@@ -74,15 +128,49 @@ namespace gs
         void add_test_dataset(const initializer_list<SP_NArray<T>> data, const initializer_list<SP_NArray<T>> target);
         void add_test_dataset(const vector<SP_NArray<T>>& data, const vector<SP_NArray<T>>& target);
 
+        // write or read all params updated by the optimizer in one go, it should be called after compile
+        void save_params(const string &path) { CHECK(param_buffer, "there should be params to save"); param_buffer->save(path); }
+        void load_params(const string &path) { CHECK(param_buffer, "there should be params to load"); param_buffer->load(path); }
         void fix_params() { net.fix_params(); }
+        // propagation and the update of params run on num_threads threads
+        void set_num_threads(size_t num_threads) {
+            net.set_num_threads(num_threads);
+            optimizer->set_num_threads(num_threads);
+        }
+
+        // gather batches on a background thread while the current one is trained, it should be called before training
+        void enable_prefetch() { CHECK(!prefetcher, "prefetch has started"); prefetch = true; }
+        // train each batch with num_replicas replicas running concurrently, it should be called before compile
+        void set_num_replicas(size_t num_replicas) {
+            CHECK(!data_parallel, "replicas have been built");
+            CHECK(num_replicas > 0, "at least one replica is needed");
+            this->num_replicas = num_replicas;
+        }
+        // train epochs with lock free sgd over num_workers workers, see Hogwild, it should be called before compile
+        void set_hogwild(size_t num_workers, bool deterministic=false) {
+            CHECK(!hogwild, "workers have been built");
+            CHECK(num_workers > 0, "at least one worker is needed");
+            this->num_workers = num_workers;
+            this->deterministic_workers = deterministic;
+        }
+
+        // links with fixed params fed only by dataset inputs are run once over each dataset instead of every
+        // batch, and their outputs are gathered by batches, see Net::skip_frozen. the cache is stored by
+        // allocator, a MmapAllocator for one larger than memory. it should be called before compile
+        void enable_frozen_cache(SP_Allocator allocator = nullptr) {
+            CHECK(cached_signals.empty(), "frozen links have been skipped");
+            frozen_cache = true;
+            cache_allocator = allocator;
+        }
 
         T train_one_batch(const bool update=true);
         double compute_correctness(SP_Signal<T>); // for most application, this one should be override
         double test();
         void fit();
+        double get_train_seconds() { return train_seconds; }
     };
     template<typename T>
-    default_random_engine Model<T>::galois_rn_generator(0);
+    atomic<unsigned> Model<T>::num_models(0);
 
 }
 
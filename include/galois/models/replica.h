@@ -0,0 +1,50 @@
+#ifndef _GALOIS_REPLICA_H_
+#define _GALOIS_REPLICA_H_
+
+#include "galois/base.h"
+#include "galois/narray.h"
+
+namespace gs
+{
+
+    // a clone of a fixed network whose params use the memory of the params of the network,
+    // while its signals and grads are its own, so that replicas could propagate concurrently
+    template<typename T>
+    class Replica
+    {
+    private:
+        SP_Filter<T> filter = nullptr;
+        vector<SP_Signal<T>> input_signals = {};
+        vector<SP_Signal<T>> output_signals = {};
+
+        // for each param of the clone that is not fixed, its grad and the grad of the network it matches
+        vector<SP_NArray<T>> params = {};
+        vector<SP_NArray<T>> grads = {};
+        vector<SP_NArray<T>> master_grads = {};
+
+    private:
+        void _pair(SP_Filter<T>, SP_Filter<T>);
+
+    public:
+        // it should be called before signals are installed into master, some filters could not be cloned after
+        Replica(GFilter<T> &master, size_t num_inputs, size_t num_outputs, size_t batch_size);
+        Replica(const Replica& other) = delete;
+        Replica& operator=(const Replica&) = delete;
+
+        vector<SP_Signal<T>>& get_input_signals() { return input_signals; }
+        vector<SP_Signal<T>>& get_output_signals() { return output_signals; }
+        vector<SP_NArray<T>>& get_params() { return params; }
+        vector<SP_NArray<T>>& get_grads() { return grads; }
+        vector<SP_NArray<T>>& get_master_grads() { return master_grads; }
+
+        // reopaque the replica and its signals before the batch is copied in
+        void reopaque();
+        // forward and backward over the batch in the signals, return the loss summed over outputs
+        T propagate();
+    };
+    template<typename T>
+    using SP_Replica = shared_ptr<Replica<T>>;
+
+}
+
+#endif
@@ -5,6 +5,7 @@
 #include "galois/narray.h"
 #include "galois/gfilters/net.h"
 #include "galois/models/model.h"
+#include "galois/filters/seq_cross_entropy.h"
 #include "galois/optimizer.h"
 
 namespace gs
@@ -20,10 +21,25 @@ namespace gs
         vector<size_t> hidden_sizes;
 
         bool use_embedding = false;
+        // the output projection and the loss of all steps
+        shared_ptr<SeqCrossEntropy<T>> projection = nullptr;
+
+        // in stateful mode the corpus is split into batch_size streams, each batch reads the next
+        // window of max_len steps from every stream, and the last hidden states are carried to
+        // the next window as input signals, so backprop is truncated at window boundaries
+        bool stateful = false;
+        size_t stream_len = 0;
+        vector<SP_Signal<T>> state_signals = {};
+        vector<SP_Signal<T>> last_hidden_signals = {};
+        vector<SP_NArray<T>> carried_states = {};
 
         size_t train_seq_len = 0;
         SP_NArray<T> train_X = nullptr;
         SP_NArray<T> train_Y = nullptr;
+        // views of the window of every step, made by the first batch and slid by later ones
+        vector<SP_NArray<T>> window_X = {};
+        vector<SP_NArray<T>> window_Y = {};
+        int window_start = 0;
         size_t test_seq_len = 0;
         SP_NArray<T> test_X = nullptr;
         SP_NArray<T> test_Y = nullptr;
@@ -36,16 +52,25 @@ namespace gs
             int num_epoch,
             T learning_rate,
             string optimizer_name,
-            bool use_embedding=false);
+            bool use_embedding=false,
+            bool stateful=false);
         RNN(const RNN& other) = delete;
         RNN& operator=(const RNN&) = delete;
 
         using Model<T>::get_params;
         using Model<T>::get_grads;
+        // threads of the network, the optimizer and the softmax of all steps
+        void set_num_threads(size_t num_threads) {
+            Model<T>::set_num_threads(num_threads);
+            projection->set_num_threads(num_threads);
+        }
+        using Model<T>::plan_memory;
 
         void add_train_dataset(const SP_NArray<T> data, const SP_NArray<T> target);
         void add_test_dataset(const SP_NArray<T> data, const SP_NArray<T> target);
+        // in stateful mode start_from is the offset in every stream, and windows should be visited in order
         T train_one_batch(const int start_from, const bool update=true);
+        void reset_state();
         void fit();
     };
 
@@ -4,17 +4,36 @@
 #include "galois/base.h"
 #include "galois/narray.h"
 #include "galois/gfilters/net.h"
+#include "galois/filters/recurrent_layer.h"
+#include "galois/filters/seq_cross_entropy.h"
 #include "galois/models/ordered_model.h"
 #include "galois/optimizer.h"
 
 namespace gs
 {
 
+    // sentences are arrays of indexes, 0 is <EOS> and pads a sentence after its last token. the decoder reads
+    // <EOS> and then the target shifted by one step, and it learns the <EOS> after the last token as well
     template<typename T>
     class SeqEncoderDecoder : protected OrderedModel<T>
     {
         static default_random_engine galois_rn_generator;
 
+        // the network unrolled to len_encoder and len_decoder steps, a batch of sentences not longer than these
+        // is trained on it, and rows past their length are masked. filters of every bucket share params
+        struct Bucket {
+            size_t len_encoder;
+            size_t len_decoder;
+            OrderedNet<T> *net;
+            shared_ptr<OrderedNet<T>> own_net;
+            vector<SP_Signal<T>> input_signals;
+            vector<SP_Signal<T>> output_signals;
+            vector<shared_ptr<RecurrentLayer<T>>> encoder_layers;
+            vector<shared_ptr<RecurrentLayer<T>>> decoder_layers;
+            shared_ptr<SeqCrossEntropy<T>> projection;
+            vector<size_t> ids;     // train sentences in the bucket
+        };
+
     protected:
         size_t max_len_encoder;
         size_t max_len_decoder;
@@ -22,12 +41,29 @@ namespace gs
         size_t output_size;
         vector<size_t> hidden_sizes;
 
+        // filters holding the params, links of every bucket are shares of them
+        vector<SP_Filter<T>> encoder_layers = {};
+        vector<SP_Filter<T>> decoder_layers = {};
+        SP_Filter<T> projection = nullptr;
+        // the first bucket is the one of the longest sentences, on the net of the model
+        vector<Bucket> buckets = {};
+
         size_t train_seq_count = 0;
         SP_NArray<T> train_X = nullptr;
         SP_NArray<T> train_Y = nullptr;
+        vector<size_t> train_len_encoder = {};
+        vector<size_t> train_len_decoder = {};
+        // lengths of the rows of a batch
+        vector<size_t> len_encoder = {};
+        vector<size_t> len_decoder = {};
         size_t test_seq_count = 0;
         SP_NArray<T> test_X = nullptr;
         SP_NArray<T> test_Y = nullptr;
+
+    protected:
+        void _link(OrderedNet<T> &net, Bucket &bucket, vector<string> &x_ids, vector<string> &y_ids);
+        size_t _length(const SP_NArray<T> &sentences, size_t idx);
+
     public:
         SeqEncoderDecoder(
             size_t max_len_encoder,
@@ -45,6 +81,11 @@ namespace gs
         using OrderedModel<T>::get_params;
         using OrderedModel<T>::get_grads;
 
+        // sentences up to len_encoder and len_decoder long are trained on a network of these lengths instead
+        // of the longest one, it should be called before the train dataset is added. the network of a bucket
+        // is built outside of compile, so options of the model such as inference, replicas, hogwild workers
+        // and prefetch are not supported with buckets
+        void add_bucket(size_t len_encoder, size_t len_decoder);
         void add_train_dataset(const SP_NArray<T> data, const SP_NArray<T> target);
         void add_test_dataset(const SP_NArray<T> data, const SP_NArray<T> target);
         T train_one_batch(const bool update=true);
@@ -2,6 +2,8 @@
 #define _GALOIS_NARRAY_H_
 
 #include "galois/utils.h"
+#include "galois/allocator.h"
+#include "galois/shape.h"
 #include <random>
 #include <memory>
 #include <iostream>
@@ -19,26 +21,52 @@ namespace gs
     const int   NARRAY_DIM_ZERO = 0;
     const int   NARRAY_DIM_ONE = 1;
 
+    // an array owns its storage, or is a view with shape and strides over the storage of another one
+    // a view keeps that array alive, and writing through it writes to that array
     template<typename T>
-    class NArray
+    class NArray : public enable_shared_from_this<NArray<T>>
     {
     public:
         static default_random_engine galois_rn_generator;
 
-        explicit NArray(size_t m);
-        explicit NArray(size_t m, size_t n);
-        explicit NArray(size_t m, size_t n, size_t o);
-        explicit NArray(size_t m, size_t n, size_t o, size_t k);
-        explicit NArray(vector<size_t>);
+        // storage comes from the given allocator, or from the default one if it is empty
+        explicit NArray(size_t m, SP_Allocator allocator = nullptr);
+        explicit NArray(size_t m, size_t n, SP_Allocator allocator = nullptr);
+        explicit NArray(size_t m, size_t n, size_t o, SP_Allocator allocator = nullptr);
+        explicit NArray(size_t m, size_t n, size_t o, size_t k, SP_Allocator allocator = nullptr);
+        explicit NArray(const Shape&, SP_Allocator allocator = nullptr);
         NArray() = delete;
         NArray(const NArray& other) = delete;
         NArray& operator=(const NArray&) = delete;
         ~NArray();
 
-        vector<size_t> get_dims() { return dims; }
+        const Shape& get_dims() { return dims; }
         size_t get_size() { return size; }
-        T* get_data() { CHECK(data, "data should be non-empty"); return data; }
+        // elements in row major order, which is only the case for a contiguous array
+        T* get_data() {
+            CHECK(data, "data should be non-empty");
+            CHECK(contiguous, "data of a strided view should be read by get_strided_data");
+            return data;
+        }
+        // the first element, element (i0, i1, ...) is at sum of ik*strides[k]
+        T* get_strided_data() { CHECK(data, "data should be non-empty"); return data; }
+        const Shape& get_strides() { return strides; }
+        bool is_contiguous() { return contiguous; }
+        bool is_view() { return owner != nullptr; }
+        SP_Allocator get_allocator() { return allocator; }
         bool opaque() { return data_opaque; }
+        // let the array use memory inside of storage, such as the arena of a memory plan, storage is kept
+        // alive with the array. its own memory is released, the contents are not kept
+        void set_external_data(T *external, SP_NArray<T> storage) {
+            CHECK(external, "external data should be non-empty");
+            CHECK(storage && external >= storage->data && external + size <= storage->data + storage->size,
+                  "external data should be inside of its storage");
+            CHECK(!owner, "a view could not change its storage");
+            _deallocate();
+            data = external;
+            own_data = false;
+            this->storage = storage;
+        }
         void reopaque() { data_opaque = true; }
         void setclear() { data_opaque = false; }
 
@@ -46,7 +74,23 @@ namespace gs
         void copy_from(const vector<size_t> &, const SP_NArray<T>);
         void copy_from(const vector<size_t> &, size_t, const SP_NArray<T>);
         void copy_from(const size_t, const size_t, const SP_NArray<T>);
+        // views without copying, with the opaqueness of this array
+        // rows [begin, end) of the first dimension
+        SP_NArray<T> slice(size_t begin, size_t end);
+        // the same elements in other dimensions, only for a contiguous array
+        SP_NArray<T> reshape(const Shape &new_dims);
+        // dimensions a and b swapped
+        SP_NArray<T> transpose(size_t a = 0, size_t b = 1);
+        // the idx-th entry along a dimension, which is dropped, such as a time step of [batch, steps, ...]
+        SP_NArray<T> select(size_t dim, size_t idx);
+        // move a view by rows along its first dimension in place, rows could be negative
+        void slide(long rows);
+
+        // the raw elements in a binary file, load expects as many as the array has
+        void save(const string &path);
+        void load(const string &path);
         void uniform(T lower, T upper) {
+            CHECK(contiguous, "only a contiguous array could be filled");
             // future : move random generator to a single file
             uniform_real_distribution<T> distribution(lower, upper);
             for (size_t i = 0; i < get_size(); i++) {
@@ -56,21 +100,66 @@ namespace gs
         }
         void normalize_for(int dim);
         void fill(T x) {
+            CHECK(contiguous, "only a contiguous array could be filled");
             for (size_t i = 0; i < get_size(); i++) {
                 data[i] = x;
             }
             data_opaque = false;
         }
 
+        // a row sparse array knows which rows of its first dimension might be nonzero, all the others
+        // are zero. it is kept by PUT_ROWS, so grads of lookups could be read and cleared by the rows
+        // touched in a batch instead of the whole array. a writer of all elements breaks it
+        void set_row_sparse();
+        bool is_row_sparse() { return row_sparse; }
+        const vector<size_t>& get_sparse_rows() { return sparse_rows; }
+        size_t get_row_size() { return size / dims[0]; }
+        void mark_sparse_row(size_t row) {
+            if (!row_marks[row]) {
+                row_marks[row] = true;
+                sparse_rows.push_back(row);
+            }
+        }
+        // zero the marked rows and forget them
+        void clear_sparse_rows();
+
     private:
-        const vector<size_t> dims = {};
+        const Shape dims = {};
         size_t size = 0;
+        Shape strides = {};
+        bool contiguous = true;
+        SP_NArray<T> owner = nullptr;   // the array a view refers to
+        SP_NArray<T> storage = nullptr; // the array holding external data
         T *data = nullptr;
+        bool own_data = true;
         bool data_opaque = true;
+        SP_Allocator allocator = nullptr;
+
+        bool row_sparse = false;
+        vector<size_t> sparse_rows = {};
+        vector<bool> row_marks = {};
+
+        void _allocate(SP_Allocator);
+        void _deallocate();
+
+        NArray(const Shape &dims, const Shape &strides, T *data, SP_NArray<T> owner, bool opaque);
+        SP_NArray<T> _view(const Shape &dims, const Shape &strides, T *data);
+        // copy elements of a strided array in row major order to dst
+        static void _gather(T *dst, const T *src, const size_t *dims, const size_t *strides, size_t rank);
+        void _copy_rows(const size_t *idxs, size_t count, const SP_NArray<T> &dataset);
     };
     template<typename T>
     default_random_engine NArray<T>::galois_rn_generator(0);
 
+    // offsets of arrays laid one after another, each aligned as the storage of an array,
+    // with the total size as the last entry
+    template<typename T>
+    vector<size_t> flat_offsets(const vector<SP_NArray<T>> &arrays);
+    // move the contents of arrays into one buffer at flat_offsets and let them use it, the padding is zero
+    // the arrays keep the buffer alive, so they could outlive the one who flattened them
+    template<typename T>
+    SP_NArray<T> flatten(const vector<SP_NArray<T>> &arrays);
+
     template<typename T>
     ostream& operator<<(std::ostream &strm, const SP_NArray<T> M) {
         auto M_ptr = M->get_data();
@@ -1,7 +1,10 @@
 #ifndef _GALOIS_NARRAY_FUNCTORS_H_
 #define _GALOIS_NARRAY_FUNCTORS_H_
 
+#include "galois/narray_kernels.h"
 #include <cassert>
+#include <cmath>
+#include <algorithm>
 #include <vector>
 #if defined __APPLE__ && __MACH__
 #include <Accelerate/Accelerate.h>
@@ -15,7 +18,7 @@ namespace gs
 {
 
     template<typename T>
-    int COUNT_EQUAL(const SP_NArray<T> X, const SP_NArray<T> Y) {
+    int COUNT_EQUAL(const SP_NArray<T> &X, const SP_NArray<T> &Y) {
         CHECK(X != nullptr && Y != nullptr, "X and Y should not be null");
         CHECK(!X->opaque() && !Y->opaque(), "X and Y should not be opaque");
         auto X_dims = X->get_dims();
@@ -34,7 +37,7 @@ namespace gs
     }
 
     template<typename T>
-    void SUM_POSITIVE_VALUE (T *res, const SP_NArray<T> A) {
+    void SUM_POSITIVE_VALUE (T *res, const SP_NArray<T> &A) {
         T sum = 0;
         auto A_ptr = A->get_data();
         auto A_size = A->get_size();
@@ -47,7 +50,7 @@ namespace gs
     // currently, only two dimensional array are supported
     // b[n] +> Y[m,n]
     template<typename T>
-    void ADD_TO_ROW (const SP_NArray<T> Y, const SP_NArray<T> b) {
+    void ADD_TO_ROW (const SP_NArray<T> &Y, const SP_NArray<T> &b) {
         auto Y_dims = Y->get_dims();
         auto b_dims = b->get_dims();
         assert(Y_dims.size() == 2);
@@ -60,16 +63,12 @@ namespace gs
         auto b_ptr = b->get_data();
         if (Y->opaque()) {
             for (size_t i = 0; i < m; i++) {
-                for (size_t j = 0; j < n; j++) {
-                    Y_ptr[i*n+j] = b_ptr[j];
-                }
+                std::copy(b_ptr, b_ptr + n, Y_ptr + i*n);
             }
             Y->setclear();
         } else {
             for (size_t i = 0; i < m; i++) {
-                for (size_t j = 0; j < n; j++) {
-                    Y_ptr[i*n+j] += b_ptr[j];
-                }
+                vec_add(Y_ptr + i*n, b_ptr, n);
             }
         }
     }
@@ -77,7 +76,7 @@ namespace gs
     // currently, only two dimensional array are supported
     // Y[m,n] +> b[n]
     template<typename T>
-    void SUM_TO_ROW (const SP_NArray<T> b, const SP_NArray<T> X) {
+    void SUM_TO_ROW (const SP_NArray<T> &b, const SP_NArray<T> &X) {
         auto b_dims = b->get_dims();
         auto X_dims = X->get_dims();
         assert(b_dims.size() == 1);
@@ -89,26 +88,20 @@ namespace gs
         auto X_ptr = X->get_data();
         auto b_ptr = b->get_data();
         if (b->opaque()) {
-            for (size_t j = 0; j < n; j++) {
-                b_ptr[j] = X_ptr[j];
-            }
+            std::copy(X_ptr, X_ptr + n, b_ptr);
             b->setclear();
         } else {
-            for (size_t j = 0; j < n; j++) {
-                b_ptr[j] += X_ptr[j];
-            }
+            vec_add(b_ptr, X_ptr, n);
         }
         for (size_t i = 1; i < m; i++) {
-            for (size_t j = 0; j < n; j++) {
-                b_ptr[j] += X_ptr[i*n + j];
-            }
+            vec_add(b_ptr, X_ptr + i*n, n);
         }
     }
 
     // currently, only two dimensional array are supported
     // X[m,n] -> Y[m]
     template<typename T>
-    void MAXIDX_EACH_ROW(const SP_NArray<T> Y, const SP_NArray<T> X) {
+    void MAXIDX_EACH_ROW(const SP_NArray<T> &Y, const SP_NArray<T> &X) {
         CHECK(Y->opaque(), "Y should be opaque (not set before)");
         auto X_dims = X->get_dims();
         auto Y_dims = Y->get_dims();
@@ -137,7 +130,7 @@ namespace gs
     // currently, only two dimensional array are supported
     // X[m,n] -> Y[k,n] with k <= m
     template<typename T>
-    void TAKE_ROWS(const SP_NArray<T> Y, const SP_NArray<T> indexs, const SP_NArray<T> X) {
+    void TAKE_ROWS(const SP_NArray<T> &Y, const SP_NArray<T> &indexs, const SP_NArray<T> &X) {
         auto X_dims = X->get_dims();
         auto Y_dims = Y->get_dims();
         auto indexs_dims = indexs->get_dims();
@@ -175,7 +168,7 @@ namespace gs
     // currently, only two dimensional array are supported
     // Y[k,n] -> X[m,n] with k <= m
     template<typename T>
-    void PUT_ROWS(const SP_NArray<T> X, const SP_NArray<T> indexs, const SP_NArray<T> Y) {
+    void PUT_ROWS(const SP_NArray<T> &X, const SP_NArray<T> &indexs, const SP_NArray<T> &Y) {
         auto X_dims = X->get_dims();
         auto Y_dims = Y->get_dims();
         auto indexs_dims = indexs->get_dims();
@@ -190,13 +183,21 @@ namespace gs
         auto Y_ptr = Y->get_data();
         auto indexs_ptr = indexs->get_data();
 
+        // a row sparse X only has the rows of the last batch to be zeroed
         if (X->opaque()) {
-            X->fill(T(0.0));
+            if (X->is_row_sparse()) {
+                X->clear_sparse_rows();
+            } else {
+                X->fill(T(0.0));
+            }
             X->setclear();
         }
         for (size_t i = 0; i < k; i++) {
             size_t idx = size_t(indexs_ptr[i]);
             assert(idx >= 0 && idx < m);
+            if (X->is_row_sparse()) {
+                X->mark_sparse_row(idx);
+            }
             for (size_t j = 0; j < n; j++) {
                 X_ptr[idx*n+j] += Y_ptr[i*n+j];
             }
@@ -225,20 +226,45 @@ namespace gs
         cblas_dgemm(_order, _tranA, _tranB, _M, _N, _K, _alpha, _A, _lda, _B, _ldb, _beta, _C, _ldc);
     }
 
+    // a GEMM operand as a row major matrix, the first dimension by the rest for a contiguous array, or a 2
+    // dimensional view with contiguous rows, or contiguous columns which is read as a transposed matrix
+    template<typename L>
+    L* _gemm_operand(const SP_NArray<L> &X, int &rows, int &cols, int &ld, bool &flip) {
+        auto dims = X->get_dims();
+        rows = dims[0];
+        cols = X->get_size() / rows;
+        ld = cols;
+        flip = false;
+        if (X->is_contiguous()) {
+            return X->get_data();
+        }
+        auto strides = X->get_strides();
+        CHECK(dims.size() == 2, "a strided operand of GEMM should have 2 dimensions");
+        if (strides[1] == 1 || cols == 1) {
+            ld = max<int>(strides[0], cols);
+        } else if (strides[0] == 1 || rows == 1) {
+            ld = max<int>(strides[1], rows);
+            flip = true;
+        } else {
+            CHECK(false, "either rows or columns of an operand of GEMM should be contiguous");
+        }
+        return X->get_strided_data();
+    }
+
     template<typename L>
     void GEMM (const char tA, const char tB,
-               const L alpha, const SP_NArray<L> A, const SP_NArray<L> B,
-               const L beta, const SP_NArray<L> C) {
+               const L alpha, const SP_NArray<L> &A, const SP_NArray<L> &B,
+               const L beta, const SP_NArray<L> &C) {
         assert(tA == 'T' || tA == 'N');
         assert(tB == 'T' || tB == 'N');
-        int A0 = A->get_dims()[0];
-        int A1 = A->get_size() / A0;
-        int B0 = B->get_dims()[0];
-        int B1 = B->get_size() / B0;
-        int C0 = C->get_dims()[0];
-        int C1 = C->get_size() / C0;
-        auto t_A = tA=='T' ? CblasTrans : CblasNoTrans;
-        auto t_B = tB=='T' ? CblasTrans : CblasNoTrans;
+        int A0, A1, lda, B0, B1, ldb, C0, C1, ldc;
+        bool flip_A, flip_B, flip_C;
+        auto A_ptr = _gemm_operand(A, A0, A1, lda, flip_A);
+        auto B_ptr = _gemm_operand(B, B0, B1, ldb, flip_B);
+        auto C_ptr = _gemm_operand(C, C0, C1, ldc, flip_C);
+        CHECK(!flip_C, "the result of GEMM should have contiguous rows");
+        auto t_A = (tA=='T') != flip_A ? CblasTrans : CblasNoTrans;
+        auto t_B = (tB=='T') != flip_B ? CblasTrans : CblasNoTrans;
         auto M   = tA=='T' ? A1 : A0;
         auto K_A = tA=='T' ? A0 : A1;
         auto K_B = tB=='T' ? B1 : B0;
@@ -246,23 +272,20 @@ namespace gs
         assert(K_A == K_B);
         assert(C0 == M && C1 == N);
         auto K   = K_A;
-        auto lda = A1;
-        auto ldb = B1;
-        auto ldc = C1;
         _GEMM(CblasRowMajor,
               t_A, t_B,
               M, N, K,
               alpha,
-              A->get_data(), lda,
-              B->get_data(), ldb,
+              A_ptr, lda,
+              B_ptr, ldb,
               beta,
-              C->get_data(), ldc);
+              C_ptr, ldc);
     }
 
     template<typename L>
-    void GEMM (const SP_NArray<L> Y,
+    void GEMM (const SP_NArray<L> &Y,
                const char tA, const char tB,
-               const SP_NArray<L> A, const SP_NArray<L> B) {
+               const SP_NArray<L> &A, const SP_NArray<L> &B) {
         if (Y->opaque()) {
             GEMM(tA, tB, static_cast<L>(1.0), A, B, static_cast<L>(0.0), Y);
             Y->setclear();
@@ -272,9 +295,9 @@ namespace gs
     }
 
     template<typename T, typename FUNC>
-    void _MAP (const SP_NArray<T> Y,
+    void _MAP (const SP_NArray<T> &Y,
                const FUNC& f,
-               const SP_NArray<T> X,
+               const SP_NArray<T> &X,
                const bool overwrite) {
         assert(Y->get_dims() == X->get_dims());
         auto Y_ptr = Y->get_data();
@@ -291,9 +314,9 @@ namespace gs
     }
 
     template<typename T, typename FUNC>
-    void _MAP (const SP_NArray<T> Y,
+    void _MAP (const SP_NArray<T> &Y,
                const FUNC& f,
-               const SP_NArray<T> X, const SP_NArray<T> Z,
+               const SP_NArray<T> &X, const SP_NArray<T> &Z,
                const bool overwrite) {
         assert(Y->get_dims() == X->get_dims());
         assert(Y->get_dims() == Z->get_dims());
@@ -311,8 +334,89 @@ namespace gs
         }
     }
 
+    // Named functors for the common element-wise operations. They behave like the lambdas
+    // they replace, but _MAP recognizes them and runs the vectorized kernels in
+    // galois/narray_kernels.h; any other callable goes through the generic loops above.
+    template<typename T>
+    struct TanhOp {
+        T operator()(T x) const { return std::tanh(x); }
+    };
+
+    template<typename T>
+    struct ExpOp {
+        T operator()(T x) const { return std::exp(x); }
+    };
+
+    template<typename T>
+    struct LogOp {
+        T operator()(T x) const { return std::log(x); }
+    };
+
+    template<typename T>
+    struct ScaleOp {
+        T a;
+        explicit ScaleOp(T a) : a(a) {}
+        T operator()(T x) const { return a*x; }
+    };
+
+    // gradient of tanh from its output: (dy, y) -> dy*(1-y*y)
+    template<typename T>
+    struct TanhGradOp {
+        T operator()(T dy, T y) const { return dy*(1-y*y); }
+    };
+
+    // gradient of tanh from its input: (dy, x) -> dy*(1-tanh(x)*tanh(x))
+    template<typename T>
+    struct TanhGradInputOp {
+        T operator()(T dy, T x) const { T y = std::tanh(x); return dy*(1-y*y); }
+    };
+
+    template<typename T>
+    void _MAP (const SP_NArray<T> &Y, const TanhOp<T>&, const SP_NArray<T> &X, const bool overwrite) {
+        assert(Y->get_dims() == X->get_dims());
+        vec_tanh(Y->get_data(), X->get_data(), Y->get_size(), overwrite);
+    }
+
+    template<typename T>
+    void _MAP (const SP_NArray<T> &Y, const ExpOp<T>&, const SP_NArray<T> &X, const bool overwrite) {
+        assert(Y->get_dims() == X->get_dims());
+        vec_exp(Y->get_data(), X->get_data(), Y->get_size(), overwrite);
+    }
+
+    template<typename T>
+    void _MAP (const SP_NArray<T> &Y, const LogOp<T>&, const SP_NArray<T> &X, const bool overwrite) {
+        assert(Y->get_dims() == X->get_dims());
+        vec_log(Y->get_data(), X->get_data(), Y->get_size(), overwrite);
+    }
+
+    template<typename T>
+    void _MAP (const SP_NArray<T> &Y, const ScaleOp<T>& f, const SP_NArray<T> &X, const bool overwrite) {
+        assert(Y->get_dims() == X->get_dims());
+        vec_scale(Y->get_data(), f.a, X->get_data(), Y->get_size(), overwrite);
+    }
+
+    template<typename T>
+    void _MAP (const SP_NArray<T> &Y,
+               const TanhGradOp<T>&,
+               const SP_NArray<T> &DY, const SP_NArray<T> &X,
+               const bool overwrite) {
+        assert(Y->get_dims() == DY->get_dims());
+        assert(Y->get_dims() == X->get_dims());
+        vec_tanh_grad(Y->get_data(), DY->get_data(), X->get_data(), Y->get_size(), overwrite);
+    }
+
+    template<typename T>
+    void _MAP (const SP_NArray<T> &Y,
+               const TanhGradInputOp<T>&,
+               const SP_NArray<T> &DY, const SP_NArray<T> &X,
+               const bool overwrite) {
+        assert(Y->get_dims() == DY->get_dims());
+        assert(Y->get_dims() == X->get_dims());
+        vec_tanh_grad_input(Y->get_data(), DY->get_data(), X->get_data(), Y->get_size(), overwrite);
+    }
+
     template<typename T, typename FUNC>
-    void MAP (const SP_NArray<T> Y, const FUNC& f, const SP_NArray<T> X) {
+    void MAP (const SP_NArray<T> &Y, const FUNC& f, const SP_NArray<T> &X) {
         if (Y->opaque()) {
             _MAP(Y, f, X, true);
             Y->setclear();
@@ -322,9 +426,9 @@ namespace gs
     }
 
     template<typename T, typename FUNC>
-    void MAP (const SP_NArray<T> Y,
+    void MAP (const SP_NArray<T> &Y,
               const FUNC& f,
-              const SP_NArray<T> X, const SP_NArray<T> Z) {
+              const SP_NArray<T> &X, const SP_NArray<T> &Z) {
         if (Y->opaque()) {
             _MAP(Y, f, X, Z, true);
             Y->setclear();
@@ -336,10 +440,10 @@ namespace gs
     // currently, only two dimensional array are supported
     // X[m][n] -> Y[m]
     template<typename T, typename FUNC>
-    void _PROJ_MAP (const SP_NArray<T> Y,
+    void _PROJ_MAP (const SP_NArray<T> &Y,
                     const FUNC& f,
-                    const SP_NArray<T> X,
-                    const SP_NArray<T> idx,
+                    const SP_NArray<T> &X,
+                    const SP_NArray<T> &idx,
                     const bool overwrite) {
         assert(X->get_dims().size() == 2);
         assert(Y->get_dims().size() == 1);
@@ -370,10 +474,10 @@ namespace gs
     // currently, only two dimensional array are supported
     // X[m][n] -> Y[m]
     template<typename T, typename FUNC>
-    void PROJ_MAP (const SP_NArray<T> Y,
+    void PROJ_MAP (const SP_NArray<T> &Y,
                    const FUNC& f,
-                   const SP_NArray<T> X,
-                   const SP_NArray<T> idx) {
+                   const SP_NArray<T> &X,
+                   const SP_NArray<T> &idx) {
         if (Y->opaque()) {
             _PROJ_MAP(Y, f, X, idx, true);
             Y->setclear();
@@ -387,8 +491,8 @@ namespace gs
     template<typename T, typename FUNC>
     void PROJ_MAP_SUM (T *res,
                        const FUNC& f,
-                       const SP_NArray<T> X,
-                       const SP_NArray<T> idx) {
+                       const SP_NArray<T> &X,
+                       const SP_NArray<T> &idx) {
         assert(X->get_dims().size() == 2);
         auto m = X->get_dims()[0];
         auto n = X->get_dims()[1];
@@ -409,10 +513,10 @@ namespace gs
     // currently, only two dimensional array are supported
     // to be fixed
     template<typename T, typename FUNC>
-    void _SUB_MAP (const SP_NArray<T> Y,
+    void _SUB_MAP (const SP_NArray<T> &Y,
                    const FUNC& f,
-                   const SP_NArray<T> X,
-                   const SP_NArray<T> a, const SP_NArray<T> b,
+                   const SP_NArray<T> &X,
+                   const SP_NArray<T> &a, const SP_NArray<T> &b,
                    const bool overwrite) {
         assert(Y->get_dims() == X->get_dims());
         assert(Y->get_dims().size() == 2);
@@ -489,10 +593,10 @@ namespace gs
 
     // currently, only two dimensional array are supported
     template<typename T, typename FUNC>
-    void SUB_MAP (const SP_NArray<T> Y,
+    void SUB_MAP (const SP_NArray<T> &Y,
                   const FUNC& f,
-                  const SP_NArray<T> X,
-                  const SP_NArray<T> a, const SP_NArray<T> b) {
+                  const SP_NArray<T> &X,
+                  const SP_NArray<T> &a, const SP_NArray<T> &b) {
 //        if (Y->opaque()) {
 //            _SUB_MAP(Y, f, X, a, b, true);
 //            Y->setclear();
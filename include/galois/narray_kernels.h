@@ -0,0 +1,73 @@
+#ifndef _GALOIS_NARRAY_KERNELS_H_
+#define _GALOIS_NARRAY_KERNELS_H_
+
+#include <cstddef>
+
+namespace gs
+{
+
+    class ThreadPool;
+
+    // instruction set used by the vectorized elementwise kernels
+    // it is detected once from the cpu, and could be lowered (never raised)
+    // with the environment variable GALOIS_SIMD=none|sse4|avx2|avx512
+    enum SimdLevel { SIMD_NONE = 0, SIMD_SSE4 = 1, SIMD_AVX2 = 2, SIMD_AVX512 = 3 };
+
+    SimdLevel simd_level();
+    const char* simd_level_name(SimdLevel level);
+
+    // kernels over contiguous arrays of length n
+    // if overwrite then y = f(...), otherwise y += f(...)
+
+    // f(x) = tanh(x)
+    void vec_tanh(float *y, const float *x, size_t n, bool overwrite);
+    void vec_tanh(double *y, const double *x, size_t n, bool overwrite);
+    // f(x) = exp(x)
+    void vec_exp(float *y, const float *x, size_t n, bool overwrite);
+    void vec_exp(double *y, const double *x, size_t n, bool overwrite);
+    // f(x) = log(x)
+    void vec_log(float *y, const float *x, size_t n, bool overwrite);
+    void vec_log(double *y, const double *x, size_t n, bool overwrite);
+    // f(x) = a*x
+    void vec_scale(float *y, float a, const float *x, size_t n, bool overwrite);
+    void vec_scale(double *y, double a, const double *x, size_t n, bool overwrite);
+    // f(dy, y) = dy*(1-y*y), gradient of tanh from its output
+    void vec_tanh_grad(float *dx, const float *dy, const float *y, size_t n, bool overwrite);
+    void vec_tanh_grad(double *dx, const double *dy, const double *y, size_t n, bool overwrite);
+    // f(dy, x) = dy*(1-tanh(x)*tanh(x)), gradient of tanh from its input
+    void vec_tanh_grad_input(float *dx, const float *dy, const float *x, size_t n, bool overwrite);
+    void vec_tanh_grad_input(double *dx, const double *dy, const double *x, size_t n, bool overwrite);
+    // y += x
+    void vec_add(float *y, const float *x, size_t n);
+    void vec_add(double *y, const double *x, size_t n);
+
+    // optimizer steps over params p with grads g, the moment buffers are updated in place
+    // momentum: v = mu*v + g, p -= lr*v, or p -= lr*(g + mu*v) if nesterov
+    void vec_momentum_update(float *p, float *v, const float *g, size_t n, float lr, float mu, bool nesterov);
+    void vec_momentum_update(double *p, double *v, const double *g, size_t n, double lr, double mu, bool nesterov);
+    // rmsprop: s = rho*s + (1-rho)*g*g, p -= lr*g/(sqrt(s)+eps)
+    void vec_rmsprop_update(float *p, float *s, const float *g, size_t n, float lr, float rho, float eps);
+    void vec_rmsprop_update(double *p, double *s, const double *g, size_t n, double lr, double rho, double eps);
+    // adam: m = beta1*m + (1-beta1)*g, v = beta2*v + (1-beta2)*g*g, p -= lr*m/(sqrt(v)+eps)
+    // lr should already include the bias correction of the step
+    void vec_adam_update(float *p, float *m, float *v, const float *g, size_t n,
+                         float lr, float beta1, float beta2, float eps);
+    void vec_adam_update(double *p, double *m, double *v, const double *g, size_t n,
+                         double lr, double beta1, double beta2, double eps);
+
+    // softmax cross entropy over the rows of x[m,n] with targets t[m], each row is done in one sweep
+    // while it stays in cache. pred[i] = argmax of x[i], and the sum over rows of -log(softmax(x[i])[t[i]])
+    // is returned. if grad is not null, grad[i] = scale*(softmax(x[i]) - onehot(t[i])), and if losses is not
+    // null, losses[i] is the loss of row i
+    // the max of each row is subtracted before exp, so large logits do not overflow
+    // with a pool, rows are split in chunks run on it, large enough that a small batch stays on the caller
+    float vec_softmax_cross_entropy(float *grad, float *pred, const float *x, const float *t,
+                                    size_t m, size_t n, float scale,
+                                    float *losses = nullptr, ThreadPool *pool = nullptr);
+    double vec_softmax_cross_entropy(double *grad, double *pred, const double *x, const double *t,
+                                     size_t m, size_t n, double scale,
+                                     double *losses = nullptr, ThreadPool *pool = nullptr);
+
+}
+
+#endif
@@ -3,54 +3,124 @@
 
 #include "galois/base.h"
 #include "galois/utils.h"
+#include "galois/narray_functors.h"
+#include "galois/thread_pool.h"
 
 namespace gs
 {
 
+    // an optimizer updates all its params in one pass, which is split into chunks of about
+    // CHUNK_SIZE elements over consecutive params, and the chunks run on the pool if there is one
+    // moment buffers of all params live in one arena, see _state, laid out as params flattened by flatten
+    // for a row sparse grad only its marked rows are updated, and so are their moments
     template<typename T>
     class Optimizer
     {
+    public:
+        static const size_t CHUNK_SIZE = 1 << 16;
+
     protected:
         T lrate;
         vector<SP_NArray<T>>    params = {};
         vector<SP_NArray<T>>    grads = {};
 
+        size_t num_states = 0;          // number of moment buffers per param, set by subclasses
+        vector<size_t> offsets = {};    // flat_offsets of params
+        size_t state_size = 0;
+        SP_NArray<T> states = nullptr;
+
+        struct Piece { size_t param; size_t begin; size_t end; };
+        vector<vector<Piece>> chunks = {};      // pieces of params with dense grads
+        vector<size_t> sparse_params = {};      // params with row sparse grads
+        shared_ptr<ThreadPool> pool = nullptr;
+
+    protected:
+        // the k-th moment buffer of param i
+        T* _state(size_t k, size_t i) { return states->get_data() + k*state_size + offsets[i]; }
+        // called once before the pass of every update
+        virtual void _prepare() {}
+        // update elements [begin, end) of param i, the range runs into the following params if they are flattened
+        virtual void _step(size_t i, size_t begin, size_t end) = 0;
+
     public:
-        virtual void update() = 0;
-        virtual void compile(vector<SP_NArray<T>> params, vector<SP_NArray<T>> grads) = 0;
+        explicit Optimizer(T lr) : lrate(lr) {}
+        Optimizer(const Optimizer& other) = delete;
+        Optimizer& operator=(const Optimizer&) = delete;
+        virtual ~Optimizer() {}
+
+        void compile(vector<SP_NArray<T>> params, vector<SP_NArray<T>> grads);
+        void update();
+        // run the chunks of an update on num_threads threads (the caller included), 1 by default
+        void set_num_threads(size_t num_threads);
     };
     template<typename T>
     using SP_Optimizer = shared_ptr<Optimizer<T>>;
 
+    // p -= lr*g
     template<typename T>
     class SGD_Optimizer : public Optimizer<T>
     {
+    protected:
+        void _step(size_t i, size_t begin, size_t end) override;
+
+    public:
+        explicit SGD_Optimizer(T lr) : Optimizer<T>(lr) {}
+    };
+
+    // v = mu*v + g, p -= lr*v, or with nesterov p -= lr*(g + mu*v)
+    template<typename T>
+    class Momentum_Optimizer : public Optimizer<T>
+    {
+    private:
+        T mu;
+        bool nesterov;
+
+    protected:
+        void _step(size_t i, size_t begin, size_t end) override;
+
+    public:
+        Momentum_Optimizer(T lr, T mu=0.9, bool nesterov=false);
+    };
+
+    // s = rho*s + (1-rho)*g*g, p -= lr*g/(sqrt(s)+eps)
+    template<typename T>
+    class RMSProp_Optimizer : public Optimizer<T>
+    {
+    private:
+        T rho;
+        T eps;
+
+    protected:
+        void _step(size_t i, size_t begin, size_t end) override;
+
     public:
-        SGD_Optimizer(T lr) { this->lrate = lr; }
-
-        void compile(vector<SP_NArray<T>> params, vector<SP_NArray<T>> grads) override {
-            CHECK(this->params.empty() && this->grads.empty(), "params and grads should not be set before");
-            CHECK(params.size() == grads.size(), "params and grads should have equal size");
-            for (size_t i = 0; i < params.size(); i++) {
-                CHECK(params[i]->get_dims() == grads[i]->get_dims(), "param and grad should have the same dimensions");
-            }
-            this->params.insert(this->params.end(), params.begin(), params.end());
-            this->grads.insert(this->grads.end(), grads.begin(), grads.end());
-        }
-
-        void update() override {
-            for (size_t i = 0; i < this->params.size(); i++) {
-                auto param = this->params[i];
-                auto grad = this->grads[i];
-                CHECK(!param->opaque(), "param should not be opaque");
-                CHECK(!grad->opaque(), "grad should not be opaque");
-                T lrate = this->lrate;
-                MAP(param, [=](T x){return -lrate*x;}, grad);
-            }
-        }
+        RMSProp_Optimizer(T lr, T rho=0.9, T eps=1e-8);
+    };
 
+    // m = beta1*m + (1-beta1)*g, v = beta2*v + (1-beta2)*g*g, p -= lr_t*m/(sqrt(v)+eps)
+    // where lr_t = lr*sqrt(1-beta2^t)/(1-beta1^t) corrects the bias of moments at step t
+    template<typename T>
+    class Adam_Optimizer : public Optimizer<T>
+    {
+    private:
+        T beta1;
+        T beta2;
+        T eps;
+        size_t t = 0;
+        T lr_t = 0;
+
+    protected:
+        void _prepare() override;
+        void _step(size_t i, size_t begin, size_t end) override;
+
+    public:
+        Adam_Optimizer(T lr, T beta1=0.9, T beta2=0.999, T eps=1e-8);
     };
 
+    // sgd, momentum, nesterov, rmsprop or adam, with default hyper parameters
+    template<typename T>
+    SP_Optimizer<T> make_optimizer(const string &name, T lr);
+
 }
 
 #endif
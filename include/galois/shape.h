@@ -0,0 +1,74 @@
+#ifndef _GALOIS_SHAPE_H_
+#define _GALOIS_SHAPE_H_
+
+#include "galois/utils.h"
+#include <initializer_list>
+#include <vector>
+
+using namespace std;
+
+namespace gs
+{
+
+    const size_t MAX_RANK = 6;
+
+    // dimensions (or strides) of an array, kept inline up to MAX_RANK so that copying them never allocates
+    class Shape
+    {
+    private:
+        size_t nums[MAX_RANK] = {};
+        size_t rank = 0;
+
+    public:
+        Shape() {}
+        Shape(initializer_list<size_t> list) {
+            CHECK(list.size() <= MAX_RANK, "at most %zu dimensions are supported", MAX_RANK);
+            for (auto d : list) {
+                nums[rank++] = d;
+            }
+        }
+        Shape(const vector<size_t> &list) {
+            CHECK(list.size() <= MAX_RANK, "at most %zu dimensions are supported", MAX_RANK);
+            for (auto d : list) {
+                nums[rank++] = d;
+            }
+        }
+
+        size_t size() const { return rank; }
+        bool empty() const { return rank == 0; }
+        size_t& operator[](size_t k) { return nums[k]; }
+        const size_t& operator[](size_t k) const { return nums[k]; }
+        size_t* data() { return nums; }
+        const size_t* data() const { return nums; }
+        const size_t* begin() const { return nums; }
+        const size_t* end() const { return nums + rank; }
+
+        void push_back(size_t d) {
+            CHECK(rank < MAX_RANK, "at most %zu dimensions are supported", MAX_RANK);
+            nums[rank++] = d;
+        }
+        void erase(size_t k) {
+            for (size_t i = k; i+1 < rank; i++) {
+                nums[i] = nums[i+1];
+            }
+            rank--;
+        }
+        vector<size_t> to_vector() const { return vector<size_t>(begin(), end()); }
+
+        friend bool operator==(const Shape &a, const Shape &b) {
+            if (a.rank != b.rank) {
+                return false;
+            }
+            for (size_t k = 0; k < a.rank; k++) {
+                if (a.nums[k] != b.nums[k]) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        friend bool operator!=(const Shape &a, const Shape &b) { return !(a == b); }
+    };
+
+}
+
+#endif
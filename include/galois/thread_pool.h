@@ -0,0 +1,62 @@
+#ifndef _GALOIS_THREAD_POOL_H_
+#define _GALOIS_THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+namespace gs
+{
+
+    // work stealing thread pool
+    // every worker owns a deque, it pops its own tasks from the back and steals from the front of others
+    // the thread calling wait_all() works as the worker 0, so num_threads includes the caller
+    class ThreadPool
+    {
+    private:
+        struct TaskQueue
+        {
+            mutex m;
+            deque<function<void()>> tasks;
+        };
+
+        vector<unique_ptr<TaskQueue>> queues = {};
+        vector<thread> threads = {};
+
+        atomic<size_t> queued;      // tasks waiting in queues
+        atomic<size_t> pending;     // tasks submitted but not finished
+        atomic<size_t> next_queue;
+        bool stop = false;
+
+        mutex sleep_m;
+        condition_variable sleep_cv;
+
+    private:
+        bool _try_pop(size_t idx, function<void()> &task);
+        void _finish();
+        void _work(size_t idx);
+
+    public:
+        explicit ThreadPool(size_t num_threads);
+        ThreadPool(const ThreadPool& other) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+        ~ThreadPool();
+
+        size_t get_num_threads() { return queues.size(); }
+
+        // could be called from any thread, including from a running task
+        void submit(function<void()> task);
+        // run tasks on the calling thread until every submitted task is finished
+        void wait_all();
+    };
+
+}
+
+#endif
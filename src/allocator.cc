@@ -0,0 +1,204 @@
+#include "galois/allocator.h"
+#include "galois/utils.h"
+#include <cstdlib>
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace gs
+{
+
+    namespace
+    {
+
+        void* system_allocate(size_t bytes) {
+            void *ptr = nullptr;
+            // round up so that the block could be reused by any array of its class
+            size_t rounded = (bytes + Allocator::ALIGNMENT - 1) / Allocator::ALIGNMENT * Allocator::ALIGNMENT;
+            CHECK(posix_memalign(&ptr, Allocator::ALIGNMENT, max(rounded, Allocator::ALIGNMENT)) == 0,
+                  "failed to allocate %zu bytes", bytes);
+            return ptr;
+        }
+
+        const size_t MIN_CLASS_SHIFT = 6;       // 64 bytes
+        const size_t CLASSES_PER_SHIFT = 4;
+
+        int highest_bit(size_t x) {
+            return 8*sizeof(unsigned long long) - 1 - __builtin_clzll((unsigned long long)x);
+        }
+
+        mutex default_m;
+
+        SP_Allocator& default_allocator() {
+            static SP_Allocator allocator = nullptr;
+            if (!allocator) {
+                const char *env = getenv("GALOIS_ALLOCATOR");
+                if (env && strcmp(env, "system") == 0) {
+                    allocator = make_shared<SystemAllocator>();
+                } else {
+                    allocator = make_shared<PoolAllocator>();
+                }
+            }
+            return allocator;
+        }
+
+    }
+
+    AllocatorStats Allocator::get_stats() {
+        lock_guard<mutex> lock(m);
+        return stats;
+    }
+
+    void Allocator::reset_stats() {
+        lock_guard<mutex> lock(m);
+        auto bytes_in_use = stats.bytes_in_use;
+        auto bytes_cached = stats.bytes_cached;
+        stats = AllocatorStats();
+        stats.bytes_in_use = bytes_in_use;
+        stats.peak_bytes_in_use = bytes_in_use;
+        stats.bytes_cached = bytes_cached;
+    }
+
+    void Allocator::_count_allocation(size_t bytes) {
+        stats.allocations++;
+        stats.bytes_in_use += bytes;
+        stats.peak_bytes_in_use = max(stats.peak_bytes_in_use, stats.bytes_in_use);
+    }
+
+    void Allocator::_count_deallocation(size_t bytes) {
+        stats.deallocations++;
+        stats.bytes_in_use -= bytes;
+    }
+
+    void* SystemAllocator::allocate(size_t bytes) {
+        auto ptr = system_allocate(bytes);
+        lock_guard<mutex> lock(m);
+        _count_allocation(bytes);
+        stats.system_allocations++;
+        return ptr;
+    }
+
+    void SystemAllocator::deallocate(void *ptr, size_t bytes) {
+        if (!ptr) {
+            return;
+        }
+        free(ptr);
+        lock_guard<mutex> lock(m);
+        _count_deallocation(bytes);
+    }
+
+    PoolAllocator::PoolAllocator() : free_lists(size_class(MAX_POOLED_BYTES)+1) {}
+
+    PoolAllocator::~PoolAllocator() {
+        release();
+    }
+
+    size_t PoolAllocator::size_class(size_t bytes) {
+        if (bytes <= (size_t(1) << MIN_CLASS_SHIFT)) {
+            return 0;
+        }
+        size_t shift = highest_bit(bytes-1);
+        size_t step = (size_t(1) << shift) / CLASSES_PER_SHIFT;
+        size_t k = (bytes - (size_t(1) << shift) + step - 1) / step;
+        return 1 + (shift - MIN_CLASS_SHIFT) * CLASSES_PER_SHIFT + (k-1);
+    }
+
+    size_t PoolAllocator::class_bytes(size_t cls) {
+        if (cls == 0) {
+            return size_t(1) << MIN_CLASS_SHIFT;
+        }
+        size_t shift = MIN_CLASS_SHIFT + (cls-1) / CLASSES_PER_SHIFT;
+        size_t k = (cls-1) % CLASSES_PER_SHIFT + 1;
+        return (size_t(1) << shift) + k * ((size_t(1) << shift) / CLASSES_PER_SHIFT);
+    }
+
+    void* PoolAllocator::allocate(size_t bytes) {
+        if (bytes > MAX_POOLED_BYTES) {
+            auto ptr = system_allocate(bytes);
+            lock_guard<mutex> lock(m);
+            _count_allocation(bytes);
+            stats.system_allocations++;
+            return ptr;
+        }
+        auto cls = size_class(bytes);
+        {
+            lock_guard<mutex> lock(m);
+            _count_allocation(bytes);
+            auto &list = free_lists[cls];
+            if (!list.empty()) {
+                auto ptr = list.back();
+                list.pop_back();
+                stats.pool_hits++;
+                stats.bytes_cached -= class_bytes(cls);
+                return ptr;
+            }
+            stats.system_allocations++;
+        }
+        return system_allocate(class_bytes(cls));
+    }
+
+    void PoolAllocator::deallocate(void *ptr, size_t bytes) {
+        if (!ptr) {
+            return;
+        }
+        lock_guard<mutex> lock(m);
+        _count_deallocation(bytes);
+        if (bytes > MAX_POOLED_BYTES) {
+            free(ptr);
+            return;
+        }
+        auto cls = size_class(bytes);
+        free_lists[cls].push_back(ptr);
+        stats.bytes_cached += class_bytes(cls);
+    }
+
+    void PoolAllocator::release() {
+        lock_guard<mutex> lock(m);
+        for (auto &list : free_lists) {
+            for (auto ptr : list) {
+                free(ptr);
+            }
+            list.clear();
+        }
+        stats.bytes_cached = 0;
+    }
+
+    void* MmapAllocator::allocate(size_t bytes) {
+        auto path = dir + "/galois-XXXXXX";
+        vector<char> name(path.begin(), path.end());
+        name.push_back('\0');
+        int fd = mkstemp(name.data());
+        CHECK(fd >= 0, "failed to create a file in %s", dir.c_str());
+        unlink(name.data());
+        auto length = max(bytes, size_t(1));
+        CHECK(ftruncate(fd, length) == 0, "failed to extend a file in %s to %zu bytes", dir.c_str(), bytes);
+        auto ptr = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        CHECK(ptr != MAP_FAILED, "failed to map %zu bytes", bytes);
+        lock_guard<mutex> lock(m);
+        _count_allocation(bytes);
+        stats.system_allocations++;
+        return ptr;
+    }
+
+    void MmapAllocator::deallocate(void *ptr, size_t bytes) {
+        if (!ptr) {
+            return;
+        }
+        munmap(ptr, max(bytes, size_t(1)));
+        lock_guard<mutex> lock(m);
+        _count_deallocation(bytes);
+    }
+
+    SP_Allocator get_default_allocator() {
+        lock_guard<mutex> lock(default_m);
+        return default_allocator();
+    }
+
+    void set_default_allocator(SP_Allocator allocator) {
+        CHECK(allocator, "allocator should be non-empty");
+        lock_guard<mutex> lock(default_m);
+        default_allocator() = allocator;
+    }
+
+}
@@ -1,12 +1,12 @@
 #include "galois/narray.h"
+#include "galois/narray_functors.h"
 #include "galois/filters/convolution.h"
+#include <algorithm>
 
 using namespace std;
 
 namespace gs {
 
-    // TODO: optimization
-
     template<typename T>
     SP_Filter<T> Convolution<T>::share() {
         CHECK(in_signal == nullptr, "in signal should not be set");
@@ -103,12 +103,16 @@ namespace gs {
         } else {
             CHECK(in_signal->get_data_dims() == expected_in_sizes, "the dimensions of in signal are wrong");
         }
-        auto expected_out_sizes = vector<size_t>{batch_size, num_rows - kernel_rows + 1, num_columns - kernel_columns + 1, out_channels};
+        auto out_rows = num_rows - kernel_rows + 1;
+        auto out_columns = num_columns - kernel_columns + 1;
+        auto expected_out_sizes = vector<size_t>{batch_size, out_rows, out_columns, out_channels};
         if (out_signal->empty()) {
             out_signal->set_data_dims(expected_out_sizes);
         } else {
             CHECK(out_signal->get_data_dims() == expected_out_sizes, "the dimensions of out signal are wrong");
         }
+        CHECK(col == nullptr, "col should not be set before");
+        col = make_shared<NArray<T>>(batch_size * out_rows * out_columns, kernel_rows * kernel_columns * in_channels);
     }
 
     template<typename T>
@@ -127,160 +131,139 @@ namespace gs {
         return vector<SP_NArray<T>>{ this->dw, this->db };
     }
 
-    /* optimize with GEMM */
+    // X[batch, rows, columns, ic] -> col[(batch, i, j), (m, n, ic)] = X[batch, i+m, j+n, ic]
+    template<typename T>
+    static void im2col(T *col_ptr, const T *in_ptr,
+                       size_t batch_size, size_t num_rows, size_t num_columns, size_t in_channels,
+                       size_t kernel_rows, size_t kernel_columns) {
+        auto out_rows = num_rows - kernel_rows + 1;
+        auto out_columns = num_columns - kernel_columns + 1;
+        // for fixed (batch, i+m), the kernel_columns x in_channels window is contiguous in X
+        auto span = kernel_columns * in_channels;
+        auto in_s2 = num_columns * in_channels;
+        auto in_s3 = num_rows * in_s2;
+        for (size_t batch = 0; batch < batch_size; batch++) {
+            for (size_t i = 0; i < out_rows; i++) {
+                for (size_t j = 0; j < out_columns; j++) {
+                    for (size_t m = 0; m < kernel_rows; m++) {
+                        auto src = in_ptr + batch*in_s3 + (i+m)*in_s2 + j*in_channels;
+                        copy(src, src + span, col_ptr);
+                        col_ptr += span;
+                    }
+                }
+            }
+        }
+    }
+
+    // col[(batch, i, j), (m, n, ic)] +> X[batch, i+m, j+n, ic]
+    template<typename T>
+    static void col2im(T *in_ptr, const T *col_ptr,
+                       size_t batch_size, size_t num_rows, size_t num_columns, size_t in_channels,
+                       size_t kernel_rows, size_t kernel_columns) {
+        auto out_rows = num_rows - kernel_rows + 1;
+        auto out_columns = num_columns - kernel_columns + 1;
+        auto span = kernel_columns * in_channels;
+        auto in_s2 = num_columns * in_channels;
+        auto in_s3 = num_rows * in_s2;
+        for (size_t batch = 0; batch < batch_size; batch++) {
+            for (size_t i = 0; i < out_rows; i++) {
+                for (size_t j = 0; j < out_columns; j++) {
+                    for (size_t m = 0; m < kernel_rows; m++) {
+                        auto dst = in_ptr + batch*in_s3 + (i+m)*in_s2 + j*in_channels;
+                        for (size_t k = 0; k < span; k++) {
+                            dst[k] += col_ptr[k];
+                        }
+                        col_ptr += span;
+                    }
+                }
+            }
+        }
+    }
+
+    // Y[(batch, i, j), oc] = col[(batch, i, j), (m, n, ic)] * w[(m, n, ic), oc] + b[oc]
     template<typename T>
     void Convolution<T>::forward() {
         auto in_data = in_signal->get_data();
         CHECK(!in_data->opaque(), "in_data should not be opaque");
         auto out_data = out_signal->get_data();
 
-        // TODO: abstract the following as functionality of narray without performance overhead
-        auto in_data_ptr = in_data->get_data(); // batch_size x num_rows x num_columns x in_channels
-        auto in_size = in_data->get_dims();
-        auto in_s1 = in_size[3];
-        auto in_s2 = in_s1 * in_size[2];
-        auto in_s3 = in_s2 * in_size[1];
-        auto out_data_ptr = out_data->get_data(); // batch_size x num_rows` x num_columns` x out_channels
-        auto out_size = out_data->get_dims();
-        auto out_s1 = out_size[3];
-        auto out_s2 = out_s1 * out_size[2];
-        auto out_s3 = out_s2 * out_size[1];
-        auto w_ptr = this->w->get_data(); // kernel_rows x kernel_columns x in_channels x out_channels
-        auto w_size = this->w->get_dims();
-        auto w_s1 = w_size[3];
-        auto w_s2 = w_s1 * w_size[2];
-        auto w_s3 = w_s2 * w_size[1];
-        auto b_ptr = this->b->get_data();
-        // Y[i, j, oc] = sum(m, n, ic)(w[m, n, ic, oc]*X[i+m, j+m, ic]) + b[oc]
         auto batch_size = in_data->get_dims()[0];
-        bool overwrite = out_data->opaque(); // if opaque, then overwrite
-        for (size_t batch = 0; batch < batch_size; batch++) {
-            for (size_t i = 0; i < out_size[1]; i++) {
-                for (size_t j = 0; j < out_size[2]; j++) {
-                    for (size_t oc = 0; oc < out_channels; oc++) {
-                        T sum = 0;
-                        for (size_t m = 0; m < kernel_rows; m++) {
-                            for (size_t n = 0; n < kernel_columns; n++) {
-                                for (size_t ic = 0; ic < in_channels; ic++) {
-                                    sum += w_ptr[m*w_s3 + n*w_s2 + ic*w_s1 + oc] *
-                                           in_data_ptr[batch*in_s3 + (i+m)*in_s2 + (j+n)*in_s1 + ic];
-                                }
-                            }
-                        }
-                        sum += b_ptr[oc];
-                        if (overwrite) {
-                            out_data_ptr[batch*out_s3 + i*out_s2 + j*out_s1 + oc] = sum;
-                        } else {
-                            out_data_ptr[batch*out_s3 + i*out_s2 + j*out_s1 + oc] += sum;
-                        }
-                    }
-                }
+        im2col(col->get_data(), in_data->get_data(),
+               batch_size, num_rows, num_columns, in_channels, kernel_rows, kernel_columns);
+
+        int M = col->get_dims()[0];
+        int K = col->get_dims()[1];
+        int N = out_channels;
+        T beta = out_data->opaque() ? 0 : 1; // if opaque, then overwrite
+        auto out_data_ptr = out_data->get_data();
+        _GEMM(CblasRowMajor, CblasNoTrans, CblasNoTrans,
+              M, N, K,
+              static_cast<T>(1), col->get_data(), K,
+              this->w->get_data(), N,
+              beta, out_data_ptr, N);
+
+        auto b_ptr = this->b->get_data();
+        for (int r = 0; r < M; r++) {
+            for (int oc = 0; oc < N; oc++) {
+                out_data_ptr[r*N + oc] += b_ptr[oc];
             }
         }
         out_data->setclear();
     }
 
-    /* optimize with GEMM */
+    // col still holds the lowered input of the last forward
     template<typename T>
     void Convolution<T>::backward() {
         auto in_data = in_signal->get_data();
         auto out_grad = out_signal->get_grad();
         CHECK(!out_grad->opaque(), "out_grad should not be opaque");
 
-        auto in_data_ptr = in_data->get_data(); // batch_size x num_rows x num_columns x in_channels
-        auto in_size = in_data->get_dims();
-        auto in_s1 = in_size[3];
-        auto in_s2 = in_s1 * in_size[2];
-        auto in_s3 = in_s2 * in_size[1];
-        auto out_grad_ptr = out_grad->get_data(); // batch_size x num_rows` x num_columns` x in_channels
-        auto out_size = out_grad->get_dims();
-        auto out_s1 = out_size[3];
-        auto out_s2 = out_s1 * out_size[2];
-        auto out_s3 = out_s2 * out_size[1];
-        auto dw_ptr = this->dw->get_data(); // num_rows x num_columns x in_channels x out_channels
-        auto dw_size = this->dw->get_dims();
-        auto dw_s1 = dw_size[3];
-        auto dw_s2 = dw_s1 * dw_size[2];
-        auto dw_s3 = dw_s2 * dw_size[1];
-        auto batch_size = in_data->get_dims()[0];
+        int M = col->get_dims()[0];
+        int K = col->get_dims()[1];
+        int N = out_channels;
+        auto out_grad_ptr = out_grad->get_data();
 
-        if (in_signal->get_type() == InnerSignal) {
-            auto in_grad = in_signal->get_grad();
-            auto in_grad_ptr = in_grad->get_data();
-            auto w_ptr = this->w->get_data();
-            bool dx_overwrite = in_grad->opaque();
-            // D(X)[s, t, ic] = sum(m, n, oc)(D(Y)[s-m, t-n, oc] * w[m, n, ic, oc])
-            for (size_t batch = 0; batch < batch_size; batch++) {
-                for (size_t s = 0; s < num_rows; s++) {
-                    for (size_t t = 0; t < num_columns; t++) {
-                        for (size_t ic = 0; ic < in_channels; ic++) {
-                            T sum = 0;
-                            for (size_t m = 0; m < kernel_rows; m++) {
-                                for (size_t n = 0; n < kernel_rows; n++) {
-                                    for (size_t oc = 0; oc < out_channels; oc++) {
-                                        if ((s - m) >= 0 && (s - m) < out_size[1] && (t - n) >= 0 && (t - n) < out_size[2]) {
-                                            sum += out_grad_ptr[batch*out_s3 + (s-m)*out_s2 + (t-n)*out_s1 + oc] *
-                                                w_ptr[m*dw_s3 + n*dw_s2 + ic*dw_s1 + oc];
-                                        }
-                                    }
-                                }
-                            }
-                            if (dx_overwrite) {
-                                in_grad_ptr[batch*in_s3 + s*in_s2 + t*in_s1 + ic] = sum;
-                            } else {
-                                in_grad_ptr[batch*in_s3 + s*in_s2 + t*in_s1 + ic] += sum;
-                            }
-                        }
-                    }
-                }
-            }
-            in_grad->setclear();
-        }
+        if (!this->is_params_fixed()) {
+            // D(w)[(m, n, ic), oc] = col^T[(m, n, ic), (batch, i, j)] * D(Y)[(batch, i, j), oc]
+            T dw_beta = this->dw->opaque() ? 0 : 1;
+            _GEMM(CblasRowMajor, CblasTrans, CblasNoTrans,
+                  K, N, M,
+                  static_cast<T>(1), col->get_data(), K,
+                  out_grad_ptr, N,
+                  dw_beta, this->dw->get_data(), N);
+            this->dw->setclear();
 
-        // D(w)[m, n, ic, oc] = sum(i, j)(D(Y)[i, j, oc] * X[i+m, j+n, ic])
-        bool dw_overwrite = this->dw->opaque();
-        for (size_t m = 0; m < kernel_rows; m++) {
-            for (size_t n = 0; n < kernel_columns; n++) {
-                for (size_t ic = 0; ic < in_channels; ic++) {
-                    for (size_t oc = 0; oc < out_channels; oc++) {
-                        T sum = 0;
-                        for (size_t batch = 0; batch < batch_size; batch++) {
-                            for (size_t i = 0; i < out_size[1]; i++) {
-                                for (size_t j = 0; j < out_size[2]; j++) {
-                                    sum += out_grad_ptr[batch*out_s3 + i*out_s2 + j*out_s1 + oc] *
-                                           in_data_ptr[batch*in_s3 + (i+m)*in_s2 + (j+n)*in_s1 + ic];
-                                }
-                            }
-                        }
-                        if (dw_overwrite) {
-                            dw_ptr[m*dw_s3 + n*dw_s2 + ic*dw_s1 + oc] = sum;
-                        } else {
-                            dw_ptr[m*dw_s3 + n*dw_s2 + ic*dw_s1 + oc] += sum;
-                        }
-                    }
-                }
+            // D(b)[oc] = sum(batch, i, j)(D(Y)[(batch, i, j), oc])
+            auto db_ptr = this->db->get_data();
+            if (this->db->opaque()) {
+                fill(db_ptr, db_ptr + N, static_cast<T>(0));
+                this->db->setclear();
             }
-        }
-        this->dw->setclear();
-        auto db_ptr = this->db->get_data();
-        // D(b)[oc] = sum(i, j)(D(Y)[i, j, oc])
-        bool db_overwrite = this->db->opaque();
-        for (size_t oc = 0; oc < out_channels; oc++) {
-            T sum = 0;
-            for (size_t batch = 0; batch < batch_size; batch++) {
-                for (size_t i = 0; i < out_size[1]; i++) {
-                    for (size_t j = 0; j < out_size[2]; j++) {
-                        sum += out_grad_ptr[batch*out_s3 + i*out_s2 + j*out_s1 + oc];
-                    }
+            for (int r = 0; r < M; r++) {
+                for (int oc = 0; oc < N; oc++) {
+                    db_ptr[oc] += out_grad_ptr[r*N + oc];
                 }
             }
-            if (db_overwrite) {
-                db_ptr[oc] = sum;
-            } else {
-                db_ptr[oc] += sum;
+        }
+
+        if (in_signal->requires_grad()) {
+            // D(col)[(batch, i, j), (m, n, ic)] = D(Y)[(batch, i, j), oc] * w^T[oc, (m, n, ic)]
+            // the lowered input is not needed any more, so col is reused for D(col)
+            _GEMM(CblasRowMajor, CblasNoTrans, CblasTrans,
+                  M, K, N,
+                  static_cast<T>(1), out_grad_ptr, N,
+                  this->w->get_data(), N,
+                  static_cast<T>(0), col->get_data(), K);
+
+            auto in_grad = in_signal->get_grad();
+            if (in_grad->opaque()) {
+                in_grad->fill(0);
             }
+            auto batch_size = in_data->get_dims()[0];
+            col2im(in_grad->get_data(), col->get_data(),
+                   batch_size, num_rows, num_columns, in_channels, kernel_rows, kernel_columns);
+            in_grad->setclear();
         }
-        this->db->setclear();
     }
 
     template class Convolution<float>;
@@ -1,7 +1,9 @@
 #include "galois/narray.h"
 #include "galois/narray_functors.h"
+#include "galois/narray_kernels.h"
 #include "galois/filters/cross_entropy.h"
 #include <cmath>
+#include <algorithm>
 
 namespace gs {
 
@@ -27,7 +29,10 @@ namespace gs {
 
         CHECK(out_signal->get_type() == OutputSignal, "OutputSignal is needed");
         CHECK(out_signal->empty(), "out signal should be empty");
-        softmax_output = make_shared<NArray<T>>(in_dims);
+        // inference needs no grad
+        if (this->is_backward_needed()) {
+            in_grad_cache = make_shared<NArray<T>>(in_dims);
+        }
         out_signal->set_data_dims(batch_size);
         out_signal->set_target_dims(batch_size);
         out_signal->initialize_loss();
@@ -39,30 +44,36 @@ namespace gs {
         auto out_data = out_signal->get_data();
         CHECK(!in_data->opaque(), "in_data should not be opaque");
         CHECK(out_data->opaque(), "out_data should be opaque");
-        CHECK(softmax_output->opaque(), "this should be opaque");
 
-        // softmax function
-        MAP(softmax_output, [](T x){return exp(x);}, in_data);
-        softmax_output->normalize_for(NARRAY_DIM_ZERO);
-
-        // compute prediction
-        MAXIDX_EACH_ROW(out_data, softmax_output);
-
-        // compute loss
+        // prediction, loss and grad in one sweep over each row of in_data
         auto target = out_signal->get_target();
         auto loss = out_signal->get_loss();
-        PROJ_MAP_SUM(loss.get(), [](T x){return -log(x);}, softmax_output, target);
+        size_t m = in_data->get_dims()[0];
+        size_t n = in_data->get_size() / m;
+        T *grad_ptr = nullptr;
+        if (this->is_backward_needed()) {
+            CHECK(in_grad_cache->opaque(), "this should be opaque");
+            grad_ptr = in_grad_cache->get_data();
+            in_grad_cache->setclear();
+        }
+        *loss = vec_softmax_cross_entropy(grad_ptr, out_data->get_data(), in_data->get_data(), target->get_data(),
+                                          m, n, 1/static_cast<T>(m));
         *loss /= target->get_size();
+        out_data->setclear();
     }
 
     template<typename T>
     void CrossEntropy<T>::backward() {
+        CHECK(!this->is_inference(), "backward should not be called in inference mode");
         auto in_grad = in_signal->get_grad();
-        auto target = out_signal->get_target();
-        CHECK(!softmax_output->opaque() && !target->opaque(), "out_grad should not be opaque");
-        int batch_size = in_signal->get_data_dims()[0];
-        MAP(in_grad, [batch_size](T y){return y/static_cast<T>(batch_size);}, softmax_output);
-        SUB_MAP(in_grad, [batch_size](T y){return -1/static_cast<T>(batch_size);}, in_grad, SP_NArray<T>(nullptr), target);
+        CHECK(!in_grad_cache->opaque(), "forward should be called before backward");
+        auto size = in_grad->get_size();
+        if (in_grad->opaque()) {
+            copy(in_grad_cache->get_data(), in_grad_cache->get_data() + size, in_grad->get_data());
+            in_grad->setclear();
+        } else {
+            vec_add(in_grad->get_data(), in_grad_cache->get_data(), size);
+        }
     }
 
     template class CrossEntropy<float>;
@@ -26,6 +26,7 @@ namespace gs {
         res->w = make_shared<NArray<T>>(this->w->get_dims());
         res->w->copy_from(this->w);
         res->dw = make_shared<NArray<T>>(this->dw->get_dims());
+        res->dw->set_row_sparse();
         return res;
     }
 
@@ -36,6 +37,8 @@ namespace gs {
         this->w  = make_shared<NArray<T>>(in_size, out_size);
         this->w->uniform(-s, s);
         this->dw = make_shared<NArray<T>>(in_size, out_size);
+        // a batch touches at most batch_size rows of dw
+        this->dw->set_row_sparse();
     }
 
     template<typename T>
@@ -35,7 +35,7 @@ namespace gs {
         auto in_data = in_signal->get_data();
         auto out_data = out_signal->get_data();
 
-        MAP(out_data, [](T x){ return tanh(x); }, in_data);
+        MAP(out_data, TanhOp<T>(), in_data);
     }
 
     template<typename T>
@@ -44,7 +44,7 @@ namespace gs {
         auto in_grad = in_signal->get_grad();
         auto out_grad = out_signal->get_grad();
 
-        MAP(in_grad, [](T dy, T x){return dy*(1-tanh(x)*tanh(x));}, out_grad, in_data);
+        MAP(in_grad, TanhGradInputOp<T>(), out_grad, in_data);
     }
 
     template class GeneralTanh<float>;
@@ -102,7 +102,7 @@ namespace gs {
     void Linear<T>::backward() {
         auto out_grad = out_signal->get_grad();
         CHECK(!out_grad->opaque(), "out_grad should not be opaque");
-        if (in_signal->get_type() == InnerSignal) {
+        if (in_signal->requires_grad()) {
             auto in_grad = in_signal->get_grad();
             GEMM(in_grad, 'N', 'T', out_grad, this->w);
         }
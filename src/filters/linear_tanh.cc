@@ -0,0 +1,171 @@
+#include "galois/narray.h"
+#include "galois/narray_functors.h"
+#include "galois/narray_kernels.h"
+#include "galois/filters/linear_tanh.h"
+
+using namespace std;
+
+namespace gs {
+
+    // a block of the output is kept around this many bytes, so that it is still in cache for the epilogue
+    const size_t LINEAR_TANH_BLOCK_BYTES = 256 * 1024;
+
+    template<typename T>
+    SP_Filter<T> LinearTanh<T>::share() {
+        bool just_for_share = true;
+        auto res = make_shared<LinearTanh<T>>(just_for_share);
+        res->in_size = this->in_size;
+        res->out_size = this->out_size;
+        res->w = this->w;
+        res->b = this->b;
+        res->dw = this->dw;
+        res->db = this->db;
+        return res;
+    }
+
+    template<typename T>
+    SP_Filter<T> LinearTanh<T>::clone() {
+        bool for_clone_or_share = true;
+        auto res = make_shared<LinearTanh<T>>(for_clone_or_share);
+        res->in_size = this->in_size;
+        res->out_size = this->out_size;
+        res->w = make_shared<NArray<T>>(this->w->get_dims());
+        res->w->copy_from(this->w);
+        res->b = make_shared<NArray<T>>(this->b->get_dims());
+        res->b->copy_from(this->b);
+        res->dw = make_shared<NArray<T>>(this->dw->get_dims());
+        res->db = make_shared<NArray<T>>(this->db->get_dims());
+        return res;
+    }
+
+    template<typename T>
+    LinearTanh<T>::LinearTanh(size_t in_size, size_t out_size) : in_size(in_size), out_size(out_size) {
+        CHECK(in_size > 0 && out_size > 0, "both size should be positive");
+        T s = sqrt(6. / (in_size + out_size));
+        this->w  = make_shared<NArray<T>>(in_size, out_size);
+        this->w->uniform(-s, s);
+        this->b  = make_shared<NArray<T>>(out_size);
+        this->b->uniform(-s, s);
+        this->dw = make_shared<NArray<T>>(in_size, out_size);
+        this->db = make_shared<NArray<T>>(out_size);
+    }
+
+    template<typename T>
+    void LinearTanh<T>::install_signals(const vector<SP_Signal<T>> &in_signals, const vector<SP_Signal<T>> &out_signals) {
+        CHECK(in_signals.size() == 1, "only need 1 in signal");
+        CHECK(out_signals.size() == 1, "only need 1 out signal");
+
+        in_signal = in_signals[0];
+        out_signal = out_signals[0];
+    }
+
+    template<typename T>
+    void LinearTanh<T>::set_dims(size_t batch_size) {
+        if (in_signal->empty()) {
+            in_signal->set_data_dims(batch_size, in_size);
+        } else {
+            auto in_dims = in_signal->get_data_dims();
+            auto in_batch_size = in_dims[0];
+            auto in_rest_dim = in_signal->get_data()->get_size() / in_batch_size;
+            CHECK(in_dims.size() >= 2 && in_batch_size == batch_size && in_rest_dim == in_size, "the dimension of in signal is wrong");
+        }
+        if (out_signal->empty()) {
+            out_signal->set_data_dims(batch_size, out_size);
+        } else {
+            CHECK(out_signal->get_data_dims() == vector<size_t>({batch_size, out_size}), "the dimension of out signal is wrong");
+        }
+        block_rows = min(batch_size, max<size_t>(1, LINEAR_TANH_BLOCK_BYTES / (out_size * sizeof(T))));
+        if (this->is_backward_needed()) {
+            block_grad = make_shared<NArray<T>>(block_rows, out_size);
+        }
+    }
+
+    template<typename T>
+    void LinearTanh<T>::reopaque() {
+        this->dw->reopaque();
+        this->db->reopaque();
+    }
+
+    template<typename T>
+    vector<SP_NArray<T>> LinearTanh<T>::get_params() {
+        return vector<SP_NArray<T>>{ this->w, this->b };
+    }
+
+    template<typename T>
+    vector<SP_NArray<T>> LinearTanh<T>::get_grads() {
+        return vector<SP_NArray<T>>{ this->dw, this->db };
+    }
+
+    template<typename T>
+    void LinearTanh<T>::forward() {
+        auto in_data = in_signal->get_data();
+        CHECK(!in_data->opaque(), "in_data should not be opaque");
+        auto out_data = out_signal->get_data();
+        CHECK(out_data->opaque(), "the out signal of LinearTanh should not be written by the other filters");
+
+        size_t batch_size = out_data->get_dims()[0];
+        auto x = in_data->get_data();
+        auto y = out_data->get_data();
+        auto w_ptr = this->w->get_data();
+        auto b_ptr = this->b->get_data();
+        for (size_t r = 0; r < batch_size; r += block_rows) {
+            size_t m = min(block_rows, batch_size - r);
+            _GEMM(CblasRowMajor, CblasNoTrans, CblasNoTrans, m, out_size, in_size,
+                  T(1), x + r*in_size, in_size, w_ptr, out_size, T(0), y + r*out_size, out_size);
+            for (size_t i = r; i < r + m; i++) {
+                vec_add(y + i*out_size, b_ptr, out_size);
+            }
+            vec_tanh(y + r*out_size, y + r*out_size, m*out_size, true);
+        }
+        out_data->setclear();
+    }
+
+    template<typename T>
+    void LinearTanh<T>::backward() {
+        auto out_data = out_signal->get_data();
+        auto out_grad = out_signal->get_grad();
+        CHECK(!out_grad->opaque() && !out_data->opaque(), "these should not be opaque");
+
+        bool in_grad_needed = in_signal->requires_grad();
+        bool params_needed = !this->is_params_fixed();
+        SP_NArray<T> in_grad = in_grad_needed ? in_signal->get_grad() : nullptr;
+        T in_beta = in_grad_needed && !in_grad->opaque() ? T(1) : T(0);
+        T dw_beta = this->dw->opaque() ? T(0) : T(1);
+        if (params_needed && this->db->opaque()) {
+            this->db->fill(T(0));
+        }
+
+        size_t batch_size = out_data->get_dims()[0];
+        auto x = in_signal->get_data()->get_data();
+        auto y = out_data->get_data();
+        auto dy = out_grad->get_data();
+        auto dz = block_grad->get_data();
+        for (size_t r = 0; r < batch_size; r += block_rows) {
+            size_t m = min(block_rows, batch_size - r);
+            vec_tanh_grad(dz, dy + r*out_size, y + r*out_size, m*out_size, true);
+            if (in_grad_needed) {
+                _GEMM(CblasRowMajor, CblasNoTrans, CblasTrans, m, in_size, out_size,
+                      T(1), dz, out_size, this->w->get_data(), out_size, in_beta, in_grad->get_data() + r*in_size, in_size);
+            }
+            if (params_needed) {
+                _GEMM(CblasRowMajor, CblasTrans, CblasNoTrans, in_size, out_size, m,
+                      T(1), x + r*in_size, in_size, dz, out_size, dw_beta, this->dw->get_data(), out_size);
+                dw_beta = T(1);
+                for (size_t i = 0; i < m; i++) {
+                    vec_add(this->db->get_data(), dz + i*out_size, out_size);
+                }
+            }
+        }
+        if (in_grad_needed) {
+            in_grad->setclear();
+        }
+        if (params_needed) {
+            this->dw->setclear();
+            this->db->setclear();
+        }
+    }
+
+    template class LinearTanh<float>;
+    template class LinearTanh<double>;
+
+}
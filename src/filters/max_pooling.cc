@@ -58,9 +58,12 @@ namespace gs {
         } else {
             CHECK(expected_out_dims == out_signal->get_data_dims(), "wrong dimensions for out signal");
         }
-        this->max_indexes = make_shared<NArray<T>>(
-            vector<size_t>{ batch_size, out_rows, out_columns, channels, 2 }
-        );
+        // positions of maximums are only used by backward
+        if (this->is_backward_needed()) {
+            this->max_indexes = make_shared<NArray<T>>(
+                vector<size_t>{ batch_size, out_rows, out_columns, channels, 2 }
+            );
+        }
     }
 
     template<typename T>
@@ -80,7 +83,7 @@ namespace gs {
         auto out_s2 = out_s1 * out_size[2];
         auto out_s3 = out_s2 * out_size[1];
         auto batch_size = in_size[0];
-        auto max_indexes_ptr = max_indexes->get_data();
+        T *max_indexes_ptr = max_indexes ? max_indexes->get_data() : nullptr;
         bool overwrite = out_data->opaque();
         for (size_t batch = 0; batch < batch_size; batch++) {
             for (size_t i = 0; i < out_size[1]; i++) {
@@ -105,8 +108,10 @@ namespace gs {
                         } else {
                             out_data_ptr[offset] += max;
                         }
-                        max_indexes_ptr[offset*2 + 0] = i*stride_rows + max_shift_m;
-                        max_indexes_ptr[offset*2 + 1] = j*stride_columns + max_shift_n;
+                        if (max_indexes_ptr) {
+                            max_indexes_ptr[offset*2 + 0] = i*stride_rows + max_shift_m;
+                            max_indexes_ptr[offset*2 + 1] = j*stride_columns + max_shift_n;
+                        }
                     }
                 }
             }
@@ -116,6 +121,7 @@ namespace gs {
 
     template<typename T>
     void MaxPooling<T>::backward() {
+        CHECK(!this->is_inference(), "backward should not be called in inference mode");
         auto in_grad = in_signal->get_grad();
         auto out_grad = out_signal->get_grad();
         CHECK(!out_grad->opaque(), "out_grad should not be opaque")
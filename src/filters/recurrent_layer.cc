@@ -0,0 +1,389 @@
+#include "galois/narray.h"
+#include "galois/narray_functors.h"
+#include "galois/narray_kernels.h"
+#include "galois/filters/recurrent_layer.h"
+
+using namespace std;
+
+namespace gs {
+
+    template<typename T>
+    SP_Filter<T> RecurrentLayer<T>::share() {
+        bool just_for_share = true;
+        auto res = make_shared<RecurrentLayer<T>>(just_for_share);
+        res->in_size = this->in_size;
+        res->hidden_size = this->hidden_size;
+        res->use_embedding = this->use_embedding;
+        res->wx = this->wx;
+        res->wh = this->wh;
+        res->b = this->b;
+        res->dwx = this->dwx;
+        res->dwh = this->dwh;
+        res->db = this->db;
+        return res;
+    }
+
+    template<typename T>
+    SP_Filter<T> RecurrentLayer<T>::clone() {
+        bool for_clone_or_share = true;
+        auto res = make_shared<RecurrentLayer<T>>(for_clone_or_share);
+        res->in_size = this->in_size;
+        res->hidden_size = this->hidden_size;
+        res->use_embedding = this->use_embedding;
+        res->wx = make_shared<NArray<T>>(this->wx->get_dims());
+        res->wx->copy_from(this->wx);
+        res->wh = make_shared<NArray<T>>(this->wh->get_dims());
+        res->wh->copy_from(this->wh);
+        res->b = make_shared<NArray<T>>(this->b->get_dims());
+        res->b->copy_from(this->b);
+        res->dwx = make_shared<NArray<T>>(this->dwx->get_dims());
+        res->dwh = make_shared<NArray<T>>(this->dwh->get_dims());
+        res->db = make_shared<NArray<T>>(this->db->get_dims());
+        return res;
+    }
+
+    template<typename T>
+    RecurrentLayer<T>::RecurrentLayer(size_t in_size, size_t hidden_size, bool use_embedding)
+            : in_size(in_size), hidden_size(hidden_size), use_embedding(use_embedding) {
+        CHECK(in_size > 0 && hidden_size > 0, "both size should be positive");
+        T sx = sqrt(6. / (in_size + hidden_size));
+        T sh = sqrt(6. / (hidden_size + hidden_size));
+        this->wx  = make_shared<NArray<T>>(in_size, hidden_size);
+        this->wx->uniform(-sx, sx);
+        this->wh  = make_shared<NArray<T>>(hidden_size, hidden_size);
+        this->wh->uniform(-sh, sh);
+        this->b   = make_shared<NArray<T>>(hidden_size);
+        this->b->uniform(-sh, sh);
+        this->dwx = make_shared<NArray<T>>(in_size, hidden_size);
+        this->dwh = make_shared<NArray<T>>(hidden_size, hidden_size);
+        this->db  = make_shared<NArray<T>>(hidden_size);
+    }
+
+    template<typename T>
+    void RecurrentLayer<T>::set_lengths(const vector<size_t> &lengths) {
+        CHECK(lengths.empty() || lengths.size() == batch_size, "there should be a length for each row");
+        this->lengths.assign(lengths.begin(), lengths.end());
+    }
+
+    template<typename T>
+    size_t RecurrentLayer<T>::_active_rows(size_t t) {
+        if (lengths.empty()) {
+            return batch_size;
+        }
+        size_t active = 0;
+        for (size_t i = 0; i < batch_size; i++) {
+            if (lengths[i] > t) {
+                active = i+1;
+            }
+        }
+        return active;
+    }
+
+    template<typename T>
+    void RecurrentLayer<T>::install_signals(const vector<SP_Signal<T>> &in_signals, const vector<SP_Signal<T>> &out_signals) {
+        CHECK(!out_signals.empty(), "need at least 1 out signal");
+        CHECK(in_signals.size() == out_signals.size() || in_signals.size() == out_signals.size()+1,
+              "need 1 in signal for each step, and optionally the initial state");
+
+        num_steps = out_signals.size();
+        this->in_signals.assign(in_signals.begin(), in_signals.begin()+num_steps);
+        this->out_signals = out_signals;
+        if (in_signals.size() > num_steps) {
+            initial_signal = in_signals.back();
+        }
+    }
+
+    template<typename T>
+    void RecurrentLayer<T>::set_dims(size_t batch_size) {
+        this->batch_size = batch_size;
+        for (auto in_signal : in_signals) {
+            if (use_embedding) {
+                if (in_signal->empty()) {
+                    in_signal->set_data_dims(batch_size);
+                } else {
+                    CHECK(in_signal->get_data_dims() == vector<size_t>({batch_size}), "the dimension of in signal is wrong");
+                }
+            } else {
+                if (in_signal->empty()) {
+                    in_signal->set_data_dims(batch_size, in_size);
+                } else {
+                    auto in_dims = in_signal->get_data_dims();
+                    auto in_rest_dim = in_signal->get_data()->get_size() / in_dims[0];
+                    CHECK(in_dims.size() >= 2 && in_dims[0] == batch_size && in_rest_dim == in_size, "the dimension of in signal is wrong");
+                }
+            }
+        }
+        auto hidden_dims = vector<size_t>({batch_size, hidden_size});
+        if (initial_signal) {
+            if (initial_signal->empty()) {
+                initial_signal->set_data_dims(hidden_dims);
+            } else {
+                CHECK(initial_signal->get_data_dims() == hidden_dims, "the dimension of initial state is wrong");
+            }
+        }
+        for (auto out_signal : out_signals) {
+            if (out_signal->empty()) {
+                out_signal->set_data_dims(hidden_dims);
+            } else {
+                CHECK(out_signal->get_data_dims() == hidden_dims, "the dimension of out signal is wrong");
+            }
+        }
+
+        CHECK(hs == nullptr, "buffers should not be set before");
+        auto rows = num_steps * batch_size;
+        hs = make_shared<NArray<T>>(rows, hidden_size);
+        if (!use_embedding) {
+            xs = make_shared<NArray<T>>(rows, in_size);
+        }
+        if (this->is_backward_needed()) {
+            dhs = make_shared<NArray<T>>(rows, hidden_size);
+            carry = make_shared<NArray<T>>(batch_size, hidden_size);
+            bool has_inner_input = false;
+            for (auto in_signal : in_signals) {
+                has_inner_input = has_inner_input || in_signal->requires_grad();
+            }
+            if (!use_embedding && has_inner_input) {
+                dxs = make_shared<NArray<T>>(rows, in_size);
+            }
+        }
+    }
+
+    template<typename T>
+    void RecurrentLayer<T>::reopaque() {
+        this->dwx->reopaque();
+        this->dwh->reopaque();
+        this->db->reopaque();
+    }
+
+    template<typename T>
+    vector<SP_NArray<T>> RecurrentLayer<T>::get_params() {
+        return vector<SP_NArray<T>>{ this->wx, this->wh, this->b };
+    }
+
+    template<typename T>
+    vector<SP_NArray<T>> RecurrentLayer<T>::get_grads() {
+        return vector<SP_NArray<T>>{ this->dwx, this->dwh, this->db };
+    }
+
+    template<typename T>
+    void RecurrentLayer<T>::forward() {
+        int B = batch_size;
+        int H = hidden_size;
+        int rows = num_steps * batch_size;
+        auto hs_ptr = hs->get_data();
+        auto wx_ptr = wx->get_data();
+        auto wh_ptr = wh->get_data();
+        auto b_ptr = b->get_data();
+
+        // input projection of all steps with the bias, hs = xs * wx + b
+        if (use_embedding) {
+            for (size_t t = 0; t < num_steps; t++) {
+                auto in_data = in_signals[t]->get_data();
+                CHECK(!in_data->opaque(), "in_data should not be opaque");
+                auto idx_ptr = in_data->get_data();
+                for (int i = 0; i < B; i++) {
+                    if (!lengths.empty() && t >= lengths[i]) {
+                        continue;
+                    }
+                    size_t idx = size_t(idx_ptr[i]);
+                    CHECK(idx < in_size, "invalid index");
+                    auto dst = hs_ptr + (t*B + i)*H;
+                    auto src = wx_ptr + idx*H;
+                    for (int k = 0; k < H; k++) {
+                        dst[k] = src[k] + b_ptr[k];
+                    }
+                }
+            }
+        } else {
+            auto xs_ptr = xs->get_data();
+            for (size_t t = 0; t < num_steps; t++) {
+                auto in_data = in_signals[t]->get_data();
+                CHECK(!in_data->opaque(), "in_data should not be opaque");
+                copy(in_data->get_data(), in_data->get_data() + B*in_size, xs_ptr + t*B*in_size);
+            }
+            for (int i = 0; i < rows; i++) {
+                copy(b_ptr, b_ptr + H, hs_ptr + i*H);
+            }
+            _GEMM(CblasRowMajor, CblasNoTrans, CblasNoTrans,
+                  rows, H, in_size,
+                  T(1), xs_ptr, in_size,
+                  wx_ptr, H,
+                  T(1), hs_ptr, H);
+        }
+
+        // recurrence, h[t] = tanh(hs[t] + h[t-1] * wh)
+        for (size_t t = 0; t < num_steps; t++) {
+            auto h_ptr = hs_ptr + t*B*H;
+            const T *prev_ptr = nullptr;
+            if (t > 0) {
+                prev_ptr = h_ptr - B*H;
+            } else if (initial_signal) {
+                auto initial_data = initial_signal->get_data();
+                CHECK(!initial_data->opaque(), "initial state should not be opaque");
+                prev_ptr = initial_data->get_data();
+            }
+            int active = _active_rows(t);
+            if (prev_ptr && active > 0) {
+                _GEMM(CblasRowMajor, CblasNoTrans, CblasNoTrans,
+                      active, H, H,
+                      T(1), prev_ptr, H,
+                      wh_ptr, H,
+                      T(1), h_ptr, H);
+            }
+            vec_tanh(h_ptr, h_ptr, active*H, true);
+            for (size_t i = 0; i < lengths.size(); i++) {
+                if (t >= lengths[i]) {
+                    if (prev_ptr) {
+                        copy(prev_ptr + i*H, prev_ptr + (i+1)*H, h_ptr + i*H);
+                    } else {
+                        fill(h_ptr + i*H, h_ptr + (i+1)*H, T(0));
+                    }
+                }
+            }
+
+            auto out_data = out_signals[t]->get_data();
+            if (out_data->opaque()) {
+                copy(h_ptr, h_ptr + B*H, out_data->get_data());
+                out_data->setclear();
+            } else {
+                vec_add(out_data->get_data(), h_ptr, B*H);
+            }
+        }
+    }
+
+    template<typename T>
+    void RecurrentLayer<T>::backward() {
+        CHECK(!this->is_inference(), "backward should not be called in inference mode");
+        int B = batch_size;
+        int H = hidden_size;
+        int rows = num_steps * batch_size;
+        auto hs_ptr = hs->get_data();
+        auto dhs_ptr = dhs->get_data();
+        auto wx_ptr = wx->get_data();
+        auto wh_ptr = wh->get_data();
+
+        // grads before tanh, from the last step to the first
+        for (int t = num_steps-1; t >= 0; t--) {
+            auto dh_ptr = dhs_ptr + t*B*H;
+            auto out_grad = out_signals[t]->get_grad();
+            // the grad of an out signal nobody reads stays opaque
+            if (out_grad && !out_grad->opaque()) {
+                copy(out_grad->get_data(), out_grad->get_data() + B*H, dh_ptr);
+            } else {
+                fill(dh_ptr, dh_ptr + B*H, T(0));
+            }
+            if (t < int(num_steps)-1) {
+                int next_active = _active_rows(t+1);
+                if (next_active > 0) {
+                    _GEMM(CblasRowMajor, CblasNoTrans, CblasTrans,
+                          next_active, H, H,
+                          T(1), dh_ptr + B*H, H,
+                          wh_ptr, H,
+                          T(1), dh_ptr, H);
+                }
+                // a state kept over step t+1 gets the grad kept from there
+                for (size_t i = 0; i < lengths.size(); i++) {
+                    if (size_t(t+1) >= lengths[i]) {
+                        vec_add(dh_ptr + i*H, carry->get_data() + i*H, H);
+                    }
+                }
+            }
+            for (size_t i = 0; i < lengths.size(); i++) {
+                if (size_t(t) >= lengths[i]) {
+                    copy(dh_ptr + i*H, dh_ptr + (i+1)*H, carry->get_data() + i*H);
+                    fill(dh_ptr + i*H, dh_ptr + (i+1)*H, T(0));
+                }
+            }
+            vec_tanh_grad(dh_ptr, dh_ptr, hs_ptr + t*B*H, _active_rows(t)*H, true);
+        }
+
+        if (initial_signal && initial_signal->requires_grad()) {
+            auto initial_grad = initial_signal->get_grad();
+            T beta = initial_grad->opaque() ? 0 : 1;
+            _GEMM(CblasRowMajor, CblasNoTrans, CblasTrans,
+                  B, H, H,
+                  T(1), dhs_ptr, H,
+                  wh_ptr, H,
+                  beta, initial_grad->get_data(), H);
+            for (size_t i = 0; i < lengths.size(); i++) {
+                if (lengths[i] == 0) {
+                    vec_add(initial_grad->get_data() + i*H, carry->get_data() + i*H, H);
+                }
+            }
+            initial_grad->setclear();
+        }
+        if (dxs) {
+            auto dxs_ptr = dxs->get_data();
+            _GEMM(CblasRowMajor, CblasNoTrans, CblasTrans,
+                  rows, in_size, H,
+                  T(1), dhs_ptr, H,
+                  wx_ptr, H,
+                  T(0), dxs_ptr, in_size);
+            for (size_t t = 0; t < num_steps; t++) {
+                if (!in_signals[t]->requires_grad()) {
+                    continue;
+                }
+                auto in_grad = in_signals[t]->get_grad();
+                auto src = dxs_ptr + t*B*in_size;
+                if (in_grad->opaque()) {
+                    copy(src, src + B*in_size, in_grad->get_data());
+                    in_grad->setclear();
+                } else {
+                    vec_add(in_grad->get_data(), src, B*in_size);
+                }
+            }
+        }
+
+        if (this->is_params_fixed()) {
+            return;
+        }
+
+        // dwh = sum of h[t-1]^T * dh[t]
+        if (dwh->opaque()) {
+            dwh->fill(0);
+        }
+        if (num_steps > 1) {
+            _GEMM(CblasRowMajor, CblasTrans, CblasNoTrans,
+                  H, H, rows - B,
+                  T(1), hs_ptr, H,
+                  dhs_ptr + B*H, H,
+                  T(1), dwh->get_data(), H);
+        }
+        if (initial_signal) {
+            _GEMM(CblasRowMajor, CblasTrans, CblasNoTrans,
+                  H, H, B,
+                  T(1), initial_signal->get_data()->get_data(), H,
+                  dhs_ptr, H,
+                  T(1), dwh->get_data(), H);
+        }
+
+        if (use_embedding) {
+            if (dwx->opaque()) {
+                dwx->fill(0);
+            }
+            auto dwx_ptr = dwx->get_data();
+            for (size_t t = 0; t < num_steps; t++) {
+                auto idx_ptr = in_signals[t]->get_data()->get_data();
+                for (int i = 0; i < B; i++) {
+                    if (!lengths.empty() && t >= lengths[i]) {
+                        continue;
+                    }
+                    vec_add(dwx_ptr + size_t(idx_ptr[i])*H, dhs_ptr + (t*B + i)*H, H);
+                }
+            }
+        } else {
+            T beta = dwx->opaque() ? 0 : 1;
+            _GEMM(CblasRowMajor, CblasTrans, CblasNoTrans,
+                  in_size, H, rows,
+                  T(1), xs->get_data(), in_size,
+                  dhs_ptr, H,
+                  beta, dwx->get_data(), H);
+            dwx->setclear();
+        }
+        SUM_TO_ROW(this->db, dhs);
+    }
+
+    template class RecurrentLayer<float>;
+    template class RecurrentLayer<double>;
+
+}
@@ -0,0 +1,259 @@
+#include "galois/narray.h"
+#include "galois/narray_functors.h"
+#include "galois/narray_kernels.h"
+#include "galois/filters/seq_cross_entropy.h"
+#include <cmath>
+#include <algorithm>
+
+namespace gs {
+
+    template<typename T>
+    SP_Filter<T> SeqCrossEntropy<T>::share() {
+        bool just_for_share = true;
+        auto res = make_shared<SeqCrossEntropy<T>>(just_for_share);
+        res->in_size = this->in_size;
+        res->out_size = this->out_size;
+        res->w = this->w;
+        res->b = this->b;
+        res->dw = this->dw;
+        res->db = this->db;
+        res->pool = this->pool;
+        return res;
+    }
+
+    template<typename T>
+    SP_Filter<T> SeqCrossEntropy<T>::clone() {
+        bool for_clone_or_share = true;
+        auto res = make_shared<SeqCrossEntropy<T>>(for_clone_or_share);
+        res->in_size = this->in_size;
+        res->out_size = this->out_size;
+        res->w = make_shared<NArray<T>>(this->w->get_dims());
+        res->w->copy_from(this->w);
+        res->b = make_shared<NArray<T>>(this->b->get_dims());
+        res->b->copy_from(this->b);
+        res->dw = make_shared<NArray<T>>(this->dw->get_dims());
+        res->db = make_shared<NArray<T>>(this->db->get_dims());
+        return res;
+    }
+
+    template<typename T>
+    SeqCrossEntropy<T>::SeqCrossEntropy(size_t in_size, size_t out_size) : in_size(in_size), out_size(out_size) {
+        CHECK(in_size > 0 && out_size > 0, "both size should be positive");
+        T s = sqrt(6. / (in_size + out_size));
+        this->w  = make_shared<NArray<T>>(in_size, out_size);
+        this->w->uniform(-s, s);
+        this->b  = make_shared<NArray<T>>(out_size);
+        this->b->uniform(-s, s);
+        this->dw = make_shared<NArray<T>>(in_size, out_size);
+        this->db = make_shared<NArray<T>>(out_size);
+    }
+
+    template<typename T>
+    void SeqCrossEntropy<T>::set_lengths(const vector<size_t> &lengths) {
+        CHECK(lengths.empty() || lengths.size() == batch_size, "there should be a length for each row");
+        this->lengths.assign(lengths.begin(), lengths.end());
+    }
+
+    template<typename T>
+    void SeqCrossEntropy<T>::set_num_threads(size_t num_threads) {
+        CHECK(num_threads > 0, "at least one thread is needed");
+        if (num_threads == 1) {
+            pool = nullptr;
+        } else {
+            pool = make_shared<ThreadPool>(num_threads);
+        }
+    }
+
+    template<typename T>
+    void SeqCrossEntropy<T>::install_signals(const vector<SP_Signal<T>> &in_signals, const vector<SP_Signal<T>> &out_signals) {
+        CHECK(!in_signals.empty() && in_signals.size() == out_signals.size(), "each step needs 1 in signal and 1 out signal");
+        for (auto const& out_signal : out_signals) {
+            CHECK(out_signal->get_type() == OutputSignal, "OutputSignal is needed");
+        }
+
+        this->in_signals = in_signals;
+        this->out_signals = out_signals;
+    }
+
+    template<typename T>
+    void SeqCrossEntropy<T>::set_dims(size_t batch_size) {
+        for (auto const& in_signal : in_signals) {
+            CHECK(!in_signal->empty(), "in signal should be initialized");
+            CHECK(in_signal->get_data_dims() == vector<size_t>({batch_size, in_size}), "the dimension of in signal is wrong");
+        }
+        for (auto const& out_signal : out_signals) {
+            CHECK(out_signal->empty(), "out signal should be empty");
+            out_signal->set_data_dims(batch_size);
+            out_signal->set_target_dims(batch_size);
+            out_signal->initialize_loss();
+        }
+
+        this->batch_size = batch_size;
+        step_rows.assign(in_signals.size(), batch_size);
+        size_t rows = in_signals.size() * batch_size;
+        row_targets = make_shared<NArray<T>>(rows);
+        row_predictions = make_shared<NArray<T>>(rows);
+        row_losses = make_shared<NArray<T>>(rows);
+        states = make_shared<NArray<T>>(rows, in_size);
+        logits = make_shared<NArray<T>>(rows, out_size);
+        if (this->is_backward_needed()) {
+            logits_grad = make_shared<NArray<T>>(rows, out_size);
+            bool in_grad_needed = false;
+            for (auto const& in_signal : in_signals) {
+                in_grad_needed = in_grad_needed || in_signal->requires_grad();
+            }
+            if (in_grad_needed) {
+                states_grad = make_shared<NArray<T>>(rows, in_size);
+            }
+        }
+    }
+
+    template<typename T>
+    void SeqCrossEntropy<T>::reopaque() {
+        this->dw->reopaque();
+        this->db->reopaque();
+        logits->reopaque();
+        if (logits_grad) {
+            logits_grad->reopaque();
+        }
+    }
+
+    template<typename T>
+    vector<SP_NArray<T>> SeqCrossEntropy<T>::get_params() {
+        return vector<SP_NArray<T>>{ this->w, this->b };
+    }
+
+    template<typename T>
+    vector<SP_NArray<T>> SeqCrossEntropy<T>::get_grads() {
+        return vector<SP_NArray<T>>{ this->dw, this->db };
+    }
+
+    template<typename T>
+    void SeqCrossEntropy<T>::forward() {
+        // rows of all steps are packed into states, in the order of steps
+        auto states_ptr = states->get_data();
+        num_rows = 0;
+        for (size_t t = 0; t < in_signals.size(); t++) {
+            auto in_data = in_signals[t]->get_data();
+            CHECK(!in_data->opaque(), "in_data should not be opaque");
+            auto in_ptr = in_data->get_data();
+            size_t rows = 0;
+            for (size_t i = 0; i < batch_size; i++) {
+                if (_is_active(t, i)) {
+                    copy(in_ptr + i*in_size, in_ptr + (i+1)*in_size, states_ptr + (num_rows + rows)*in_size);
+                    rows++;
+                }
+            }
+            step_rows[t] = rows;
+            num_rows += rows;
+        }
+        states->setclear();
+
+        CHECK(logits->opaque(), "logits should be opaque");
+        auto logits_ptr = logits->get_data();
+        auto b_ptr = this->b->get_data();
+        _GEMM(CblasRowMajor, CblasNoTrans, CblasNoTrans, num_rows, out_size, in_size,
+              T(1), states_ptr, in_size, this->w->get_data(), out_size, T(0), logits_ptr, out_size);
+        for (size_t r = 0; r < num_rows; r++) {
+            vec_add(logits_ptr + r*out_size, b_ptr, out_size);
+        }
+        logits->setclear();
+
+        // prediction, loss and grad of each step, the same as CrossEntropy. targets are packed as the rows,
+        // so the softmax of all of them is one call, and predictions and losses are put back to the steps
+        size_t m = batch_size;
+        T *grad_ptr = nullptr;
+        if (logits_grad) {
+            CHECK(logits_grad->opaque(), "this should be opaque");
+            grad_ptr = logits_grad->get_data();
+            logits_grad->setclear();
+        }
+        auto targets_ptr = row_targets->get_data();
+        auto predictions_ptr = row_predictions->get_data();
+        auto losses_ptr = row_losses->get_data();
+        for (size_t t = 0, r = 0; t < out_signals.size(); t++) {
+            auto target_ptr = out_signals[t]->get_target()->get_data();
+            for (size_t i = 0; i < m; i++) {
+                if (_is_active(t, i)) {
+                    targets_ptr[r++] = target_ptr[i];
+                }
+            }
+        }
+        if (num_rows > 0) {
+            vec_softmax_cross_entropy(grad_ptr, predictions_ptr, logits_ptr, targets_ptr, num_rows, out_size,
+                                      1/static_cast<T>(m), losses_ptr, pool.get());
+        }
+        for (size_t t = 0, r = 0; t < out_signals.size(); t++) {
+            auto out_data = out_signals[t]->get_data();
+            CHECK(out_data->opaque(), "out_data should be opaque");
+            auto out_ptr = out_data->get_data();
+            auto loss = out_signals[t]->get_loss();
+            *loss = 0;
+            for (size_t i = 0; i < m; i++) {
+                if (_is_active(t, i)) {
+                    out_ptr[i] = predictions_ptr[r];
+                    *loss += losses_ptr[r];
+                    r++;
+                } else {
+                    out_ptr[i] = T(0);
+                }
+            }
+            *loss /= m;
+            out_data->setclear();
+        }
+    }
+
+    template<typename T>
+    void SeqCrossEntropy<T>::backward() {
+        CHECK(!this->is_inference(), "backward should not be called in inference mode");
+        CHECK(!logits_grad->opaque(), "forward should be called before backward");
+        auto grad_ptr = logits_grad->get_data();
+
+        if (!this->is_params_fixed()) {
+            T beta = this->dw->opaque() ? T(0) : T(1);
+            _GEMM(CblasRowMajor, CblasTrans, CblasNoTrans, in_size, out_size, num_rows,
+                  T(1), states->get_data(), in_size, grad_ptr, out_size, beta, this->dw->get_data(), out_size);
+            this->dw->setclear();
+            if (this->db->opaque()) {
+                this->db->fill(0);
+            }
+            for (size_t r = 0; r < num_rows; r++) {
+                vec_add(this->db->get_data(), grad_ptr + r*out_size, out_size);
+            }
+        }
+        if (!states_grad) {
+            return;
+        }
+
+        auto states_grad_ptr = states_grad->get_data();
+        _GEMM(CblasRowMajor, CblasNoTrans, CblasTrans, num_rows, in_size, out_size,
+              T(1), grad_ptr, out_size, this->w->get_data(), out_size, T(0), states_grad_ptr, in_size);
+        size_t offset = 0;
+        for (size_t t = 0; t < in_signals.size(); t++) {
+            if (in_signals[t]->requires_grad()) {
+                auto in_grad = in_signals[t]->get_grad();
+                auto in_grad_ptr = in_grad->get_data();
+                bool overwrite = in_grad->opaque();
+                for (size_t i = 0, r = offset; i < batch_size; i++) {
+                    auto dst = in_grad_ptr + i*in_size;
+                    if (_is_active(t, i)) {
+                        auto src = states_grad_ptr + (r++)*in_size;
+                        if (overwrite) {
+                            copy(src, src + in_size, dst);
+                        } else {
+                            vec_add(dst, src, in_size);
+                        }
+                    } else if (overwrite) {
+                        fill(dst, dst + in_size, T(0));
+                    }
+                }
+                in_grad->setclear();
+            }
+            offset += step_rows[t];
+        }
+    }
+
+    template class SeqCrossEntropy<float>;
+    template class SeqCrossEntropy<double>;
+
+}
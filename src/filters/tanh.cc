@@ -37,7 +37,7 @@ namespace gs {
         auto out_data = out_signal->get_data();
         CHECK(out_data->opaque(), "This Tanh could not work in parallel with the other filters, please use GeneralTanh instead");
 
-        MAP(out_data, [](T x){ return tanh(x); }, in_data);
+        MAP(out_data, TanhOp<T>(), in_data);
     }
 
     template<typename T>
@@ -47,7 +47,7 @@ namespace gs {
         auto out_grad = out_signal->get_grad();
         CHECK(!out_grad->opaque() && !out_data->opaque(), "these should not be opaque");
 
-        MAP(in_grad, [](T dy, T y){return dy*(1-y*y);}, out_grad, out_data);
+        MAP(in_grad, TanhGradOp<T>(), out_grad, out_data);
     }
 
     template class Tanh<float>;
@@ -1,6 +1,7 @@
 #include "galois/gfilters/net.h"
 #include "galois/utils.h"
 #include <vector>
+#include <map>
 
 namespace gs {
 
@@ -8,29 +9,10 @@ namespace gs {
     void Net<T>::add_link(const vector<string> &ins, const vector<string> &outs, SP_Filter<T> filter) {
         CHECK(!this->fixed, "network should not be fixed");
 
-        // add to links
-        auto idx = this->links.size();
+        // add to links, the graph is built over signal ids in set_p_order
         this->links.push_back(tuple<const vector<string>,const vector<string>,SP_Filter<T>>
                         (vector<string>{ins}, vector<string>{outs}, filter));
 
-        // add to graph
-        for (auto s : ins) {
-            if (fp_graph.count(s) == 0) {
-                fp_graph[s] = vector<tuple<string,int>>();
-            }
-        }
-        for (auto s : outs) {
-            if (bp_graph.count(s) == 0) {
-                bp_graph[s] = vector<tuple<string,int>>();
-            }
-        }
-        for (auto s1 : ins) {
-            for (auto s2 : outs) {
-                fp_graph[s1].push_back(tuple<string,int>(s2, idx));
-                bp_graph[s2].push_back(tuple<string,int>(s1, idx));
-            }
-        }
-
         // initial signals
         for (auto s : ins) {
             if (!Contains(this->input_ids, s) && (this->inner_signals.count(s) == 0)) {
@@ -84,28 +66,46 @@ namespace gs {
         }
     }
 
+    // depth first from out_id, a link is put into fp_order after all the links producing its inputs
+    // every signal is visited once, so the whole sort is linear in the size of the graph
     template<typename T>
-    void Net<T>::_set_fp_order(string out_id, vector<int> &fp_order) {
-        if (Contains(this->input_ids, out_id)) {
-            if (bp_graph.count(out_id) == 0) {
+    void Net<T>::_set_fp_order(const int out_id, vector<bool> &visited, vector<bool> &placed) {
+        // (signal, index of the producing link, index of the input of that link)
+        vector<tuple<int, size_t, size_t>> stack{};
+        auto visit = [&](int id) {
+            if (visited[id]) {
                 return;
             }
-        } else {
-            CHECK(bp_graph.count(out_id) == 1, "out_id should be in the keys of bp_graph");
-        }
+            visited[id] = true;
+            bool is_input = id < static_cast<int>(this->input_ids.size());
+            CHECK(is_input || !bp_graph[id].empty(), "signal should be an input or be produced by some link");
+            stack.push_back(make_tuple(id, 0, 0));
+        };
 
-        for (auto t : bp_graph[out_id]) {
-            string in_id = get<0>(t);
-            int link_idx = get<1>(t);
-            if (!Contains(fp_order, link_idx)) {
-                _set_fp_order(in_id, fp_order);
+        visit(out_id);
+        while (!stack.empty()) {
+            int id = get<0>(stack.back());
+            size_t &k = get<1>(stack.back());
+            size_t &j = get<2>(stack.back());
+            auto &producers = bp_graph[id];
+            if (k < producers.size()) {
+                auto &ins = this->link_in_ids[producers[k]];
+                if (j < ins.size()) {
+                    int in_id = ins[j++];
+                    visit(in_id);
+                } else {
+                    k++;
+                    j = 0;
+                }
+                continue;
             }
-        }
-        for (auto t : bp_graph[out_id]) {
-            int link_idx = get<1>(t);
-            if (!Contains(fp_order, link_idx)) {
-                fp_order.push_back(link_idx);
+            for (auto link_idx : producers) {
+                if (!placed[link_idx]) {
+                    placed[link_idx] = true;
+                    this->fp_order.push_back(link_idx);
+                }
             }
+            stack.pop_back();
         }
     }
 
@@ -117,15 +117,250 @@ namespace gs {
         CHECK(this->fp_filters.empty(), "fp filters should not be set");
         this->fixed = true;
 
-        vector<int> fp_order{};
-        for (auto out_id : this->output_ids) {
-            _set_fp_order(out_id, fp_order);
+        this->_index_signals();
+        auto num_signals = this->signal_ids.size();
+        fp_graph.assign(num_signals, vector<int>());
+        bp_graph.assign(num_signals, vector<int>());
+        for (size_t i = 0; i < this->links.size(); i++) {
+            for (auto id : this->link_in_ids[i]) {
+                fp_graph[id].push_back(i);
+            }
+            for (auto id : this->link_out_ids[i]) {
+                bp_graph[id].push_back(i);
+            }
+        }
+
+        vector<bool> visited(num_signals, false);
+        vector<bool> placed(this->links.size(), false);
+        for (size_t i = 0; i < this->output_ids.size(); i++) {
+            _set_fp_order(this->input_ids.size() + i, visited, placed);
         }
-        for (auto link_idx : fp_order) {
+        for (auto link_idx : this->fp_order) {
             auto t = this->links[link_idx];
             auto filter = get<2>(t);
             this->fp_filters.push_back(filter);
         }
+        this->_build_plan();
+    }
+
+    template<typename T>
+    void Net<T>::set_num_threads(size_t num_threads) {
+        CHECK(num_threads > 0, "number of threads should be positive");
+        CHECK(num_threads == 1 || !this->is_memory_planned(), "a memory plan assumes sequential propagation");
+        CHECK(num_threads == 1 || !this->is_checkpointed(), "checkpoints assume sequential propagation");
+        if (num_threads == 1) {
+            pool = nullptr;
+        } else {
+            pool = make_shared<ThreadPool>(num_threads);
+        }
+    }
+
+    template<typename T>
+    void Net<T>::_build_parallel_plan() {
+        CHECK(this->fixed, "network should be fixed");
+        auto num_links = this->links.size();
+        auto num_filters = this->fp_plan.size();
+        vector<int> pos_of(num_links, -1);
+        for (size_t p = 0; p < num_filters; p++) {
+            pos_of[this->fp_order[p]] = p;
+        }
+
+        // dependencies, a filter waits for the producers of its inputs in forward and the other way round in backward
+        fp_next.assign(num_filters, vector<int>());
+        bp_next.assign(num_filters, vector<int>());
+        fp_deps.assign(num_filters, 0);
+        bp_deps.assign(num_filters, 0);
+        for (size_t p = 0; p < num_filters; p++) {
+            vector<int> next{};
+            for (auto id : this->link_out_ids[this->fp_order[p]]) {
+                for (auto link_idx : fp_graph[id]) {
+                    if (pos_of[link_idx] >= 0) {
+                        next.push_back(pos_of[link_idx]);
+                    }
+                }
+            }
+            sort(next.begin(), next.end());
+            next.erase(unique(next.begin(), next.end()), next.end());
+            for (auto q : next) {
+                fp_next[p].push_back(q);
+                bp_next[q].push_back(p);
+                fp_deps[q]++;
+                bp_deps[p]++;
+            }
+        }
+
+        // locks, one per signal then one per gradient of parameters
+        // forward writes the data of out signals, backward writes the grad of in signals and of parameters
+        int num_locks = this->signal_ids.size();
+        map<NArray<T>*, int> grad_locks{};
+        fp_locks.assign(num_filters, vector<int>());
+        bp_locks.assign(num_filters, vector<int>());
+        for (size_t p = 0; p < num_filters; p++) {
+            auto link_idx = this->fp_order[p];
+            fp_locks[p] = this->link_out_ids[link_idx];
+            bp_locks[p] = this->link_in_ids[link_idx];
+
+            auto filter = get<2>(this->links[link_idx]);
+            set<SP_PFilter<T>> pfilters{};
+            if (auto pf = dynamic_pointer_cast<PFilter<T>>(filter)) {
+                pfilters.insert(pf);
+            }
+            if (auto gf = dynamic_pointer_cast<GFilter<T>>(filter)) {
+                pfilters = gf->get_pfilters();
+            }
+            for (auto pf : pfilters) {
+                for (auto grad : pf->get_grads()) {
+                    if (grad_locks.count(grad.get()) == 0) {
+                        grad_locks[grad.get()] = num_locks++;
+                    }
+                    bp_locks[p].push_back(grad_locks[grad.get()]);
+                }
+            }
+
+            // always taken in increasing order, so filters could not deadlock
+            for (auto l : {&fp_locks[p], &bp_locks[p]}) {
+                sort(l->begin(), l->end());
+                l->erase(unique(l->begin(), l->end()), l->end());
+            }
+        }
+        locks.reset(new mutex[num_locks]);
+        counters.reset(new atomic<int>[num_filters]);
+    }
+
+    template<typename T>
+    void Net<T>::_parallel_propagate(const bool is_forward) {
+        CHECK(!this->is_memory_planned(), "a memory plan assumes sequential propagation");
+        CHECK(!this->is_checkpointed(), "checkpoints assume sequential propagation");
+        if (counters == nullptr) {
+            _build_parallel_plan();
+        }
+        auto &next = is_forward ? fp_next : bp_next;
+        auto &deps = is_forward ? fp_deps : bp_deps;
+        auto &filter_locks = is_forward ? fp_locks : bp_locks;
+        auto num_filters = this->fp_plan.size();
+        for (size_t p = 0; p < num_filters; p++) {
+            counters[p] = deps[p];
+        }
+
+        function<void(int)> run = [&](int p) {
+            for (auto l : filter_locks[p]) {
+                locks[l].lock();
+            }
+            if (is_forward) {
+                if (frozen.empty() || !frozen[p]) {
+                    this->fp_plan[p]->forward();
+                }
+            } else if (this->bp_needed[p]) {
+                this->fp_plan[p]->backward();
+            }
+            for (auto l : filter_locks[p]) {
+                locks[l].unlock();
+            }
+            for (auto q : next[p]) {
+                if (--counters[q] == 0) {
+                    pool->submit([&run, q]{ run(q); });
+                }
+            }
+        };
+        for (size_t p = 0; p < num_filters; p++) {
+            if (deps[p] == 0) {
+                pool->submit([&run, p]{ run(p); });
+            }
+        }
+        pool->wait_all();
+    }
+
+    template<typename T>
+    void Net<T>::forward() {
+        if (pool == nullptr && frozen.empty()) {
+            BaseNet<T>::forward();
+            return;
+        }
+        CHECK(this->fixed, "network should be fixed");
+        CHECK(!this->is_checkpointed(), "checkpoints do not know about skipped links");
+        if (pool == nullptr) {
+            for (size_t p = 0; p < this->fp_plan.size(); p++) {
+                if (!frozen[p]) {
+                    this->fp_plan[p]->forward();
+                }
+            }
+            return;
+        }
+        _parallel_propagate(true);
+    }
+
+    template<typename T>
+    vector<SP_Signal<T>> Net<T>::skip_frozen() {
+        CHECK(this->fixed, "network should be fixed");
+        CHECK(frozen.empty(), "frozen links should not be skipped before");
+        CHECK(!this->is_memory_planned(), "a memory plan does not know about skipped links");
+        CHECK(!this->is_checkpointed(), "checkpoints do not know about skipped links");
+        int num_inputs = this->input_ids.size();
+        int num_outputs = this->output_ids.size();
+        auto num_filters = this->fp_plan.size();
+        vector<int> pos_of(this->links.size(), -1);
+        for (size_t p = 0; p < num_filters; p++) {
+            pos_of[this->fp_order[p]] = p;
+        }
+
+        // fp_order is topological, so the producers of in signals are decided first
+        frozen.assign(num_filters, false);
+        for (size_t p = 0; p < num_filters; p++) {
+            auto link_idx = this->fp_order[p];
+            bool f = !get<2>(this->links[link_idx])->is_trainable();
+            for (auto id : this->link_in_ids[link_idx]) {
+                if (id >= num_inputs) {
+                    for (auto producer : bp_graph[id]) {
+                        f = f && pos_of[producer] >= 0 && frozen[pos_of[producer]];
+                    }
+                }
+            }
+            for (auto id : this->link_out_ids[link_idx]) {
+                f = f && id >= num_inputs + num_outputs;
+            }
+            frozen[p] = f;
+        }
+
+        // signals written by some frozen link and read by some other one
+        vector<SP_Signal<T>> signals{};
+        for (size_t id = num_inputs + num_outputs; id < this->signal_ids.size(); id++) {
+            bool written = false;
+            bool read = false;
+            for (auto producer : bp_graph[id]) {
+                written = written || (pos_of[producer] >= 0 && frozen[pos_of[producer]]);
+            }
+            for (auto consumer : fp_graph[id]) {
+                read = read || (pos_of[consumer] >= 0 && !frozen[pos_of[consumer]]);
+            }
+            if (written && read) {
+                signals.push_back(this->inner_signals[this->signal_ids[id]]);
+            }
+        }
+        if (signals.empty()) {
+            frozen.clear();
+        }
+        return signals;
+    }
+
+    template<typename T>
+    void Net<T>::forward_frozen() {
+        CHECK(!frozen.empty(), "frozen links should have been skipped");
+        for (size_t p = 0; p < this->fp_plan.size(); p++) {
+            if (frozen[p]) {
+                this->fp_plan[p]->forward();
+            }
+        }
+    }
+
+    template<typename T>
+    void Net<T>::backward() {
+        CHECK(!this->is_inference(), "backward should not be called in inference mode");
+        if (pool == nullptr) {
+            BaseNet<T>::backward();
+            return;
+        }
+        CHECK(this->fixed, "network should be fixed");
+        _parallel_propagate(false);
     }
 
     template<typename T>
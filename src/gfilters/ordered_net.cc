@@ -68,6 +68,11 @@ namespace gs
     void OrderedNet<T>::fix_net() {
         CHECK(!this->fixed, "network should not be fixed");
         this->fixed = true;
+        this->_index_signals();
+        for (size_t i = 0; i < this->links.size(); i++) {
+            this->fp_order.push_back(i);
+        }
+        this->_build_plan();
 
 //        for (auto t : this->links) {
 //            auto in_ids = get<0>(t);
@@ -115,15 +120,17 @@ namespace gs
     template<typename T>
     void OrderedNet<T>::forward(int idx) {
         CHECK(this->fixed, "network should be fixed");
-        auto filter = this->fp_filters[idx];
-        filter->forward();
+        this->fp_plan[idx]->forward();
     }
 
     template<typename T>
     void OrderedNet<T>::backward(int idx) {
         CHECK(this->fixed, "network should be fixed");
-        auto filter = this->fp_filters[idx];
-        filter->backward();
+        CHECK(!this->is_inference(), "backward should not be called in inference mode");
+        CHECK(!this->is_checkpointed(), "a checkpointed network runs backward by segments");
+        if (this->bp_needed[idx]) {
+            this->fp_plan[idx]->backward();
+        }
     }
 
     template class OrderedNet<float>;
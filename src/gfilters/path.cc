@@ -46,12 +46,43 @@ namespace gs
         return pfilters;
     }
 
+    template<typename T>
+    vector<SP_Filter<T>> Path<T>::get_filters() {
+        return links;
+    }
+
+    template<typename T>
+    void Path<T>::set_inference() {
+        GFilter<T>::set_inference();
+        for (auto const& signal : inner_signals) {
+            signal->disable_grad();
+        }
+        for (auto const& filter : links) {
+            filter->set_inference();
+        }
+    }
+
     template<typename T>
     void Path<T>::install_signals(const vector<SP_Signal<T>>& in_signals, const vector<SP_Signal<T>>& out_signals) {
         CHECK(in_signals.size() == 1 && out_signals.size() == 1, "Only support 1 in signal and 1 out signal right now");
         CHECK(links.size() == inner_signals.size()+1, "The number of filters and inner signals does not match");
         auto in_signal = in_signals[0];
         auto out_signal = out_signals[0];
+        // along the chain, backward is needed from the first trainable filter on, or everywhere
+        // if the in signal requires grad, see BaseNet::_set_requires_grad
+        if (!this->is_inference()) {
+            bool needed = in_signal->requires_grad();
+            bp_needed.clear();
+            for (size_t i = 0; i < links.size(); i++) {
+                needed = needed || links[i]->is_trainable();
+                links[i]->set_backward_needed(needed);
+                bp_needed.push_back(needed);
+                if (i < inner_signals.size() && !needed && inner_signals[i]->get_data() == nullptr
+                        && inner_signals[i]->requires_grad()) {
+                    inner_signals[i]->disable_grad();
+                }
+            }
+        }
         for (size_t i = 0; i < links.size(); i++) {
             SP_Signal<T> in = nullptr;
             SP_Signal<T> out = nullptr;
@@ -97,9 +128,11 @@ namespace gs
 
     template<typename T>
     void Path<T>::backward() {
+        CHECK(!this->is_inference(), "backward should not be called in inference mode");
         for (int i = links.size()-1; i >= 0; i--) {
-            auto filter = links[i];
-            filter->backward();
+            if (bp_needed[i]) {
+                links[i]->backward();
+            }
         }
     }
 
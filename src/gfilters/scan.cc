@@ -0,0 +1,302 @@
+#include "galois/narray.h"
+#include "galois/narray_kernels.h"
+#include "galois/gfilters/scan.h"
+#include "galois/utils.h"
+#include <algorithm>
+
+namespace gs
+{
+
+    template<typename T>
+    Scan<T>::Scan(shared_ptr<BaseNet<T>> cell, size_t in_size, size_t state_size, size_t max_steps, bool use_embedding)
+            : cell(cell), in_size(in_size), state_size(state_size), max_steps(max_steps), num_steps(max_steps),
+              use_embedding(use_embedding) {
+        CHECK(cell, "the cell should be a net");
+        CHECK(in_size > 0 && state_size > 0 && max_steps > 0, "sizes should be positive");
+    }
+
+    template<typename T>
+    void Scan<T>::set_num_steps(size_t num_steps) {
+        CHECK(num_steps > 0 && num_steps <= max_steps, "number of steps should be in [1, %zu]", max_steps);
+        this->num_steps = num_steps;
+    }
+
+    template<typename T>
+    SP_Filter<T> Scan<T>::share() {
+        auto res = make_shared<Scan<T>>(dynamic_pointer_cast<BaseNet<T>>(cell->share()), in_size, state_size,
+                                        max_steps, use_embedding);
+        res->num_steps = num_steps;
+        return res;
+    }
+
+    template<typename T>
+    SP_Filter<T> Scan<T>::clone() {
+        auto res = make_shared<Scan<T>>(dynamic_pointer_cast<BaseNet<T>>(cell->clone()), in_size, state_size,
+                                        max_steps, use_embedding);
+        res->num_steps = num_steps;
+        return res;
+    }
+
+    template<typename T>
+    set<SP_PFilter<T>> Scan<T>::get_pfilters() {
+        return cell->get_pfilters();
+    }
+
+    template<typename T>
+    vector<SP_Filter<T>> Scan<T>::get_filters() {
+        return vector<SP_Filter<T>>{ cell };
+    }
+
+    template<typename T>
+    void Scan<T>::set_inference() {
+        GFilter<T>::set_inference();
+        cell->set_inference();
+    }
+
+    template<typename T>
+    void Scan<T>::install_signals(const vector<SP_Signal<T>> &in_signals, const vector<SP_Signal<T>> &out_signals) {
+        CHECK(in_signals.size() == 1 || in_signals.size() == 2, "need the sequence, and optionally the initial state");
+        CHECK(out_signals.size() == 1 || out_signals.size() == 2, "need the states of all steps, and optionally the last state");
+        CHECK(step_out == nullptr, "signals should not be installed before");
+        in_signal = in_signals[0];
+        initial_signal = in_signals.size() > 1 ? in_signals[1] : nullptr;
+        out_signal = out_signals[0];
+        last_signal = out_signals.size() > 1 ? out_signals[1] : nullptr;
+
+        // the input of a step only needs a grad when the sequence does
+        bool needed = this->is_backward_needed();
+        step_in = make_shared<Signal<T>>(needed && in_signal->requires_grad() ? InnerSignal : InputSignal);
+        step_prev = make_shared<Signal<T>>(InnerSignal);
+        step_out = make_shared<Signal<T>>(InnerSignal);
+        if (!needed) {
+            step_prev->disable_grad();
+            step_out->disable_grad();
+        }
+        cell->set_backward_needed(needed);
+        cell->install_signals({step_in, step_prev}, {step_out});
+        cell_signals = cell->get_inner_signals();
+    }
+
+    template<typename T>
+    void Scan<T>::set_dims(size_t batch_size) {
+        this->batch_size = batch_size;
+        auto seq_dims = use_embedding ? Shape({batch_size, max_steps}) : Shape({batch_size, max_steps, in_size});
+        auto states_dims = Shape({batch_size, max_steps, state_size});
+        auto state_dims = Shape({batch_size, state_size});
+        if (in_signal->empty()) {
+            in_signal->set_data_dims(seq_dims);
+        } else {
+            // like Linear, the sequence of a sample could be flattened
+            auto in_dims = in_signal->get_data_dims();
+            auto in_rest_dim = in_signal->get_data()->get_size() / in_dims[0];
+            CHECK(in_dims[0] == batch_size && in_rest_dim == seq_dims[1] * (use_embedding ? 1 : in_size),
+                  "the dimension of in signal is wrong");
+        }
+        if (out_signal->empty()) {
+            out_signal->set_data_dims(states_dims);
+        } else {
+            CHECK(out_signal->get_data_dims() == states_dims, "the dimension of out signal is wrong");
+        }
+        for (auto signal : {initial_signal, last_signal}) {
+            if (!signal) {
+                continue;
+            }
+            if (signal->empty()) {
+                signal->set_data_dims(state_dims);
+            } else {
+                CHECK(signal->get_data_dims() == state_dims, "the dimension of state is wrong");
+            }
+        }
+        step_in->set_data_dims(use_embedding ? Shape({batch_size}) : Shape({batch_size, in_size}));
+        step_prev->set_data_dims(state_dims);
+        step_out->set_data_dims(state_dims);
+        cell->set_dims(batch_size);
+        CHECK(!cell->is_memory_planned(), "memory of the cell should not be planned");
+
+        // the state is first in a frame, the input and inner data of the step follow when backward reads them,
+        // each one aligned like in a memory plan
+        CHECK(stack == nullptr, "the stack should not be set before");
+        const size_t align = max(size_t(1), 64 / sizeof(T));
+        auto aligned = [&](size_t n) { return (n + align - 1) / align * align; };
+        frame_size = aligned(batch_size * state_size);
+        if (this->is_backward_needed()) {
+            framed.push_back(step_in->get_data().get());
+            for (auto signal : cell_signals) {
+                if (signal->get_data()) {
+                    framed.push_back(signal->get_data().get());
+                }
+            }
+        }
+        for (auto array : framed) {
+            framed_offsets.push_back(frame_size);
+            frame_size += aligned(array->get_size());
+        }
+        stack = make_shared<NArray<T>>((max_steps + 1) * frame_size);
+    }
+
+    template<typename T>
+    void Scan<T>::reopaque() {
+        step_in->reopaque();
+        step_prev->reopaque();
+        step_out->reopaque();
+        cell->reopaque();
+    }
+
+    // step t reads the state of frame t and writes the one of frame t+1
+    template<typename T>
+    void Scan<T>::_point_to(size_t t) {
+        auto base = stack->get_data();
+        step_prev->get_data()->set_external_data(base + t*frame_size, stack);
+        step_out->get_data()->set_external_data(base + (t+1)*frame_size, stack);
+        for (size_t k = 0; k < framed.size(); k++) {
+            framed[k]->set_external_data(base + t*frame_size + framed_offsets[k], stack);
+        }
+    }
+
+    template<typename T>
+    void Scan<T>::forward() {
+        auto in_data = in_signal->get_data();
+        CHECK(!in_data->opaque(), "in_data should not be opaque");
+        auto out_data = out_signal->get_data();
+        size_t B = batch_size;
+        size_t S = state_size;
+        size_t X = use_embedding ? 1 : in_size;
+        auto x_ptr = in_data->get_data();
+        auto h_ptr = out_data->get_data();
+        bool overwrite = out_data->opaque();
+        if (overwrite && num_steps < max_steps) {
+            out_data->fill(0);
+        }
+
+        for (size_t t = 0; t < num_steps; t++) {
+            _point_to(t);
+            auto prev = step_prev->get_data();
+            if (t == 0) {
+                if (initial_signal) {
+                    auto initial_data = initial_signal->get_data();
+                    CHECK(!initial_data->opaque(), "initial state should not be opaque");
+                    copy(initial_data->get_data(), initial_data->get_data() + B*S, prev->get_data());
+                } else {
+                    fill(prev->get_data(), prev->get_data() + B*S, T(0));
+                }
+            }
+            prev->setclear();
+
+            auto xt_ptr = step_in->get_data()->get_data();
+            for (size_t i = 0; i < B; i++) {
+                auto src = x_ptr + (i*max_steps + t)*X;
+                copy(src, src + X, xt_ptr + i*X);
+            }
+            step_in->get_data()->setclear();
+            step_out->get_data()->reopaque();
+            for (auto signal : cell_signals) {
+                if (signal->get_data()) {
+                    signal->get_data()->reopaque();
+                }
+            }
+
+            cell->forward();
+
+            CHECK(!step_out->get_data()->opaque(), "the cell should write the new state");
+            auto ht_ptr = step_out->get_data()->get_data();
+            for (size_t i = 0; i < B; i++) {
+                auto dst = h_ptr + (i*max_steps + t)*S;
+                if (overwrite) {
+                    copy(ht_ptr + i*S, ht_ptr + (i+1)*S, dst);
+                } else {
+                    vec_add(dst, ht_ptr + i*S, S);
+                }
+            }
+        }
+        out_data->setclear();
+
+        if (last_signal) {
+            auto last_data = last_signal->get_data();
+            auto ht_ptr = step_out->get_data()->get_data();
+            if (last_data->opaque()) {
+                copy(ht_ptr, ht_ptr + B*S, last_data->get_data());
+                last_data->setclear();
+            } else {
+                vec_add(last_data->get_data(), ht_ptr, B*S);
+            }
+        }
+    }
+
+    template<typename T>
+    void Scan<T>::backward() {
+        CHECK(!this->is_inference(), "backward should not be called in inference mode");
+        size_t B = batch_size;
+        size_t S = state_size;
+        size_t X = use_embedding ? 1 : in_size;
+
+        // the grad of an out signal nobody reads stays opaque, and it is zero
+        auto out_grad = out_signal->get_grad();
+        const T *dh_ptr = out_grad && !out_grad->opaque() ? out_grad->get_data() : nullptr;
+        auto last_grad = last_signal ? last_signal->get_grad() : nullptr;
+        const T *dlast_ptr = last_grad && !last_grad->opaque() ? last_grad->get_data() : nullptr;
+        auto in_grad = step_in->requires_grad() ? in_signal->get_grad() : nullptr;
+        if (in_grad && in_grad->opaque()) {
+            in_grad->fill(0);
+            in_grad->setclear();
+        }
+        auto prev_grad = step_prev->get_grad();
+        auto next_grad = step_out->get_grad();
+
+        for (int t = num_steps-1; t >= 0; t--) {
+            _point_to(t);
+
+            // grad of the new state, from H and from the step after it
+            auto dst = next_grad->get_data();
+            if (dh_ptr) {
+                for (size_t i = 0; i < B; i++) {
+                    auto src = dh_ptr + (i*max_steps + t)*S;
+                    copy(src, src + S, dst + i*S);
+                }
+            } else {
+                fill(dst, dst + B*S, T(0));
+            }
+            if (t == int(num_steps)-1) {
+                if (dlast_ptr) {
+                    vec_add(dst, dlast_ptr, B*S);
+                }
+            } else if (!prev_grad->opaque()) {
+                vec_add(dst, prev_grad->get_data(), B*S);
+            }
+            next_grad->setclear();
+
+            prev_grad->reopaque();
+            if (step_in->get_grad()) {
+                step_in->get_grad()->reopaque();
+            }
+            for (auto signal : cell_signals) {
+                if (signal->get_grad()) {
+                    signal->get_grad()->reopaque();
+                }
+            }
+
+            cell->backward();
+
+            if (in_grad && !step_in->get_grad()->opaque()) {
+                auto dxt_ptr = step_in->get_grad()->get_data();
+                auto dx_ptr = in_grad->get_data();
+                for (size_t i = 0; i < B; i++) {
+                    vec_add(dx_ptr + (i*max_steps + t)*X, dxt_ptr + i*X, X);
+                }
+            }
+        }
+
+        if (initial_signal && initial_signal->requires_grad() && !prev_grad->opaque()) {
+            auto initial_grad = initial_signal->get_grad();
+            if (initial_grad->opaque()) {
+                copy(prev_grad->get_data(), prev_grad->get_data() + B*S, initial_grad->get_data());
+                initial_grad->setclear();
+            } else {
+                vec_add(initial_grad->get_data(), prev_grad->get_data(), B*S);
+            }
+        }
+    }
+
+    template class Scan<float>;
+    template class Scan<double>;
+
+}
@@ -0,0 +1,35 @@
+#ifndef _GALOIS_KERNEL_TABLE_H_
+#define _GALOIS_KERNEL_TABLE_H_
+
+#include <cstddef>
+
+namespace gs
+{
+
+    // one entry per kernel in galois/narray_kernels.h, filled by the isa specific translation units
+    template<typename T>
+    struct KernelTable
+    {
+        void (*tanh)(T*, const T*, size_t, bool);
+        void (*exp)(T*, const T*, size_t, bool);
+        void (*log)(T*, const T*, size_t, bool);
+        void (*scale)(T*, T, const T*, size_t, bool);
+        void (*tanh_grad)(T*, const T*, const T*, size_t, bool);
+        void (*tanh_grad_input)(T*, const T*, const T*, size_t, bool);
+        void (*add)(T*, const T*, size_t);
+        void (*momentum)(T*, T*, const T*, size_t, T, T, bool);
+        void (*rmsprop)(T*, T*, const T*, size_t, T, T, T);
+        void (*adam)(T*, T*, T*, const T*, size_t, T, T, T, T);
+        T (*max)(const T*, size_t);
+        T (*exp_sum)(T*, const T*, T, size_t);
+    };
+
+#if defined(__x86_64__) || defined(__i386__)
+    void load_sse4_kernels(KernelTable<float>&, KernelTable<double>&);
+    void load_avx2_kernels(KernelTable<float>&, KernelTable<double>&);
+    void load_avx512_kernels(KernelTable<float>&, KernelTable<double>&);
+#endif
+
+}
+
+#endif
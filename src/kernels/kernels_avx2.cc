@@ -0,0 +1,114 @@
+// vectorized kernels for AVX2 and FMA, 256-bit registers, compiled with -mavx2 -mfma
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+#include "kernels_impl.h"
+
+#if !(defined(__AVX2__) && defined(__FMA__))
+#error "this file should be compiled with -mavx2 -mfma"
+#endif
+
+namespace gs
+{
+namespace
+{
+    struct AVX2F
+    {
+        typedef float T;
+        typedef __m256 R;
+        typedef __m256 M;
+        typedef __m256i I;
+        static const size_t W = 8;
+
+        static R load(const T *a)          { return _mm256_loadu_ps(a); }
+        static void store(T *a, R v)       { _mm256_storeu_ps(a, v); }
+        static R set1(T a)                 { return _mm256_set1_ps(a); }
+        static R zero()                    { return _mm256_setzero_ps(); }
+        static T inf()                     { return __builtin_huge_valf(); }
+        static T nan()                     { return __builtin_nanf(""); }
+
+        static R add(R a, R b)             { return _mm256_add_ps(a, b); }
+        static R sub(R a, R b)             { return _mm256_sub_ps(a, b); }
+        static R mul(R a, R b)             { return _mm256_mul_ps(a, b); }
+        static R div(R a, R b)             { return _mm256_div_ps(a, b); }
+        static R sqrt(R a)                 { return _mm256_sqrt_ps(a); }
+        static R min(R a, R b)             { return _mm256_min_ps(a, b); }
+        static R max(R a, R b)             { return _mm256_max_ps(a, b); }
+        static R fmadd(R a, R b, R c)      { return _mm256_fmadd_ps(a, b, c); }
+        static R fnmadd(R a, R b, R c)     { return _mm256_fnmadd_ps(a, b, c); }
+        static R round(R a)                { return _mm256_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+        static R floor(R a)                { return _mm256_floor_ps(a); }
+
+        static M gt(R a, R b)              { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+        static M lt(R a, R b)              { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+        static M eq(R a, R b)              { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+        static M unord(R a)                { return _mm256_cmp_ps(a, a, _CMP_UNORD_Q); }
+        // m ? b : a
+        static R blend(M m, R a, R b)      { return _mm256_blendv_ps(a, b, m); }
+
+        static I as_int(R a)               { return _mm256_castps_si256(a); }
+        static R as_real(I a)              { return _mm256_castsi256_ps(a); }
+        static I and_(I a, I b)            { return _mm256_and_si256(a, b); }
+        static I or_(I a, I b)             { return _mm256_or_si256(a, b); }
+        static I shl_mant(I a)             { return _mm256_slli_epi32(a, 23); }
+        static I shr_mant(I a)             { return _mm256_srli_epi32(a, 23); }
+        static I mant_mask()               { return _mm256_set1_epi32(0x007fffff); }
+        static R abs(R a)                  { return as_real(and_(as_int(a), _mm256_set1_epi32(0x7fffffff))); }
+        static R copysign(R a, R b)        { return as_real(or_(as_int(abs(a)), and_(as_int(b), as_int(set1(-0.0f))))); }
+    };
+
+    struct AVX2D
+    {
+        typedef double T;
+        typedef __m256d R;
+        typedef __m256d M;
+        typedef __m256i I;
+        static const size_t W = 4;
+
+        static R load(const T *a)          { return _mm256_loadu_pd(a); }
+        static void store(T *a, R v)       { _mm256_storeu_pd(a, v); }
+        static R set1(T a)                 { return _mm256_set1_pd(a); }
+        static R zero()                    { return _mm256_setzero_pd(); }
+        static T inf()                     { return __builtin_huge_val(); }
+        static T nan()                     { return __builtin_nan(""); }
+
+        static R add(R a, R b)             { return _mm256_add_pd(a, b); }
+        static R sub(R a, R b)             { return _mm256_sub_pd(a, b); }
+        static R mul(R a, R b)             { return _mm256_mul_pd(a, b); }
+        static R div(R a, R b)             { return _mm256_div_pd(a, b); }
+        static R sqrt(R a)                 { return _mm256_sqrt_pd(a); }
+        static R min(R a, R b)             { return _mm256_min_pd(a, b); }
+        static R max(R a, R b)             { return _mm256_max_pd(a, b); }
+        static R fmadd(R a, R b, R c)      { return _mm256_fmadd_pd(a, b, c); }
+        static R fnmadd(R a, R b, R c)     { return _mm256_fnmadd_pd(a, b, c); }
+        static R round(R a)                { return _mm256_round_pd(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+        static R floor(R a)                { return _mm256_floor_pd(a); }
+
+        static M gt(R a, R b)              { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+        static M lt(R a, R b)              { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+        static M eq(R a, R b)              { return _mm256_cmp_pd(a, b, _CMP_EQ_OQ); }
+        static M unord(R a)                { return _mm256_cmp_pd(a, a, _CMP_UNORD_Q); }
+        // m ? b : a
+        static R blend(M m, R a, R b)      { return _mm256_blendv_pd(a, b, m); }
+
+        static I as_int(R a)               { return _mm256_castpd_si256(a); }
+        static R as_real(I a)              { return _mm256_castsi256_pd(a); }
+        static I and_(I a, I b)            { return _mm256_and_si256(a, b); }
+        static I or_(I a, I b)             { return _mm256_or_si256(a, b); }
+        static I shl_mant(I a)             { return _mm256_slli_epi64(a, 52); }
+        static I shr_mant(I a)             { return _mm256_srli_epi64(a, 52); }
+        static I mant_mask()               { return _mm256_set1_epi64x(0x000fffffffffffffLL); }
+        static R abs(R a)                  { return as_real(and_(as_int(a), _mm256_set1_epi64x(0x7fffffffffffffffLL))); }
+        static R copysign(R a, R b)        { return as_real(or_(as_int(abs(a)), and_(as_int(b), as_int(set1(-0.0))))); }
+    };
+
+}
+
+    void load_avx2_kernels(KernelTable<float> &float_table, KernelTable<double> &double_table) {
+        fill_table<AVX2F>(float_table);
+        fill_table<AVX2D>(double_table);
+    }
+
+}
+
+#endif
@@ -0,0 +1,119 @@
+// vectorized kernels for AVX-512F, 512-bit registers, compiled with -mavx512f
+#if defined(__x86_64__) || defined(__i386__)
+
+// gcc 12 reports the self initialized _mm512_undefined_* inside its own intrinsics
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+#include <immintrin.h>
+#include "kernels_impl.h"
+
+#if !(defined(__AVX512F__))
+#error "this file should be compiled with -mavx512f"
+#endif
+
+namespace gs
+{
+namespace
+{
+    struct AVX512F
+    {
+        typedef float T;
+        typedef __m512 R;
+        typedef __mmask16 M;
+        typedef __m512i I;
+        static const size_t W = 16;
+
+        static R load(const T *a)          { return _mm512_loadu_ps(a); }
+        static void store(T *a, R v)       { _mm512_storeu_ps(a, v); }
+        static R set1(T a)                 { return _mm512_set1_ps(a); }
+        static R zero()                    { return _mm512_setzero_ps(); }
+        static T inf()                     { return __builtin_huge_valf(); }
+        static T nan()                     { return __builtin_nanf(""); }
+
+        static R add(R a, R b)             { return _mm512_add_ps(a, b); }
+        static R sub(R a, R b)             { return _mm512_sub_ps(a, b); }
+        static R mul(R a, R b)             { return _mm512_mul_ps(a, b); }
+        static R div(R a, R b)             { return _mm512_div_ps(a, b); }
+        static R sqrt(R a)                 { return _mm512_sqrt_ps(a); }
+        static R min(R a, R b)             { return _mm512_min_ps(a, b); }
+        static R max(R a, R b)             { return _mm512_max_ps(a, b); }
+        static R fmadd(R a, R b, R c)      { return _mm512_fmadd_ps(a, b, c); }
+        static R fnmadd(R a, R b, R c)     { return _mm512_fnmadd_ps(a, b, c); }
+        static R round(R a)                { return _mm512_roundscale_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+        static R floor(R a)                { return _mm512_roundscale_ps(a, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+
+        static M gt(R a, R b)              { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+        static M lt(R a, R b)              { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+        static M eq(R a, R b)              { return _mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ); }
+        static M unord(R a)                { return _mm512_cmp_ps_mask(a, a, _CMP_UNORD_Q); }
+        // m ? b : a
+        static R blend(M m, R a, R b)      { return _mm512_mask_blend_ps(m, a, b); }
+
+        static I as_int(R a)               { return _mm512_castps_si512(a); }
+        static R as_real(I a)              { return _mm512_castsi512_ps(a); }
+        static I and_(I a, I b)            { return _mm512_and_si512(a, b); }
+        static I or_(I a, I b)             { return _mm512_or_si512(a, b); }
+        static I shl_mant(I a)             { return _mm512_slli_epi32(a, 23); }
+        static I shr_mant(I a)             { return _mm512_srli_epi32(a, 23); }
+        static I mant_mask()               { return _mm512_set1_epi32(0x007fffff); }
+        static R abs(R a)                  { return as_real(and_(as_int(a), _mm512_set1_epi32(0x7fffffff))); }
+        static R copysign(R a, R b)        { return as_real(or_(as_int(abs(a)), and_(as_int(b), as_int(set1(-0.0f))))); }
+    };
+
+    struct AVX512D
+    {
+        typedef double T;
+        typedef __m512d R;
+        typedef __mmask8 M;
+        typedef __m512i I;
+        static const size_t W = 8;
+
+        static R load(const T *a)          { return _mm512_loadu_pd(a); }
+        static void store(T *a, R v)       { _mm512_storeu_pd(a, v); }
+        static R set1(T a)                 { return _mm512_set1_pd(a); }
+        static R zero()                    { return _mm512_setzero_pd(); }
+        static T inf()                     { return __builtin_huge_val(); }
+        static T nan()                     { return __builtin_nan(""); }
+
+        static R add(R a, R b)             { return _mm512_add_pd(a, b); }
+        static R sub(R a, R b)             { return _mm512_sub_pd(a, b); }
+        static R mul(R a, R b)             { return _mm512_mul_pd(a, b); }
+        static R div(R a, R b)             { return _mm512_div_pd(a, b); }
+        static R sqrt(R a)                 { return _mm512_sqrt_pd(a); }
+        static R min(R a, R b)             { return _mm512_min_pd(a, b); }
+        static R max(R a, R b)             { return _mm512_max_pd(a, b); }
+        static R fmadd(R a, R b, R c)      { return _mm512_fmadd_pd(a, b, c); }
+        static R fnmadd(R a, R b, R c)     { return _mm512_fnmadd_pd(a, b, c); }
+        static R round(R a)                { return _mm512_roundscale_pd(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+        static R floor(R a)                { return _mm512_roundscale_pd(a, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC); }
+
+        static M gt(R a, R b)              { return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ); }
+        static M lt(R a, R b)              { return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+        static M eq(R a, R b)              { return _mm512_cmp_pd_mask(a, b, _CMP_EQ_OQ); }
+        static M unord(R a)                { return _mm512_cmp_pd_mask(a, a, _CMP_UNORD_Q); }
+        // m ? b : a
+        static R blend(M m, R a, R b)      { return _mm512_mask_blend_pd(m, a, b); }
+
+        static I as_int(R a)               { return _mm512_castpd_si512(a); }
+        static R as_real(I a)              { return _mm512_castsi512_pd(a); }
+        static I and_(I a, I b)            { return _mm512_and_si512(a, b); }
+        static I or_(I a, I b)             { return _mm512_or_si512(a, b); }
+        static I shl_mant(I a)             { return _mm512_slli_epi64(a, 52); }
+        static I shr_mant(I a)             { return _mm512_srli_epi64(a, 52); }
+        static I mant_mask()               { return _mm512_set1_epi64(0x000fffffffffffffLL); }
+        static R abs(R a)                  { return as_real(and_(as_int(a), _mm512_set1_epi64(0x7fffffffffffffffLL))); }
+        static R copysign(R a, R b)        { return as_real(or_(as_int(abs(a)), and_(as_int(b), as_int(set1(-0.0))))); }
+    };
+
+}
+
+    void load_avx512_kernels(KernelTable<float> &float_table, KernelTable<double> &double_table) {
+        fill_table<AVX512F>(float_table);
+        fill_table<AVX512D>(double_table);
+    }
+
+}
+
+#endif
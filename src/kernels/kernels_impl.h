@@ -0,0 +1,489 @@
+#ifndef _GALOIS_KERNELS_IMPL_H_
+#define _GALOIS_KERNELS_IMPL_H_
+
+// Generic vectorized kernels, included once by every isa specific translation unit.
+// Everything lives in an anonymous namespace and only uses the traits V, so that the
+// code generated with different -m flags never gets merged by the linker.
+// V provides the register type R, the mask type M, the integer type I, the width W and
+// the element-wise operations used below.
+
+#include "kernel_table.h"
+#include <cmath>
+
+namespace gs
+{
+namespace
+{
+
+    template<typename T>
+    struct MathConst;
+
+    template<>
+    struct MathConst<float>
+    {
+        static constexpr float exp_hi = 88.7228391f;        // log(FLT_MAX)
+        static constexpr float exp_lo = -103.972076f;       // below the smallest denormal
+        static constexpr float log2e = 1.44269504088896341f;
+        static constexpr float ln2_hi = 0.693359375f;
+        static constexpr float ln2_lo = -2.12194440e-4f;
+        static constexpr float pow2_magic = 12582912.0f + 127.0f;    // 1.5*2^23 + bias
+        static constexpr float two_mant = 8388608.0f;                // 2^23
+        static constexpr float bias = 127.0f;
+        static constexpr float min_normal = 1.17549435e-38f;
+        static constexpr float denorm_scale = 33554432.0f;           // 2^25
+        static constexpr float denorm_bits = 25.0f;
+        static constexpr float sqrt2 = 1.41421356237309505f;
+        static constexpr float tanh_small = 0.625f;
+    };
+
+    template<>
+    struct MathConst<double>
+    {
+        static constexpr double exp_hi = 709.782712893383973;     // log(DBL_MAX)
+        static constexpr double exp_lo = -745.133219101941108;    // below the smallest denormal
+        static constexpr double log2e = 1.44269504088896340736;
+        static constexpr double ln2_hi = 6.93145751953125E-1;
+        static constexpr double ln2_lo = 1.42860682030941723212E-6;
+        static constexpr double pow2_magic = 6755399441055744.0 + 1023.0;   // 1.5*2^52 + bias
+        static constexpr double two_mant = 4503599627370496.0;              // 2^52
+        static constexpr double bias = 1023.0;
+        static constexpr double min_normal = 2.2250738585072014e-308;
+        static constexpr double denorm_scale = 18014398509481984.0;         // 2^54
+        static constexpr double denorm_bits = 54.0;
+        static constexpr double sqrt2 = 1.41421356237309504880;
+        static constexpr double tanh_small = 0.625;
+    };
+
+    // exp(r) for |r| <= ln2/2 (cephes expf)
+    template<class V>
+    inline typename V::R exp_poly(typename V::R r, float) {
+        typedef typename V::R R;
+        R p = V::set1(1.9875691500E-4f);
+        p = V::fmadd(p, r, V::set1(1.3981999507E-3f));
+        p = V::fmadd(p, r, V::set1(8.3334519073E-3f));
+        p = V::fmadd(p, r, V::set1(4.1665795894E-2f));
+        p = V::fmadd(p, r, V::set1(1.6666665459E-1f));
+        p = V::fmadd(p, r, V::set1(5.0000001201E-1f));
+        p = V::fmadd(p, V::mul(r, r), r);
+        return V::add(p, V::set1(1.0f));
+    }
+
+    // exp(r) for |r| <= ln2/2 (cephes exp, pade approximation)
+    template<class V>
+    inline typename V::R exp_poly(typename V::R r, double) {
+        typedef typename V::R R;
+        R rr = V::mul(r, r);
+        R p = V::set1(1.26177193074810590878E-4);
+        p = V::fmadd(p, rr, V::set1(3.02994407707441961300E-2));
+        p = V::fmadd(p, rr, V::set1(9.99999999999999999910E-1));
+        p = V::mul(p, r);
+        R q = V::set1(3.00198505138664455042E-6);
+        q = V::fmadd(q, rr, V::set1(2.52448340349684104192E-3));
+        q = V::fmadd(q, rr, V::set1(2.27265548208155028766E-1));
+        q = V::fmadd(q, rr, V::set1(2.00000000000000000009E0));
+        R e = V::div(p, V::sub(q, p));
+        return V::fmadd(V::set1(2.0), e, V::set1(1.0));
+    }
+
+    // 2*atanh(s)/(2*s) = sum(k)(s^2k/(2k+1)), |s| <= 3-2*sqrt(2)
+    template<class V>
+    inline typename V::R log_poly(typename V::R z, float) {
+        typedef typename V::R R;
+        R p = V::set1(1.0f/11);
+        p = V::fmadd(p, z, V::set1(1.0f/9));
+        p = V::fmadd(p, z, V::set1(1.0f/7));
+        p = V::fmadd(p, z, V::set1(1.0f/5));
+        p = V::fmadd(p, z, V::set1(1.0f/3));
+        return V::fmadd(p, z, V::set1(1.0f));
+    }
+
+    template<class V>
+    inline typename V::R log_poly(typename V::R z, double) {
+        typedef typename V::R R;
+        R p = V::set1(1.0/23);
+        for (int k = 10; k >= 0; k--) {
+            p = V::fmadd(p, z, V::set1(1.0/(2*k+1)));
+        }
+        return p;
+    }
+
+    // tanh(x) for |x| < 0.625 (cephes tanhf)
+    template<class V>
+    inline typename V::R tanh_poly(typename V::R x, float) {
+        typedef typename V::R R;
+        R z = V::mul(x, x);
+        R p = V::set1(-5.70498872745E-3f);
+        p = V::fmadd(p, z, V::set1(2.06390887954E-2f));
+        p = V::fmadd(p, z, V::set1(-5.37397155531E-2f));
+        p = V::fmadd(p, z, V::set1(1.33314422036E-1f));
+        p = V::fmadd(p, z, V::set1(-3.33332819422E-1f));
+        return V::fmadd(V::mul(p, z), x, x);
+    }
+
+    // tanh(x) for |x| < 0.625 (cephes tanh, rational approximation)
+    template<class V>
+    inline typename V::R tanh_poly(typename V::R x, double) {
+        typedef typename V::R R;
+        R z = V::mul(x, x);
+        R p = V::set1(-9.64399179425052238628E-1);
+        p = V::fmadd(p, z, V::set1(-9.92877231001918586564E1));
+        p = V::fmadd(p, z, V::set1(-1.61468768441708447952E3));
+        R q = V::add(z, V::set1(1.12811678491632931402E2));
+        q = V::fmadd(q, z, V::set1(2.23548839060100448583E3));
+        q = V::fmadd(q, z, V::set1(4.84406305325125486048E3));
+        return V::fmadd(V::mul(x, z), V::div(p, q), x);
+    }
+
+    // 2^a for integral a that keeps 2^a a normal number
+    template<class V>
+    inline typename V::R pow2i(typename V::R a) {
+        typedef MathConst<typename V::T> C;
+        return V::as_real(V::shl_mant(V::as_int(V::add(a, V::set1(C::pow2_magic)))));
+    }
+
+    template<class V>
+    inline typename V::R exp_v(typename V::R x) {
+        typedef typename V::T T;
+        typedef typename V::R R;
+        typedef MathConst<T> C;
+        R xc = V::min(V::max(x, V::set1(C::exp_lo)), V::set1(C::exp_hi));
+        R n = V::round(V::mul(xc, V::set1(C::log2e)));
+        R r = V::fnmadd(n, V::set1(C::ln2_hi), xc);
+        r = V::fnmadd(n, V::set1(C::ln2_lo), r);
+        R p = exp_poly<V>(r, T());
+        // 2^n is split into two factors, so that each one is a normal number
+        R a = V::floor(V::mul(n, V::set1(T(0.5))));
+        R b = V::sub(n, a);
+        p = V::mul(V::mul(p, pow2i<V>(a)), pow2i<V>(b));
+        p = V::blend(V::gt(x, V::set1(C::exp_hi)), p, V::set1(V::inf()));
+        p = V::blend(V::lt(x, V::set1(C::exp_lo)), p, V::zero());
+        return V::blend(V::unord(x), p, x);
+    }
+
+    template<class V>
+    inline typename V::R log_v(typename V::R x) {
+        typedef typename V::T T;
+        typedef typename V::R R;
+        typedef typename V::I I;
+        typedef MathConst<T> C;
+        // denormals are scaled into the normal range first
+        auto denorm = V::lt(x, V::set1(C::min_normal));
+        R xs = V::blend(denorm, x, V::mul(x, V::set1(C::denorm_scale)));
+        R e_adj = V::blend(denorm, V::set1(-C::bias), V::set1(-C::bias - C::denorm_bits));
+        I bits = V::as_int(xs);
+        // x = m * 2^e with m in [1, 2)
+        R e = V::sub(V::as_real(V::or_(V::shr_mant(bits), V::as_int(V::set1(C::two_mant)))), V::set1(C::two_mant));
+        e = V::add(e, e_adj);
+        R one = V::set1(T(1));
+        R m = V::as_real(V::or_(V::and_(bits, V::mant_mask()), V::as_int(one)));
+        // move m into [sqrt(2)/2, sqrt(2))
+        auto big = V::gt(m, V::set1(C::sqrt2));
+        m = V::blend(big, m, V::mul(m, V::set1(T(0.5))));
+        e = V::blend(big, e, V::add(e, one));
+        // log(m) = 2*atanh(s), s = (m-1)/(m+1)
+        R s = V::div(V::sub(m, one), V::add(m, one));
+        R lm = V::mul(V::add(s, s), log_poly<V>(V::mul(s, s), T()));
+        R res = V::fmadd(e, V::set1(C::ln2_hi), V::fmadd(e, V::set1(C::ln2_lo), lm));
+        res = V::blend(V::eq(x, V::zero()), res, V::set1(-V::inf()));
+        res = V::blend(V::lt(x, V::zero()), res, V::set1(V::nan()));
+        res = V::blend(V::eq(x, V::set1(V::inf())), res, x);
+        return V::blend(V::unord(x), res, x);
+    }
+
+    template<class V>
+    inline typename V::R tanh_v(typename V::R x) {
+        typedef typename V::T T;
+        typedef typename V::R R;
+        typedef MathConst<T> C;
+        R ax = V::abs(x);
+        // tanh(|x|) = 1 - 2/(exp(2|x|)+1), which loses precision only near 0
+        R e = exp_v<V>(V::add(ax, ax));
+        R one = V::set1(T(1));
+        R large = V::sub(one, V::div(V::set1(T(2)), V::add(e, one)));
+        large = V::copysign(large, x);
+        return V::blend(V::lt(ax, V::set1(C::tanh_small)), large, tanh_poly<V>(x, T()));
+    }
+
+    // y = f(x) or y += f(x); the tail is padded into a full register
+    template<class V, bool overwrite, class F>
+    inline void map1(typename V::T *y, const typename V::T *x, size_t n, F f) {
+        typedef typename V::T T;
+        typedef typename V::R R;
+        size_t i = 0;
+        for (; i + V::W <= n; i += V::W) {
+            R r = f(V::load(x + i));
+            if (!overwrite) {
+                r = V::add(V::load(y + i), r);
+            }
+            V::store(y + i, r);
+        }
+        if (i < n) {
+            T xb[V::W];
+            T yb[V::W];
+            for (size_t k = 0; k < V::W; k++) {
+                xb[k] = (i + k < n) ? x[i + k] : T(0);
+                yb[k] = (i + k < n) ? y[i + k] : T(0);
+            }
+            R r = f(V::load(xb));
+            if (!overwrite) {
+                r = V::add(V::load(yb), r);
+            }
+            V::store(yb, r);
+            for (size_t k = 0; i + k < n; k++) {
+                y[i + k] = yb[k];
+            }
+        }
+    }
+
+    // y = f(x, z) or y += f(x, z)
+    template<class V, bool overwrite, class F>
+    inline void map2(typename V::T *y, const typename V::T *x, const typename V::T *z, size_t n, F f) {
+        typedef typename V::T T;
+        typedef typename V::R R;
+        size_t i = 0;
+        for (; i + V::W <= n; i += V::W) {
+            R r = f(V::load(x + i), V::load(z + i));
+            if (!overwrite) {
+                r = V::add(V::load(y + i), r);
+            }
+            V::store(y + i, r);
+        }
+        if (i < n) {
+            T xb[V::W];
+            T zb[V::W];
+            T yb[V::W];
+            for (size_t k = 0; k < V::W; k++) {
+                xb[k] = (i + k < n) ? x[i + k] : T(0);
+                zb[k] = (i + k < n) ? z[i + k] : T(0);
+                yb[k] = (i + k < n) ? y[i + k] : T(0);
+            }
+            R r = f(V::load(xb), V::load(zb));
+            if (!overwrite) {
+                r = V::add(V::load(yb), r);
+            }
+            V::store(yb, r);
+            for (size_t k = 0; i + k < n; k++) {
+                y[i + k] = yb[k];
+            }
+        }
+    }
+
+    struct TanhV {
+        template<class V> static typename V::R apply(typename V::R x) { return tanh_v<V>(x); }
+    };
+    struct ExpV {
+        template<class V> static typename V::R apply(typename V::R x) { return exp_v<V>(x); }
+    };
+    struct LogV {
+        template<class V> static typename V::R apply(typename V::R x) { return log_v<V>(x); }
+    };
+
+    template<class V, class OP>
+    void unary_kernel(typename V::T *y, const typename V::T *x, size_t n, bool overwrite) {
+        typedef typename V::R R;
+        auto f = [](R v) { return OP::template apply<V>(v); };
+        if (overwrite) {
+            map1<V, true>(y, x, n, f);
+        } else {
+            map1<V, false>(y, x, n, f);
+        }
+    }
+
+    template<class V>
+    void scale_kernel(typename V::T *y, typename V::T a, const typename V::T *x, size_t n, bool overwrite) {
+        typedef typename V::R R;
+        R va = V::set1(a);
+        auto f = [va](R v) { return V::mul(va, v); };
+        if (overwrite) {
+            map1<V, true>(y, x, n, f);
+        } else {
+            map1<V, false>(y, x, n, f);
+        }
+    }
+
+    template<class V>
+    void tanh_grad_kernel(typename V::T *dx, const typename V::T *dy, const typename V::T *y, size_t n, bool overwrite) {
+        typedef typename V::R R;
+        auto f = [](R vdy, R vy) { return V::mul(vdy, V::fnmadd(vy, vy, V::set1(typename V::T(1)))); };
+        if (overwrite) {
+            map2<V, true>(dx, dy, y, n, f);
+        } else {
+            map2<V, false>(dx, dy, y, n, f);
+        }
+    }
+
+    template<class V>
+    void tanh_grad_input_kernel(typename V::T *dx, const typename V::T *dy, const typename V::T *x, size_t n, bool overwrite) {
+        typedef typename V::R R;
+        auto f = [](R vdy, R vx) {
+            R t = tanh_v<V>(vx);
+            return V::mul(vdy, V::fnmadd(t, t, V::set1(typename V::T(1))));
+        };
+        if (overwrite) {
+            map2<V, true>(dx, dy, x, n, f);
+        } else {
+            map2<V, false>(dx, dy, x, n, f);
+        }
+    }
+
+    template<class V>
+    void add_kernel(typename V::T *y, const typename V::T *x, size_t n) {
+        typedef typename V::R R;
+        map1<V, false>(y, x, n, [](R v) { return v; });
+    }
+
+    // optimizer steps, every element is read and written once, the tail is done in scalar
+
+    template<class V>
+    void momentum_kernel(typename V::T *p, typename V::T *v, const typename V::T *g, size_t n,
+                         typename V::T lr, typename V::T mu, bool nesterov) {
+        typedef typename V::T T;
+        typedef typename V::R R;
+        R vlr = V::set1(lr);
+        R vmu = V::set1(mu);
+        size_t i = 0;
+        for (; i + V::W <= n; i += V::W) {
+            R vg = V::load(g + i);
+            R vv = V::fmadd(vmu, V::load(v + i), vg);
+            V::store(v + i, vv);
+            R d = nesterov ? V::fmadd(vmu, vv, vg) : vv;
+            V::store(p + i, V::fnmadd(vlr, d, V::load(p + i)));
+        }
+        for (; i < n; i++) {
+            T vv = mu*v[i] + g[i];
+            v[i] = vv;
+            p[i] -= lr * (nesterov ? g[i] + mu*vv : vv);
+        }
+    }
+
+    template<class V>
+    void rmsprop_kernel(typename V::T *p, typename V::T *s, const typename V::T *g, size_t n,
+                        typename V::T lr, typename V::T rho, typename V::T eps) {
+        typedef typename V::T T;
+        typedef typename V::R R;
+        R vlr = V::set1(lr);
+        R vrho = V::set1(rho);
+        R vrho1 = V::set1(T(1) - rho);
+        R veps = V::set1(eps);
+        size_t i = 0;
+        for (; i + V::W <= n; i += V::W) {
+            R vg = V::load(g + i);
+            R vs = V::fmadd(vrho, V::load(s + i), V::mul(vrho1, V::mul(vg, vg)));
+            V::store(s + i, vs);
+            R d = V::div(vg, V::add(V::sqrt(vs), veps));
+            V::store(p + i, V::fnmadd(vlr, d, V::load(p + i)));
+        }
+        for (; i < n; i++) {
+            s[i] = rho*s[i] + (T(1) - rho)*g[i]*g[i];
+            p[i] -= lr * g[i] / (std::sqrt(s[i]) + eps);
+        }
+    }
+
+    template<class V>
+    void adam_kernel(typename V::T *p, typename V::T *m, typename V::T *v, const typename V::T *g, size_t n,
+                     typename V::T lr, typename V::T beta1, typename V::T beta2, typename V::T eps) {
+        typedef typename V::T T;
+        typedef typename V::R R;
+        R vlr = V::set1(lr);
+        R vb1 = V::set1(beta1);
+        R vb11 = V::set1(T(1) - beta1);
+        R vb2 = V::set1(beta2);
+        R vb21 = V::set1(T(1) - beta2);
+        R veps = V::set1(eps);
+        size_t i = 0;
+        for (; i + V::W <= n; i += V::W) {
+            R vg = V::load(g + i);
+            R vm = V::fmadd(vb1, V::load(m + i), V::mul(vb11, vg));
+            R vv = V::fmadd(vb2, V::load(v + i), V::mul(vb21, V::mul(vg, vg)));
+            V::store(m + i, vm);
+            V::store(v + i, vv);
+            R d = V::div(vm, V::add(V::sqrt(vv), veps));
+            V::store(p + i, V::fnmadd(vlr, d, V::load(p + i)));
+        }
+        for (; i < n; i++) {
+            m[i] = beta1*m[i] + (T(1) - beta1)*g[i];
+            v[i] = beta2*v[i] + (T(1) - beta2)*g[i]*g[i];
+            p[i] -= lr * m[i] / (std::sqrt(v[i]) + eps);
+        }
+    }
+
+    // reductions over a row of n > 0 elements, for the softmax of a row
+
+    // the largest element, nan is skipped unless it is the first one, as a scalar loop does
+    template<class V>
+    typename V::T max_kernel(const typename V::T *x, size_t n) {
+        typedef typename V::T T;
+        typedef typename V::R R;
+        T res = x[0];
+        size_t i = 0;
+        if (n >= V::W) {
+            // max returns its second operand if one of them is nan
+            R acc = V::set1(x[0]);
+            for (; i + V::W <= n; i += V::W) {
+                acc = V::max(V::load(x + i), acc);
+            }
+            T buf[V::W];
+            V::store(buf, acc);
+            for (size_t k = 0; k < V::W; k++) {
+                res = buf[k] > res ? buf[k] : res;
+            }
+        }
+        for (; i < n; i++) {
+            res = x[i] > res ? x[i] : res;
+        }
+        return res;
+    }
+
+    // y = exp(x - shift), and the sum of y is returned
+    template<class V>
+    typename V::T exp_sum_kernel(typename V::T *y, const typename V::T *x, typename V::T shift, size_t n) {
+        typedef typename V::T T;
+        typedef typename V::R R;
+        R vs = V::set1(shift);
+        R acc = V::zero();
+        size_t i = 0;
+        for (; i + V::W <= n; i += V::W) {
+            R r = exp_v<V>(V::sub(V::load(x + i), vs));
+            V::store(y + i, r);
+            acc = V::add(acc, r);
+        }
+        T buf[V::W];
+        V::store(buf, acc);
+        T sum = 0;
+        for (size_t k = 0; k < V::W; k++) {
+            sum += buf[k];
+        }
+        if (i < n) {
+            T xb[V::W];
+            for (size_t k = 0; k < V::W; k++) {
+                xb[k] = (i + k < n) ? x[i + k] : shift;
+            }
+            V::store(buf, exp_v<V>(V::sub(V::load(xb), vs)));
+            for (size_t k = 0; i + k < n; k++) {
+                y[i + k] = buf[k];
+                sum += buf[k];
+            }
+        }
+        return sum;
+    }
+
+    template<class V>
+    void fill_table(KernelTable<typename V::T> &table) {
+        table.tanh = unary_kernel<V, TanhV>;
+        table.exp = unary_kernel<V, ExpV>;
+        table.log = unary_kernel<V, LogV>;
+        table.scale = scale_kernel<V>;
+        table.tanh_grad = tanh_grad_kernel<V>;
+        table.tanh_grad_input = tanh_grad_input_kernel<V>;
+        table.add = add_kernel<V>;
+        table.momentum = momentum_kernel<V>;
+        table.rmsprop = rmsprop_kernel<V>;
+        table.adam = adam_kernel<V>;
+        table.max = max_kernel<V>;
+        table.exp_sum = exp_sum_kernel<V>;
+    }
+
+}
+}
+
+#endif
@@ -0,0 +1,114 @@
+// vectorized kernels for SSE4.1, 128-bit registers, compiled with -msse4.1
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+#include "kernels_impl.h"
+
+#if !(defined(__SSE4_1__))
+#error "this file should be compiled with -msse4.1"
+#endif
+
+namespace gs
+{
+namespace
+{
+    struct SSE4F
+    {
+        typedef float T;
+        typedef __m128 R;
+        typedef __m128 M;
+        typedef __m128i I;
+        static const size_t W = 4;
+
+        static R load(const T *a)          { return _mm_loadu_ps(a); }
+        static void store(T *a, R v)       { _mm_storeu_ps(a, v); }
+        static R set1(T a)                 { return _mm_set1_ps(a); }
+        static R zero()                    { return _mm_setzero_ps(); }
+        static T inf()                     { return __builtin_huge_valf(); }
+        static T nan()                     { return __builtin_nanf(""); }
+
+        static R add(R a, R b)             { return _mm_add_ps(a, b); }
+        static R sub(R a, R b)             { return _mm_sub_ps(a, b); }
+        static R mul(R a, R b)             { return _mm_mul_ps(a, b); }
+        static R div(R a, R b)             { return _mm_div_ps(a, b); }
+        static R sqrt(R a)                 { return _mm_sqrt_ps(a); }
+        static R min(R a, R b)             { return _mm_min_ps(a, b); }
+        static R max(R a, R b)             { return _mm_max_ps(a, b); }
+        static R fmadd(R a, R b, R c)      { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+        static R fnmadd(R a, R b, R c)     { return _mm_sub_ps(c, _mm_mul_ps(a, b)); }
+        static R round(R a)                { return _mm_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+        static R floor(R a)                { return _mm_floor_ps(a); }
+
+        static M gt(R a, R b)              { return _mm_cmpgt_ps(a, b); }
+        static M lt(R a, R b)              { return _mm_cmplt_ps(a, b); }
+        static M eq(R a, R b)              { return _mm_cmpeq_ps(a, b); }
+        static M unord(R a)                { return _mm_cmpunord_ps(a, a); }
+        // m ? b : a
+        static R blend(M m, R a, R b)      { return _mm_blendv_ps(a, b, m); }
+
+        static I as_int(R a)               { return _mm_castps_si128(a); }
+        static R as_real(I a)              { return _mm_castsi128_ps(a); }
+        static I and_(I a, I b)            { return _mm_and_si128(a, b); }
+        static I or_(I a, I b)             { return _mm_or_si128(a, b); }
+        static I shl_mant(I a)             { return _mm_slli_epi32(a, 23); }
+        static I shr_mant(I a)             { return _mm_srli_epi32(a, 23); }
+        static I mant_mask()               { return _mm_set1_epi32(0x007fffff); }
+        static R abs(R a)                  { return as_real(and_(as_int(a), _mm_set1_epi32(0x7fffffff))); }
+        static R copysign(R a, R b)        { return as_real(or_(as_int(abs(a)), and_(as_int(b), as_int(set1(-0.0f))))); }
+    };
+
+    struct SSE4D
+    {
+        typedef double T;
+        typedef __m128d R;
+        typedef __m128d M;
+        typedef __m128i I;
+        static const size_t W = 2;
+
+        static R load(const T *a)          { return _mm_loadu_pd(a); }
+        static void store(T *a, R v)       { _mm_storeu_pd(a, v); }
+        static R set1(T a)                 { return _mm_set1_pd(a); }
+        static R zero()                    { return _mm_setzero_pd(); }
+        static T inf()                     { return __builtin_huge_val(); }
+        static T nan()                     { return __builtin_nan(""); }
+
+        static R add(R a, R b)             { return _mm_add_pd(a, b); }
+        static R sub(R a, R b)             { return _mm_sub_pd(a, b); }
+        static R mul(R a, R b)             { return _mm_mul_pd(a, b); }
+        static R div(R a, R b)             { return _mm_div_pd(a, b); }
+        static R sqrt(R a)                 { return _mm_sqrt_pd(a); }
+        static R min(R a, R b)             { return _mm_min_pd(a, b); }
+        static R max(R a, R b)             { return _mm_max_pd(a, b); }
+        static R fmadd(R a, R b, R c)      { return _mm_add_pd(_mm_mul_pd(a, b), c); }
+        static R fnmadd(R a, R b, R c)     { return _mm_sub_pd(c, _mm_mul_pd(a, b)); }
+        static R round(R a)                { return _mm_round_pd(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+        static R floor(R a)                { return _mm_floor_pd(a); }
+
+        static M gt(R a, R b)              { return _mm_cmpgt_pd(a, b); }
+        static M lt(R a, R b)              { return _mm_cmplt_pd(a, b); }
+        static M eq(R a, R b)              { return _mm_cmpeq_pd(a, b); }
+        static M unord(R a)                { return _mm_cmpunord_pd(a, a); }
+        // m ? b : a
+        static R blend(M m, R a, R b)      { return _mm_blendv_pd(a, b, m); }
+
+        static I as_int(R a)               { return _mm_castpd_si128(a); }
+        static R as_real(I a)              { return _mm_castsi128_pd(a); }
+        static I and_(I a, I b)            { return _mm_and_si128(a, b); }
+        static I or_(I a, I b)             { return _mm_or_si128(a, b); }
+        static I shl_mant(I a)             { return _mm_slli_epi64(a, 52); }
+        static I shr_mant(I a)             { return _mm_srli_epi64(a, 52); }
+        static I mant_mask()               { return _mm_set1_epi64x(0x000fffffffffffffLL); }
+        static R abs(R a)                  { return as_real(and_(as_int(a), _mm_set1_epi64x(0x7fffffffffffffffLL))); }
+        static R copysign(R a, R b)        { return as_real(or_(as_int(abs(a)), and_(as_int(b), as_int(set1(-0.0))))); }
+    };
+
+}
+
+    void load_sse4_kernels(KernelTable<float> &float_table, KernelTable<double> &double_table) {
+        fill_table<SSE4F>(float_table);
+        fill_table<SSE4D>(double_table);
+    }
+
+}
+
+#endif
@@ -0,0 +1,375 @@
+#include "galois/narray_kernels.h"
+#include "kernel_table.h"
+#include "galois/utils.h"
+#include "galois/thread_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace gs
+{
+
+    namespace
+    {
+
+        template<typename T, bool overwrite, typename FUNC>
+        void scalar_map(T *y, const T *x, size_t n, FUNC f) {
+            for (size_t i = 0; i < n; i++) {
+                if (overwrite) {
+                    y[i] = f(x[i]);
+                } else {
+                    y[i] += f(x[i]);
+                }
+            }
+        }
+
+        template<typename T, bool overwrite, typename FUNC>
+        void scalar_map(T *y, const T *x, const T *z, size_t n, FUNC f) {
+            for (size_t i = 0; i < n; i++) {
+                if (overwrite) {
+                    y[i] = f(x[i], z[i]);
+                } else {
+                    y[i] += f(x[i], z[i]);
+                }
+            }
+        }
+
+        template<typename T>
+        void scalar_tanh(T *y, const T *x, size_t n, bool overwrite) {
+            auto f = [](T v){ return std::tanh(v); };
+            if (overwrite) {
+                scalar_map<T, true>(y, x, n, f);
+            } else {
+                scalar_map<T, false>(y, x, n, f);
+            }
+        }
+
+        template<typename T>
+        void scalar_exp(T *y, const T *x, size_t n, bool overwrite) {
+            auto f = [](T v){ return std::exp(v); };
+            if (overwrite) {
+                scalar_map<T, true>(y, x, n, f);
+            } else {
+                scalar_map<T, false>(y, x, n, f);
+            }
+        }
+
+        template<typename T>
+        void scalar_log(T *y, const T *x, size_t n, bool overwrite) {
+            auto f = [](T v){ return std::log(v); };
+            if (overwrite) {
+                scalar_map<T, true>(y, x, n, f);
+            } else {
+                scalar_map<T, false>(y, x, n, f);
+            }
+        }
+
+        template<typename T>
+        void scalar_scale(T *y, T a, const T *x, size_t n, bool overwrite) {
+            auto f = [a](T v){ return a*v; };
+            if (overwrite) {
+                scalar_map<T, true>(y, x, n, f);
+            } else {
+                scalar_map<T, false>(y, x, n, f);
+            }
+        }
+
+        template<typename T>
+        void scalar_tanh_grad(T *dx, const T *dy, const T *y, size_t n, bool overwrite) {
+            auto f = [](T vdy, T vy){ return vdy*(1-vy*vy); };
+            if (overwrite) {
+                scalar_map<T, true>(dx, dy, y, n, f);
+            } else {
+                scalar_map<T, false>(dx, dy, y, n, f);
+            }
+        }
+
+        template<typename T>
+        void scalar_tanh_grad_input(T *dx, const T *dy, const T *x, size_t n, bool overwrite) {
+            auto f = [](T vdy, T vx){ T t = std::tanh(vx); return vdy*(1-t*t); };
+            if (overwrite) {
+                scalar_map<T, true>(dx, dy, x, n, f);
+            } else {
+                scalar_map<T, false>(dx, dy, x, n, f);
+            }
+        }
+
+        template<typename T>
+        void scalar_add(T *y, const T *x, size_t n) {
+            for (size_t i = 0; i < n; i++) {
+                y[i] += x[i];
+            }
+        }
+
+        template<typename T>
+        void scalar_momentum(T *p, T *v, const T *g, size_t n, T lr, T mu, bool nesterov) {
+            for (size_t i = 0; i < n; i++) {
+                v[i] = mu*v[i] + g[i];
+                p[i] -= lr * (nesterov ? g[i] + mu*v[i] : v[i]);
+            }
+        }
+
+        template<typename T>
+        void scalar_rmsprop(T *p, T *s, const T *g, size_t n, T lr, T rho, T eps) {
+            for (size_t i = 0; i < n; i++) {
+                s[i] = rho*s[i] + (T(1) - rho)*g[i]*g[i];
+                p[i] -= lr * g[i] / (std::sqrt(s[i]) + eps);
+            }
+        }
+
+        template<typename T>
+        void scalar_adam(T *p, T *m, T *v, const T *g, size_t n, T lr, T beta1, T beta2, T eps) {
+            for (size_t i = 0; i < n; i++) {
+                m[i] = beta1*m[i] + (T(1) - beta1)*g[i];
+                v[i] = beta2*v[i] + (T(1) - beta2)*g[i]*g[i];
+                p[i] -= lr * m[i] / (std::sqrt(v[i]) + eps);
+            }
+        }
+
+        template<typename T>
+        T scalar_max(const T *x, size_t n) {
+            T res = x[0];
+            for (size_t i = 1; i < n; i++) {
+                res = x[i] > res ? x[i] : res;
+            }
+            return res;
+        }
+
+        template<typename T>
+        T scalar_exp_sum(T *y, const T *x, T shift, size_t n) {
+            T sum = 0;
+            for (size_t i = 0; i < n; i++) {
+                y[i] = std::exp(x[i] - shift);
+                sum += y[i];
+            }
+            return sum;
+        }
+
+        template<typename T>
+        void load_scalar_kernels(KernelTable<T> &table) {
+            table.tanh = scalar_tanh<T>;
+            table.exp = scalar_exp<T>;
+            table.log = scalar_log<T>;
+            table.scale = scalar_scale<T>;
+            table.tanh_grad = scalar_tanh_grad<T>;
+            table.tanh_grad_input = scalar_tanh_grad_input<T>;
+            table.add = scalar_add<T>;
+            table.momentum = scalar_momentum<T>;
+            table.rmsprop = scalar_rmsprop<T>;
+            table.adam = scalar_adam<T>;
+            table.max = scalar_max<T>;
+            table.exp_sum = scalar_exp_sum<T>;
+        }
+
+        SimdLevel detect_simd_level() {
+            SimdLevel level = SIMD_NONE;
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512f")) {
+                level = SIMD_AVX512;
+            } else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+                level = SIMD_AVX2;
+            } else if (__builtin_cpu_supports("sse4.1")) {
+                level = SIMD_SSE4;
+            }
+#endif
+            const char *env = getenv("GALOIS_SIMD");
+            if (env) {
+                SimdLevel requested = level;
+                for (int l = SIMD_NONE; l <= SIMD_AVX512; l++) {
+                    if (strcmp(env, simd_level_name(SimdLevel(l))) == 0) {
+                        requested = SimdLevel(l);
+                    }
+                }
+                if (requested < level) {
+                    level = requested;
+                }
+            }
+            return level;
+        }
+
+        struct Kernels
+        {
+            SimdLevel level;
+            KernelTable<float> float_table;
+            KernelTable<double> double_table;
+
+            Kernels() : level(detect_simd_level()) {
+                load_scalar_kernels(float_table);
+                load_scalar_kernels(double_table);
+#if defined(__x86_64__) || defined(__i386__)
+                switch (level) {
+                case SIMD_AVX512: load_avx512_kernels(float_table, double_table); break;
+                case SIMD_AVX2:   load_avx2_kernels(float_table, double_table); break;
+                case SIMD_SSE4:   load_sse4_kernels(float_table, double_table); break;
+                default: break;
+                }
+#endif
+            }
+
+            KernelTable<float>& table(float)   { return float_table; }
+            KernelTable<double>& table(double) { return double_table; }
+        };
+
+        Kernels& kernels() {
+            static Kernels k;
+            return k;
+        }
+
+        template<typename T>
+        KernelTable<T>& table() {
+            return kernels().table(T());
+        }
+
+        // rows [begin, end) of softmax_cross_entropy, targets are checked by the caller
+        template<typename T>
+        T softmax_cross_entropy_rows(T *grad, T *pred, const T *x, const T *t, size_t begin, size_t end,
+                                     size_t n, T scale, T *losses) {
+            // exp of a row goes to grad, or to a scratch row if grad is not needed
+            thread_local std::vector<T> scratch;
+            if (!grad && scratch.size() < n) {
+                scratch.resize(n);
+            }
+            auto &kernels = table<T>();
+            T loss = 0;
+            for (size_t i = begin; i < end; i++) {
+                auto row = x + i*n;
+                T maxval = kernels.max(row, n);
+                // the first position of the max, 0 if it is nan
+                size_t maxidx = 0;
+                while (maxidx < n && !(row[maxidx] == maxval)) {
+                    maxidx++;
+                }
+                pred[i] = T(maxidx < n ? maxidx : 0);
+                auto e = grad ? grad + i*n : scratch.data();
+                T sum = kernels.exp_sum(e, row, maxval, n);
+                size_t target = size_t(t[i]);
+                T row_loss = std::log(sum) - (row[target] - maxval);
+                if (losses) {
+                    losses[i] = row_loss;
+                }
+                loss += row_loss;
+                if (grad) {
+                    kernels.scale(e, scale / sum, e, n, true);
+                    e[target] -= scale;
+                }
+            }
+            return loss;
+        }
+
+        // elements of the rows a task takes at least, so that small batches are not split
+        const size_t SOFTMAX_CHUNK_SIZE = 1 << 14;
+
+        template<typename T>
+        T softmax_cross_entropy(T *grad, T *pred, const T *x, const T *t, size_t m, size_t n, T scale,
+                                T *losses, ThreadPool *pool) {
+            for (size_t i = 0; i < m; i++) {
+                CHECK(size_t(t[i]) < n, "invalid target");
+            }
+            size_t num_chunks = 1;
+            if (pool) {
+                num_chunks = std::min(pool->get_num_threads(), std::max(size_t(1), m*n / SOFTMAX_CHUNK_SIZE));
+            }
+            if (num_chunks <= 1) {
+                return softmax_cross_entropy_rows(grad, pred, x, t, 0, m, n, scale, losses);
+            }
+            // rows are split in consecutive chunks, and their losses are added in order, so the loss does
+            // not depend on which thread runs a chunk
+            std::vector<T> chunk_losses(num_chunks, 0);
+            size_t rows = (m + num_chunks - 1) / num_chunks;
+            for (size_t c = 0; c < num_chunks; c++) {
+                size_t begin = c*rows;
+                size_t end = std::min(m, begin + rows);
+                pool->submit([=, &chunk_losses]() {
+                    chunk_losses[c] = softmax_cross_entropy_rows(grad, pred, x, t, begin, end, n, scale, losses);
+                });
+            }
+            pool->wait_all();
+            T loss = 0;
+            for (auto l : chunk_losses) {
+                loss += l;
+            }
+            return loss;
+        }
+
+    }
+
+    SimdLevel simd_level() {
+        return kernels().level;
+    }
+
+    const char* simd_level_name(SimdLevel level) {
+        switch (level) {
+        case SIMD_SSE4:   return "sse4";
+        case SIMD_AVX2:   return "avx2";
+        case SIMD_AVX512: return "avx512";
+        default:          return "none";
+        }
+    }
+
+    void vec_tanh(float *y, const float *x, size_t n, bool overwrite)     { table<float>().tanh(y, x, n, overwrite); }
+    void vec_tanh(double *y, const double *x, size_t n, bool overwrite)   { table<double>().tanh(y, x, n, overwrite); }
+    void vec_exp(float *y, const float *x, size_t n, bool overwrite)      { table<float>().exp(y, x, n, overwrite); }
+    void vec_exp(double *y, const double *x, size_t n, bool overwrite)    { table<double>().exp(y, x, n, overwrite); }
+    void vec_log(float *y, const float *x, size_t n, bool overwrite)      { table<float>().log(y, x, n, overwrite); }
+    void vec_log(double *y, const double *x, size_t n, bool overwrite)    { table<double>().log(y, x, n, overwrite); }
+
+    void vec_scale(float *y, float a, const float *x, size_t n, bool overwrite) {
+        table<float>().scale(y, a, x, n, overwrite);
+    }
+    void vec_scale(double *y, double a, const double *x, size_t n, bool overwrite) {
+        table<double>().scale(y, a, x, n, overwrite);
+    }
+
+    void vec_tanh_grad(float *dx, const float *dy, const float *y, size_t n, bool overwrite) {
+        table<float>().tanh_grad(dx, dy, y, n, overwrite);
+    }
+    void vec_tanh_grad(double *dx, const double *dy, const double *y, size_t n, bool overwrite) {
+        table<double>().tanh_grad(dx, dy, y, n, overwrite);
+    }
+
+    void vec_tanh_grad_input(float *dx, const float *dy, const float *x, size_t n, bool overwrite) {
+        table<float>().tanh_grad_input(dx, dy, x, n, overwrite);
+    }
+    void vec_tanh_grad_input(double *dx, const double *dy, const double *x, size_t n, bool overwrite) {
+        table<double>().tanh_grad_input(dx, dy, x, n, overwrite);
+    }
+
+    void vec_add(float *y, const float *x, size_t n)      { table<float>().add(y, x, n); }
+    void vec_add(double *y, const double *x, size_t n)    { table<double>().add(y, x, n); }
+
+    void vec_momentum_update(float *p, float *v, const float *g, size_t n, float lr, float mu, bool nesterov) {
+        table<float>().momentum(p, v, g, n, lr, mu, nesterov);
+    }
+    void vec_momentum_update(double *p, double *v, const double *g, size_t n, double lr, double mu, bool nesterov) {
+        table<double>().momentum(p, v, g, n, lr, mu, nesterov);
+    }
+
+    void vec_rmsprop_update(float *p, float *s, const float *g, size_t n, float lr, float rho, float eps) {
+        table<float>().rmsprop(p, s, g, n, lr, rho, eps);
+    }
+    void vec_rmsprop_update(double *p, double *s, const double *g, size_t n, double lr, double rho, double eps) {
+        table<double>().rmsprop(p, s, g, n, lr, rho, eps);
+    }
+
+    void vec_adam_update(float *p, float *m, float *v, const float *g, size_t n,
+                         float lr, float beta1, float beta2, float eps) {
+        table<float>().adam(p, m, v, g, n, lr, beta1, beta2, eps);
+    }
+    void vec_adam_update(double *p, double *m, double *v, const double *g, size_t n,
+                         double lr, double beta1, double beta2, double eps) {
+        table<double>().adam(p, m, v, g, n, lr, beta1, beta2, eps);
+    }
+
+    float vec_softmax_cross_entropy(float *grad, float *pred, const float *x, const float *t,
+                                    size_t m, size_t n, float scale, float *losses, ThreadPool *pool) {
+        return softmax_cross_entropy(grad, pred, x, t, m, n, scale, losses, pool);
+    }
+    double vec_softmax_cross_entropy(double *grad, double *pred, const double *x, const double *t,
+                                     size_t m, size_t n, double scale, double *losses, ThreadPool *pool) {
+        return softmax_cross_entropy(grad, pred, x, t, m, n, scale, losses, pool);
+    }
+
+}
@@ -0,0 +1,77 @@
+#include "galois/models/batch_prefetcher.h"
+
+#include <chrono>
+
+namespace gs
+{
+
+    template<typename T>
+    BatchPrefetcher<T>::BatchPrefetcher(const vector<SP_NArray<T>> &sources,
+                                        const vector<Shape> &dims,
+                                        function<void(vector<size_t>&)> next_ids)
+            : sources(sources)
+            , next_ids(next_ids) {
+        CHECK(!sources.empty() && sources.size() == dims.size(), "each source needs the dimensions of its batch");
+        for (auto &d : dims) {
+            buffers.push_back(make_shared<NArray<T>>(d));
+        }
+        requested = true;
+        worker = thread(&BatchPrefetcher<T>::_work, this);
+    }
+
+    template<typename T>
+    BatchPrefetcher<T>::~BatchPrefetcher() {
+        {
+            lock_guard<mutex> lock(m);
+            stop = true;
+        }
+        cv.notify_all();
+        worker.join();
+    }
+
+    template<typename T>
+    void BatchPrefetcher<T>::_work() {
+        while (true) {
+            {
+                unique_lock<mutex> lock(m);
+                cv.wait(lock, [this]{ return stop || requested; });
+                if (stop) {
+                    return;
+                }
+                requested = false;
+            }
+            next_ids(ids);
+            for (size_t k = 0; k < sources.size(); k++) {
+                buffers[k]->copy_from(ids, sources[k]);
+            }
+            {
+                lock_guard<mutex> lock(m);
+                ready = true;
+            }
+            cv.notify_all();
+        }
+    }
+
+    template<typename T>
+    void BatchPrefetcher<T>::next(function<void(size_t, SP_NArray<T>&)> install) {
+        {
+            auto start = chrono::steady_clock::now();
+            unique_lock<mutex> lock(m);
+            cv.wait(lock, [this]{ return ready; });
+            chrono::duration<double> waited = chrono::steady_clock::now() - start;
+            wait_seconds += waited.count();
+            num_batches++;
+
+            for (size_t k = 0; k < buffers.size(); k++) {
+                install(k, buffers[k]);
+            }
+            ready = false;
+            requested = true;
+        }
+        cv.notify_all();
+    }
+
+    template class BatchPrefetcher<float>;
+    template class BatchPrefetcher<double>;
+
+}
@@ -3,6 +3,7 @@
 #include "galois/filters.h"
 
 #include <chrono>
+#include <algorithm>
 
 namespace gs
 {
@@ -15,52 +16,58 @@ namespace gs
         return tag + "[" + to_string(i) + "," + to_string(j) + "]";
     }
 
+    // recurrent layers reading indexes at the first layer
+    template<typename T>
+    vector<SP_Filter<T>> bi_seq_layers(size_t input_size, vector<size_t> hidden_sizes) {
+        auto layers = vector<SP_Filter<T>>();
+        for (size_t j = 0; j < hidden_sizes.size(); j++) {
+            if (j == 0) {
+                layers.push_back(make_shared<RecurrentLayer<T>>(input_size, hidden_sizes[j], true));
+            } else {
+                layers.push_back(make_shared<RecurrentLayer<T>>(hidden_sizes[j-1], hidden_sizes[j]));
+            }
+        }
+        return layers;
+    }
+
     template<typename T>
     class Encoder : public OrderedNet<T>
     {
+    private:
+        size_t max_len;
+        // filters holding the params, links are shares of them
+        vector<SP_Filter<T>> layers;
+        vector<shared_ptr<RecurrentLayer<T>>> linked_layers = {};
+
     public:
         Encoder(const Encoder& other) = delete;
         Encoder& operator=(const Encoder&) = delete;
-        Encoder(size_t max_len, size_t input_size, vector<size_t> hidden_sizes) {
-            auto h2hraw = vector<SP_Filter<T>>();
-            for (auto hsize : hidden_sizes) {
-                h2hraw.push_back(make_shared<Linear<T>>(hsize, hsize));
-            }
-            auto x2hraw = vector<SP_Filter<T>>();
-            for (size_t i = 0; i < hidden_sizes.size(); i++) {
-                if (i == 0) {
-                    x2hraw.push_back(make_shared<Embedding<T>>(input_size, hidden_sizes[i]));
-                } else {
-                    x2hraw.push_back(make_shared<Linear<T>>(hidden_sizes[i-1], hidden_sizes[i]));
-                }
-            }
-            for (size_t i = 0; i < max_len; i++) {
-                for (size_t j = 0; j < hidden_sizes.size(); j++) {
-                    string hraw = bi_seq_generate_id("hraw", i, j);
-                    string left_h = bi_seq_generate_id("h", i-1, j);
-                    if (i > 0) {
-                        BaseNet<T>::add_link(left_h, hraw, h2hraw[j]->share());
-                    }
-                }
-                for (size_t j = 0; j < hidden_sizes.size(); j++) {
-                    string hraw = bi_seq_generate_id("hraw", i, j);
-                    string down_h;
+        Encoder(size_t max_len, size_t input_size, vector<size_t> hidden_sizes)
+                : Encoder(max_len, bi_seq_layers<T>(input_size, hidden_sizes)) {}
+        Encoder(size_t max_len, const vector<SP_Filter<T>> &layers)
+                : max_len(max_len)
+                , layers(layers) {
+            for (size_t j = 0; j < layers.size(); j++) {
+                auto ins = vector<string>();
+                auto outs = vector<string>();
+                for (size_t i = 0; i < max_len; i++) {
                     if (j == 0) {
-                        down_h = bi_seq_generate_id("x", i);
+                        ins.push_back(bi_seq_generate_id("x", i));
                     } else {
-                        down_h = bi_seq_generate_id("h", i, j-1);
+                        ins.push_back(bi_seq_generate_id("h", i, j-1));
                     }
-                    BaseNet<T>::add_link(down_h, hraw, x2hraw[j]->share());
-                    string h = bi_seq_generate_id("h", i, j);
-                    BaseNet<T>::add_link(hraw, h, make_shared<Tanh<T>>());
+                    outs.push_back(bi_seq_generate_id("h", i, j));
                 }
+                auto layer = dynamic_pointer_cast<RecurrentLayer<T>>(layers[j]->share());
+                linked_layers.push_back(layer);
+                this->add_link(ins, outs, layer);
             }
             auto x_ids = vector<string>();
             auto y_ids = vector<string>();
             for (size_t i = 0; i < max_len; i++) {
                 x_ids.push_back(bi_seq_generate_id("x", i));
             }
-            for (size_t j = 0; j < hidden_sizes.size(); j++) {
+            for (size_t j = 0; j < layers.size(); j++) {
                 y_ids.push_back(bi_seq_generate_id("h", max_len-1, j));
             }
             this->add_input_ids(x_ids);
@@ -69,6 +76,21 @@ namespace gs
             this->fix_net();
         }
 
+        SP_Filter<T> share() override {
+            return share(max_len);
+        }
+        // an encoder of another length with the same params
+        shared_ptr<Encoder<T>> share(size_t max_len) {
+            return make_shared<Encoder<T>>(max_len, layers);
+        }
+
+        // rows past their length keep their last states, so the last outputs are the states at the lengths
+        void set_lengths(const vector<size_t> &lengths) {
+            for (auto const& layer : linked_layers) {
+                layer->set_lengths(lengths);
+            }
+        }
+
         using OrderedNet<T>::forward;
         using OrderedNet<T>::backward;
     };
@@ -79,52 +101,49 @@ namespace gs
     private:
         size_t max_len;
         size_t num_hidden_layer;
+        // filters holding the params, links are shares of them
+        vector<SP_Filter<T>> layers;
+        SP_Filter<T> projection;
+        // shares linked at each step
+        vector<vector<shared_ptr<RecurrentLayer<T>>>> step_layers = {};
+        vector<shared_ptr<SeqCrossEntropy<T>>> step_projections = {};
 
         SP_Signal<T> initial_input_signal;
+        vector<size_t> step_lengths = {};
 
     public:
         Decoder(const Decoder& other) = delete;
         Decoder& operator=(const Decoder&) = delete;
         Decoder(size_t max_len, size_t input_size, vector<size_t> hidden_sizes)
+                : Decoder(max_len, bi_seq_layers<T>(input_size, hidden_sizes),
+                          make_shared<SeqCrossEntropy<T>>(hidden_sizes.back(), input_size)) {}
+        Decoder(size_t max_len, const vector<SP_Filter<T>> &layers, SP_Filter<T> projection)
                 : max_len(max_len)
-                , num_hidden_layer(hidden_sizes.size()) {
-            auto h2hraw = vector<SP_Filter<T>>();
-            for (auto hsize : hidden_sizes) {
-                h2hraw.push_back(make_shared<Linear<T>>(hsize, hsize));
-            }
-            auto x2hraw = vector<SP_Filter<T>>();
-            for (size_t i = 0; i < hidden_sizes.size(); i++) {
-                if (i == 0) {
-                    x2hraw.push_back(make_shared<Embedding<T>>(input_size, hidden_sizes[i]));
-                } else {
-                    x2hraw.push_back(make_shared<Linear<T>>(hidden_sizes[i-1], hidden_sizes[i]));
-                }
-            }
-            auto h2yraw = make_shared<Linear<T>>(hidden_sizes.back(), input_size);
-
+                , num_hidden_layer(layers.size())
+                , layers(layers)
+                , projection(projection) {
+            // inputs of a step are outputs of the previous step, so every step is a link of its own,
+            // and the state of step -1 comes from the encoder
             for (size_t i = 0; i < max_len; i++) {
-                for (size_t j = 0; j < hidden_sizes.size(); j++) {
-                    string hraw = bi_seq_generate_id("hraw", i, j);
+                step_layers.push_back(vector<shared_ptr<RecurrentLayer<T>>>());
+                for (size_t j = 0; j < num_hidden_layer; j++) {
                     string left_h = bi_seq_generate_id("h", i-1, j);
-                    BaseNet<T>::add_link(left_h, hraw, h2hraw[j]->share());
-                }
-                for (size_t j = 0; j < hidden_sizes.size(); j++) {
-                    string hraw = bi_seq_generate_id("hraw", i, j);
                     string down_h;
                     if (j == 0) {
                         down_h = bi_seq_generate_id("x", i);
                     } else {
                         down_h = bi_seq_generate_id("h", i, j-1);
                     }
-                    BaseNet<T>::add_link(down_h, hraw, x2hraw[j]->share());
                     string h = bi_seq_generate_id("h", i, j);
-                    BaseNet<T>::add_link(hraw, h, make_shared<Tanh<T>>());
+                    auto layer = dynamic_pointer_cast<RecurrentLayer<T>>(layers[j]->share());
+                    step_layers.back().push_back(layer);
+                    BaseNet<T>::add_link({down_h, left_h}, h, layer);
                 }
-                string yraw = bi_seq_generate_id("yraw", i);
-                string down_h = bi_seq_generate_id("h", i, hidden_sizes.size()-1);
-                BaseNet<T>::add_link(down_h, yraw, h2yraw->share());
+                string down_h = bi_seq_generate_id("h", i, num_hidden_layer-1);
                 string y = bi_seq_generate_id("y", i);
-                BaseNet<T>::add_link(yraw, y, make_shared<CrossEntropy<T>>());
+                auto step_projection = dynamic_pointer_cast<SeqCrossEntropy<T>>(projection->share());
+                step_projections.push_back(step_projection);
+                BaseNet<T>::add_link(down_h, y, step_projection);
             }
 
             auto x_ids = vector<string>();
@@ -133,7 +152,7 @@ namespace gs
                 x_ids.push_back(bi_seq_generate_id("x", i));
                 y_ids.push_back(bi_seq_generate_id("y", i));
             }
-            for (size_t i = 0; i < hidden_sizes.size(); i++) {
+            for (size_t i = 0; i < num_hidden_layer; i++) {
                 x_ids.push_back(bi_seq_generate_id("h", -1, i));
             }
             this->add_input_ids(x_ids);
@@ -145,11 +164,28 @@ namespace gs
         }
 
         SP_Filter<T> share() override {
-            throw "to be implemented";
+            return share(max_len);
+        }
+        // a decoder of another length with the same params
+        shared_ptr<Decoder<T>> share(size_t max_len) {
+            return make_shared<Decoder<T>>(max_len, layers, projection);
+        }
+
+        // a step of one link runs the rows whose length is past the step, and the others keep their states
+        void set_lengths(const vector<size_t> &lengths) {
+            for (size_t i = 0; i < max_len; i++) {
+                step_lengths.clear();
+                for (auto len : lengths) {
+                    step_lengths.push_back(len > i ? 1 : 0);
+                }
+                for (auto const& layer : step_layers[i]) {
+                    layer->set_lengths(step_lengths);
+                }
+                step_projections[i]->set_lengths(step_lengths);
+            }
         }
 
         void install_signals(const vector<SP_Signal<T>> &in_signals, const vector<SP_Signal<T>> &out_signals) override {
-            cout << "virtual function installing signals" << endl;
             auto new_in_signals = vector<SP_Signal<T>>();
             new_in_signals.push_back(initial_input_signal);
             new_in_signals.insert(new_in_signals.end(), out_signals.begin(), out_signals.end()-1);
@@ -181,11 +217,27 @@ namespace gs
             , input_size_one(_input_size_one)
             , input_size_another(_input_size_another)
             , hidden_sizes(_hidden_sizes) {
-        auto encoder_one = make_shared<Encoder<T>>(max_len_one, input_size_one, hidden_sizes);
-        auto decoder_one = make_shared<Decoder<T>>(max_len_one, input_size_one, hidden_sizes);
-        auto encoder_another = make_shared<Encoder<T>>(max_len_another, input_size_another, hidden_sizes);
-        auto decoder_another = make_shared<Decoder<T>>(max_len_another, input_size_another, hidden_sizes);
+        encoder_one = make_shared<Encoder<T>>(max_len_one, input_size_one, hidden_sizes);
+        decoder_one = make_shared<Decoder<T>>(max_len_one, input_size_one, hidden_sizes);
+        encoder_another = make_shared<Encoder<T>>(max_len_another, input_size_another, hidden_sizes);
+        decoder_another = make_shared<Decoder<T>>(max_len_another, input_size_another, hidden_sizes);
+
+        Bucket bucket{max_len_one, max_len_another, &this->net};
+        auto x_ids = vector<string>();
+        auto y_ids = vector<string>();
+        _link(this->net, bucket, x_ids, y_ids);
+        this->add_input_ids(x_ids);
+        this->add_output_ids(y_ids);
+
+        this->compile();
+
+        bucket.input_signals = this->input_signals;
+        bucket.output_signals = this->output_signals;
+        buckets.push_back(bucket);
+    }
 
+    template<typename T>
+    void BiSeqEncoderDecoder<T>::_link(OrderedNet<T> &net, Bucket &bucket, vector<string> &x_ids, vector<string> &y_ids) {
         auto x_ids_one = vector<string>();
         auto x_ids_another = vector<string>();
         auto h_ids_one = vector<string>();
@@ -194,36 +246,82 @@ namespace gs
         auto y_ids_one2another = vector<string>();
         auto y_ids_another2one = vector<string>();
         auto y_ids_another2another = vector<string>();
-        for (size_t i = 0; i < max_len_one; i++) {
+        for (size_t i = 0; i < bucket.len_one; i++) {
             x_ids_one.push_back(bi_seq_generate_id("x_one", i));
             y_ids_one2one.push_back(bi_seq_generate_id("y_one2one", i));
             y_ids_another2one.push_back(bi_seq_generate_id("y_another2one", i));
         }
         for (size_t j = 0; j < hidden_sizes.size(); j++) {
-            h_ids_one.push_back(bi_seq_generate_id("h_one", max_len_one-1, j));
-            h_ids_another.push_back(bi_seq_generate_id("h_another", max_len_another-1, j));
+            h_ids_one.push_back(bi_seq_generate_id("h_one", bucket.len_one-1, j));
+            h_ids_another.push_back(bi_seq_generate_id("h_another", bucket.len_another-1, j));
         }
-        for (size_t i = 0; i < max_len_another; i++) {
+        for (size_t i = 0; i < bucket.len_another; i++) {
             x_ids_another.push_back(bi_seq_generate_id("x_another", i));
             y_ids_one2another.push_back(bi_seq_generate_id("y_one2another", i));
             y_ids_another2another.push_back(bi_seq_generate_id("y_another2another", i));
         }
 
-        this->add_link(x_ids_one, h_ids_one, encoder_one);
-        this->add_link(h_ids_one, y_ids_one2one, decoder_one);
-        this->add_link(h_ids_one, y_ids_one2another, decoder_another);
-        this->add_link(x_ids_another, h_ids_another, encoder_another->share());
-        this->add_link(h_ids_another, y_ids_another2another, decoder_another->share());
-        this->add_link(h_ids_another, y_ids_another2one, decoder_one->share());
+        bucket.encoder_one = encoder_one->share(bucket.len_one);
+        bucket.encoder_another = encoder_another->share(bucket.len_another);
+        bucket.decoders_one.push_back(decoder_one->share(bucket.len_one));
+        bucket.decoders_one.push_back(decoder_one->share(bucket.len_one));
+        bucket.decoders_another.push_back(decoder_another->share(bucket.len_another));
+        bucket.decoders_another.push_back(decoder_another->share(bucket.len_another));
+        net.add_link(x_ids_one, h_ids_one, bucket.encoder_one);
+        net.add_link(h_ids_one, y_ids_one2one, bucket.decoders_one[0]);
+        net.add_link(h_ids_one, y_ids_one2another, bucket.decoders_another[0]);
+        net.add_link(x_ids_another, h_ids_another, bucket.encoder_another);
+        net.add_link(h_ids_another, y_ids_another2another, bucket.decoders_another[1]);
+        net.add_link(h_ids_another, y_ids_another2one, bucket.decoders_one[1]);
+
+        x_ids.insert(x_ids.end(), x_ids_one.begin(), x_ids_one.end());
+        x_ids.insert(x_ids.end(), x_ids_another.begin(), x_ids_another.end());
+        y_ids.insert(y_ids.end(), y_ids_one2one.begin(), y_ids_one2one.end());
+        y_ids.insert(y_ids.end(), y_ids_one2another.begin(), y_ids_one2another.end());
+        y_ids.insert(y_ids.end(), y_ids_another2one.begin(), y_ids_another2one.end());
+        y_ids.insert(y_ids.end(), y_ids_another2another.begin(), y_ids_another2another.end());
+    }
 
-        this->add_input_ids(x_ids_one);
-        this->add_input_ids(x_ids_another);
-        this->add_output_ids(y_ids_one2one);
-        this->add_output_ids(y_ids_one2another);
-        this->add_output_ids(y_ids_another2one);
-        this->add_output_ids(y_ids_another2another);
+    template<typename T>
+    void BiSeqEncoderDecoder<T>::add_bucket(size_t len_one, size_t len_another) {
+        CHECK(train_one == nullptr, "buckets should be added before the train dataset");
+        CHECK(len_one > 0 && len_one <= max_len_one && len_another > 0 && len_another <= max_len_another,
+              "a bucket should not be longer than the model");
+        for (auto const& other : buckets) {
+            CHECK(other.len_one != len_one || other.len_another != len_another, "the bucket exists");
+        }
+        // only the network of the model is set up by compile, a bucket trains on its own one
+        CHECK(!this->inference && !this->data_parallel && !this->hogwild && !this->prefetch,
+              "buckets only support a model trained on a single network");
+
+        Bucket bucket{len_one, len_another, nullptr, make_shared<OrderedNet<T>>()};
+        bucket.net = bucket.own_net.get();
+        auto x_ids = vector<string>();
+        auto y_ids = vector<string>();
+        _link(*bucket.net, bucket, x_ids, y_ids);
+        bucket.net->add_input_ids(x_ids);
+        bucket.net->add_output_ids(y_ids);
+        bucket.net->fix_net();
+        for (size_t i = 0; i < x_ids.size(); i++) {
+            bucket.input_signals.push_back(make_shared<Signal<T>>(InputSignal));
+        }
+        for (size_t i = 0; i < y_ids.size(); i++) {
+            bucket.output_signals.push_back(make_shared<Signal<T>>(OutputSignal));
+        }
+        bucket.net->install_signals(bucket.input_signals, bucket.output_signals);
+        bucket.net->set_dims(this->batch_size);
+        buckets.push_back(bucket);
+    }
 
-        this->compile();
+    // number of indexes before the padding of a sentence
+    template<typename T>
+    size_t BiSeqEncoderDecoder<T>::_length(const SP_NArray<T> &sentences, size_t idx) {
+        auto len = sentences->get_dims()[1];
+        auto ptr = sentences->get_data() + idx*len;
+        while (len > 0 && ptr[len-1] == 0) {
+            len--;
+        }
+        return len;
     }
 
     template<typename T>
@@ -238,33 +336,105 @@ namespace gs
         train_seq_count = one_dims[0];
         train_one = one;
         train_another = another;
+
+        // every pair goes to the shortest bucket it fits in, the first bucket fits all
+        train_len_one.resize(train_seq_count);
+        train_len_another.resize(train_seq_count);
+        train_len_one_decoded.resize(train_seq_count);
+        train_len_another_decoded.resize(train_seq_count);
+        for (size_t r = 0; r < train_seq_count; r++) {
+            auto l1 = _length(one, r);
+            auto l2 = _length(another, r);
+            train_len_one[r] = max<size_t>(1, l1);
+            train_len_another[r] = max<size_t>(1, l2);
+            train_len_one_decoded[r] = min(max_len_one, l1 + 1);
+            train_len_another_decoded[r] = min(max_len_another, l2 + 1);
+            size_t best = 0;
+            for (size_t k = 1; k < buckets.size(); k++) {
+                if (buckets[k].len_one >= train_len_one_decoded[r] && buckets[k].len_another >= train_len_another_decoded[r] &&
+                        buckets[k].len_one + buckets[k].len_another < buckets[best].len_one + buckets[best].len_another) {
+                    best = k;
+                }
+            }
+            buckets[best].ids.push_back(r);
+        }
     }
 
     template<typename T>
     T BiSeqEncoderDecoder<T>::train_one_batch(bool update) {
-        uniform_int_distribution<> distribution(0, train_seq_count-1);
-        vector<size_t> batch_ids(this->batch_size);
+        CHECK(train_one != nullptr, "the train dataset should be added");
+        // a bucket is drawn as likely as its share of pairs, then the batch from its pairs
+        uniform_int_distribution<size_t> distribution(0, train_seq_count-1);
+        size_t r = distribution(galois_rn_generator);
+        size_t k = 0;
+        while (r >= buckets[k].ids.size()) {
+            r -= buckets[k].ids.size();
+            k++;
+        }
+        auto &bucket = buckets[k];
+        uniform_int_distribution<size_t> bucket_distribution(0, bucket.ids.size()-1);
+        auto &batch_ids = this->batch_ids;
+        batch_ids.resize(this->batch_size);
+        for (size_t i = 0; i < this->batch_size; i++) {
+            batch_ids[i] = bucket.ids[bucket_distribution(galois_rn_generator)];
+        }
+        // rows by decreasing length of one, so that a step of its encoder only computes rows still inside
+        sort(batch_ids.begin(), batch_ids.end(), [this](size_t a, size_t b) {
+            return train_len_one[a] > train_len_one[b];
+        });
+        len_one.resize(this->batch_size);
+        len_another.resize(this->batch_size);
+        len_one_decoded.resize(this->batch_size);
+        len_another_decoded.resize(this->batch_size);
         for (size_t i = 0; i < this->batch_size; i++) {
-            batch_ids[i] = distribution(galois_rn_generator);
+            len_one[i] = train_len_one[batch_ids[i]];
+            len_another[i] = train_len_another[batch_ids[i]];
+            len_one_decoded[i] = train_len_one_decoded[batch_ids[i]];
+            len_another_decoded[i] = train_len_another_decoded[batch_ids[i]];
+        }
+        bucket.encoder_one->set_lengths(len_one);
+        bucket.encoder_another->set_lengths(len_another);
+        for (auto const& decoder : bucket.decoders_one) {
+            decoder->set_lengths(len_one_decoded);
+        }
+        for (auto const& decoder : bucket.decoders_another) {
+            decoder->set_lengths(len_another_decoded);
         }
 
-        this->net.reopaque();
+        bucket.net->reopaque();
 
-        for (size_t i = 0; i < max_len_one; i++) {
-            this->input_signals[i]->get_data()->copy_from(batch_ids, i, train_one);
+        size_t n1 = bucket.len_one;
+        size_t n2 = bucket.len_another;
+        auto &inputs = bucket.input_signals;
+        auto &outputs = bucket.output_signals;
+        for (size_t i = 0; i < n1; i++) {
+            inputs[i]->get_data()->copy_from(batch_ids, i, train_one);
+        }
+        for (size_t i = 0; i < n2; i++) {
+            inputs[n1+i]->get_data()->copy_from(batch_ids, i, train_another);
+        }
+        // outputs are one2one, one2another, another2one and another2another
+        for (size_t i = 0; i < n1; i++) {
+            outputs[i]->reopaque();
+            outputs[i]->get_target()->copy_from(batch_ids, i, train_one);
+            outputs[n1+n2+i]->reopaque();
+            outputs[n1+n2+i]->get_target()->copy_from(batch_ids, i, train_one);
         }
-        for (size_t i = max_len_one; i < max_len_one+max_len_another; i++) {
-            this->input_signals[i]->get_data()->copy_from(batch_ids, i, train_another);
+        for (size_t i = 0; i < n2; i++) {
+            outputs[n1+i]->reopaque();
+            outputs[n1+i]->get_target()->copy_from(batch_ids, i, train_another);
+            outputs[2*n1+n2+i]->reopaque();
+            outputs[2*n1+n2+i]->get_target()->copy_from(batch_ids, i, train_another);
         }
 
-        this->net.forward();
-        this->net.backward();
+        bucket.net->forward();
+        bucket.net->backward();
         if (update) {
             this->optimizer->update();
         }
 
         T loss = 0;
-        for (auto output_signal : this->output_signals) {
+        for (auto output_signal : outputs) {
             loss += *output_signal->get_loss();
         }
         return loss;
@@ -282,7 +452,7 @@ namespace gs
 
             int len = train_seq_count;
             for (int i = 0; i < len; i += this->batch_size) {
-                loss += train_one_batch(i);
+                loss += train_one_batch();
                 if (i % 10000 == 0) {
                     cout << " > " << i << endl;
                 }
@@ -0,0 +1,153 @@
+#include "galois/models/data_parallel.h"
+#include "galois/utils.h"
+
+#include <chrono>
+
+namespace gs
+{
+
+    template<typename T>
+    DataParallel<T>::DataParallel(GFilter<T> &master, const vector<SP_NArray<T>> &grads,
+                                  size_t num_inputs, size_t num_outputs, size_t batch_size, size_t num_replicas)
+            : grads(grads)
+            , replica_grads(grads.size())
+            , pool(num_replicas) {
+        CHECK(num_replicas > 0, "at least one replica is needed");
+        CHECK(batch_size % num_replicas == 0, "batch size %zu should be divisible by the number of replicas %zu",
+              batch_size, num_replicas);
+        auto slice_size = batch_size / num_replicas;
+
+        for (size_t r = 0; r < num_replicas; r++) {
+            auto replica = make_shared<Replica<T>>(master, num_inputs, num_outputs, slice_size);
+            auto &r_grads = replica->get_grads();
+            auto &m_grads = replica->get_master_grads();
+            for (size_t k = 0; k < r_grads.size(); k++) {
+                auto it = find(this->grads.begin(), this->grads.end(), m_grads[k]);
+                CHECK(it != this->grads.end(), "grads of the network should be updated by the optimizer");
+                replica_grads[it - this->grads.begin()].push_back(r_grads[k]);
+            }
+            replicas.push_back(replica);
+
+            vector<size_t> ids{};
+            for (size_t i = 0; i < slice_size; i++) {
+                ids.push_back(r*slice_size + i);
+            }
+            batch_ids.push_back(ids);
+        }
+
+        for (size_t i = 0; i < grads.size(); i++) {
+            CHECK(!replica_grads[i].empty(), "every grad should be computed by the replicas");
+        }
+    }
+
+    // average the grads of replicas into the master grads, over the part-th of every grad
+    // a row sparse grad is split by its marked rows, which are the union of those of replicas
+    template<typename T>
+    void DataParallel<T>::_reduce(size_t part) {
+        auto num_parts = replicas.size();
+        T scale = T(1) / T(replicas.size());
+        for (size_t i = 0; i < grads.size(); i++) {
+            auto dst = grads[i]->get_data();
+            auto sum = [&](size_t lo, size_t hi) {
+                // a grad left opaque got no contribution in its replica
+                bool first = true;
+                for (auto &grad : replica_grads[i]) {
+                    if (grad->opaque()) {
+                        continue;
+                    }
+                    auto src = grad->get_data();
+                    if (first) {
+                        for (size_t j = lo; j < hi; j++) {
+                            dst[j] = src[j];
+                        }
+                        first = false;
+                    } else {
+                        for (size_t j = lo; j < hi; j++) {
+                            dst[j] += src[j];
+                        }
+                    }
+                }
+                if (!first) {
+                    for (size_t j = lo; j < hi; j++) {
+                        dst[j] *= scale;
+                    }
+                }
+            };
+
+            if (grads[i]->is_row_sparse()) {
+                auto &rows = grads[i]->get_sparse_rows();
+                auto row_size = grads[i]->get_row_size();
+                for (size_t k = rows.size() * part / num_parts; k < rows.size() * (part+1) / num_parts; k++) {
+                    sum(rows[k] * row_size, (rows[k]+1) * row_size);
+                }
+            } else {
+                auto size = grads[i]->get_size();
+                sum(size * part / num_parts, size * (part+1) / num_parts);
+            }
+        }
+    }
+
+    template<typename T>
+    T DataParallel<T>::train_one_batch(const vector<SP_Signal<T>> &input_signals, const vector<SP_Signal<T>> &output_signals) {
+        auto start = chrono::steady_clock::now();
+        vector<T> losses(replicas.size(), 0);
+        for (size_t r = 0; r < replicas.size(); r++) {
+            pool.submit([this, r, &input_signals, &output_signals, &losses]() {
+                auto &replica = replicas[r];
+                replica->reopaque();
+                auto &replica_inputs = replica->get_input_signals();
+                auto &replica_outputs = replica->get_output_signals();
+                for (size_t i = 0; i < input_signals.size(); i++) {
+                    replica_inputs[i]->get_data()->copy_from(batch_ids[r], input_signals[i]->get_data());
+                }
+                for (size_t j = 0; j < output_signals.size(); j++) {
+                    replica_outputs[j]->get_target()->copy_from(batch_ids[r], output_signals[j]->get_target());
+                }
+                losses[r] = replica->propagate();
+            });
+        }
+        pool.wait_all();
+        auto propagated = chrono::steady_clock::now();
+
+        for (size_t i = 0; i < grads.size(); i++) {
+            if (grads[i]->is_row_sparse()) {
+                grads[i]->clear_sparse_rows();
+                for (auto &grad : replica_grads[i]) {
+                    if (!grad->opaque()) {
+                        for (auto row : grad->get_sparse_rows()) {
+                            grads[i]->mark_sparse_row(row);
+                        }
+                    }
+                }
+            }
+        }
+        for (size_t part = 0; part < replicas.size(); part++) {
+            pool.submit([this, part]() { _reduce(part); });
+        }
+        pool.wait_all();
+        for (size_t i = 0; i < grads.size(); i++) {
+            for (auto &grad : replica_grads[i]) {
+                if (!grad->opaque()) {
+                    grads[i]->setclear();
+                    break;
+                }
+            }
+        }
+        auto reduced = chrono::steady_clock::now();
+
+        chrono::duration<double> propagate_time = propagated - start;
+        chrono::duration<double> reduce_time = reduced - propagated;
+        propagate_seconds += propagate_time.count();
+        reduce_seconds += reduce_time.count();
+
+        T loss = 0;
+        for (auto l : losses) {
+            loss += l;
+        }
+        return loss / T(replicas.size());
+    }
+
+    template class DataParallel<float>;
+    template class DataParallel<double>;
+
+}
@@ -0,0 +1,92 @@
+#include "galois/models/hogwild.h"
+#include "galois/utils.h"
+
+#include <atomic>
+
+namespace gs
+{
+
+    template<typename T>
+    Hogwild<T>::Hogwild(GFilter<T> &master, size_t num_inputs, size_t num_outputs, size_t batch_size,
+                        size_t num_workers, string optimizer_name, T learning_rate, bool deterministic)
+            : batch_size(batch_size)
+            , deterministic(deterministic)
+            , pool(num_workers) {
+        CHECK(num_workers > 0, "at least one worker is needed");
+        for (size_t w = 0; w < num_workers; w++) {
+            auto replica = make_shared<Replica<T>>(master, num_inputs, num_outputs, batch_size);
+            auto optimizer = make_optimizer<T>(optimizer_name, learning_rate);
+            optimizer->compile(replica->get_params(), replica->get_grads());
+            replicas.push_back(replica);
+            optimizers.push_back(optimizer);
+            generators.push_back(default_random_engine(w));
+        }
+    }
+
+    template<typename T>
+    void Hogwild<T>::_load(size_t w, const vector<SP_NArray<T>> &data, const vector<SP_NArray<T>> &target) {
+        auto count = data[0]->get_dims()[0];
+        uniform_int_distribution<> distribution(0, count-1);
+        vector<size_t> batch_ids(batch_size);
+        for (size_t i = 0; i < batch_size; i++) {
+            batch_ids[i] = distribution(generators[w]);
+        }
+
+        auto &replica = replicas[w];
+        replica->reopaque();
+        auto &input_signals = replica->get_input_signals();
+        auto &output_signals = replica->get_output_signals();
+        CHECK(data.size() == input_signals.size() && target.size() == output_signals.size(),
+              "dataset should match the signals");
+        for (size_t i = 0; i < input_signals.size(); i++) {
+            input_signals[i]->get_data()->copy_from(batch_ids, data[i]);
+        }
+        for (size_t j = 0; j < output_signals.size(); j++) {
+            output_signals[j]->get_target()->copy_from(batch_ids, target[j]);
+        }
+    }
+
+    template<typename T>
+    T Hogwild<T>::train(const vector<SP_NArray<T>> &data, const vector<SP_NArray<T>> &target, size_t num_batches) {
+        auto num_workers = replicas.size();
+        vector<T> losses(num_workers, 0);
+
+        if (deterministic) {
+            for (size_t start = 0; start < num_batches; start += num_workers) {
+                auto num_active = min(num_workers, num_batches - start);
+                for (size_t w = 0; w < num_active; w++) {
+                    pool.submit([this, w, &data, &target, &losses]() {
+                        _load(w, data, target);
+                        losses[w] += replicas[w]->propagate();
+                    });
+                }
+                pool.wait_all();
+                for (size_t w = 0; w < num_active; w++) {
+                    optimizers[w]->update();
+                }
+            }
+        } else {
+            atomic<size_t> next(0);
+            for (size_t w = 0; w < num_workers; w++) {
+                pool.submit([this, w, num_batches, &next, &data, &target, &losses]() {
+                    while (next.fetch_add(1) < num_batches) {
+                        _load(w, data, target);
+                        losses[w] += replicas[w]->propagate();
+                        optimizers[w]->update();
+                    }
+                });
+            }
+            pool.wait_all();
+        }
+
+        T loss = 0;
+        for (auto l : losses) {
+            loss += l;
+        }
+        return loss / T(num_batches);
+    }
+
+    template class Hogwild<float>;
+    template class Hogwild<double>;
+
+}
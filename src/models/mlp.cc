@@ -14,12 +14,9 @@ namespace gs
                : path()
                , batch_size(batch_size)
                , num_epoch(num_epoch)
-               , learning_rate(learning_rate) {
-        if (optimizer_name == "sgd") {
-            optimizer = make_shared<SGD_Optimizer<T>>(learning_rate);
-        } else {
-            throw(optimizer_name + " is not implemented");
-        }
+               , learning_rate(learning_rate)
+            , optimizer_name(optimizer_name) {
+        optimizer = make_optimizer<T>(optimizer_name, learning_rate);
     }
 
     template<typename T>
@@ -28,7 +25,14 @@ namespace gs
     }
 
     template<typename T>
-    void MLPModel<T>::compile() {
+    void MLPModel<T>::compile(const bool inference) {
+        CHECK(!compiled, "the model should not be compiled before");
+        compiled = true;
+        if (inference) {
+            path.set_inference();
+        }
+        this->inference = inference;
+
         CHECK(pfilters.empty() && params.empty() && grads.empty(), "these should not be set before");
         for (auto pfilter : path.get_pfilters()) {
             if (!pfilter->is_params_fixed()) {
@@ -54,7 +58,20 @@ namespace gs
                 }
             }
         }
+        if (!params.empty()) {
+            param_buffer = flatten(params);
+            grad_buffer = flatten(grads);
+        }
         optimizer->compile(params, grads);
+        // replicas are cloned before signals are installed, which some filters require
+        if (!inference && num_replicas > 1) {
+            data_parallel.reset(new DataParallel<T>(path, grads, 1, 1, batch_size, num_replicas));
+        }
+        if (!inference && num_workers > 0) {
+            CHECK(num_replicas == 1, "replicas and hogwild workers could not be used together");
+            hogwild.reset(new Hogwild<T>(path, 1, 1, batch_size, num_workers,
+                                         optimizer_name, learning_rate, deterministic_workers));
+        }
 
         CHECK(input_signal == nullptr && output_signal == nullptr, "these signals should not be set before");
         input_signal = make_shared<Signal<T>>(InputSignal);
@@ -83,18 +100,57 @@ namespace gs
     }
 
     template<typename T>
-    T MLPModel<T>::train_one_batch(const bool update) {
-        uniform_int_distribution<int> distribution(0, train_count-1);
-        vector<size_t> batch_ids(batch_size);
-        for (size_t i = 0; i < batch_size; i++) {
-            batch_ids[i] = distribution(galois_rn_generator);
-        }
+    void MLPModel<T>::_start_prefetch() {
+        CHECK(train_data && train_target, "training dataset should have been set");
+        // ids are drawn from the generator of this model a batch ahead, in the same order as without prefetch
+        auto count = train_count;
+        auto size = batch_size;
+        prefetcher.reset(new BatchPrefetcher<T>(
+            {train_data, train_target},
+            {input_signal->get_data_dims(), output_signal->get_target_dims()},
+            [this, count, size](vector<size_t> &ids) {
+                uniform_int_distribution<int> distribution(0, count-1);
+                ids.resize(size);
+                for (size_t i = 0; i < size; i++) {
+                    ids[i] = distribution(galois_rn_generator);
+                }
+            }));
+    }
 
+    template<typename T>
+    T MLPModel<T>::train_one_batch(const bool update) {
+        CHECK(!inference, "a model compiled for inference could not be trained");
         path.reopaque();
         input_signal->reopaque();
-        input_signal->get_data()->copy_from(batch_ids, train_data);
         output_signal->reopaque();
-        output_signal->get_target()->copy_from(batch_ids, train_target);
+        if (prefetch) {
+            if (!prefetcher) {
+                _start_prefetch();
+            }
+            prefetcher->next([this](size_t k, SP_NArray<T> &batch) {
+                if (k == 0) {
+                    input_signal->swap_data(batch);
+                } else {
+                    output_signal->swap_target(batch);
+                }
+            });
+        } else {
+            uniform_int_distribution<int> distribution(0, train_count-1);
+            batch_ids.resize(batch_size);
+            for (size_t i = 0; i < batch_size; i++) {
+                batch_ids[i] = distribution(galois_rn_generator);
+            }
+            input_signal->get_data()->copy_from(batch_ids, train_data);
+            output_signal->get_target()->copy_from(batch_ids, train_target);
+        }
+
+        if (data_parallel) {
+            T loss = data_parallel->train_one_batch({input_signal}, {output_signal});
+            if (update) {
+                optimizer->update();
+            }
+            return loss;
+        }
 
         path.forward();
         path.backward();
@@ -117,21 +173,18 @@ namespace gs
     double MLPModel<T>::test() {
         double correctness = 0;
 
+        // batches are consecutive, so signals read slices of the datasets in place
         for (size_t i = 0; i + batch_size <= test_count; i += batch_size) {
-            vector<size_t> batch_ids(batch_size);
-            for (size_t j = 0; j < batch_size; j++) {
-                batch_ids[j] = i+j;
-            }
-
             path.reopaque();
-            input_signal->reopaque();
-            input_signal->get_data()->copy_from(batch_ids, test_data);
+            input_signal->bind_data(test_data->slice(i, i+batch_size));
             output_signal->reopaque();
-            output_signal->get_target()->copy_from(batch_ids, test_target);
+            output_signal->bind_target(test_target->slice(i, i+batch_size));
             path.forward();
 
             correctness += compute_correctness(output_signal);
         }
+        input_signal->unbind();
+        output_signal->unbind();
 
         int test_num = test_count / batch_size * batch_size;
         return double(correctness) / double(test_num);
@@ -139,7 +192,9 @@ namespace gs
 
     template<typename T>
     void MLPModel<T>::fit() {
-        compile();
+        if (!compiled) {
+            compile();
+        }
         CHECK(train_data != nullptr && train_target != nullptr, "training dataset should have been set");
         bool run_test = false;
         if (test_data != nullptr && test_target != nullptr) {
@@ -159,15 +214,27 @@ namespace gs
             auto start = chrono::system_clock::now();
 
             T loss = 0;
-            for (size_t i = 0; i < train_count/batch_size; i++) {
-                loss += train_one_batch();
+            if (hogwild) {
+                loss = hogwild->train({train_data}, {train_target}, train_count/batch_size);
+            } else {
+                for (size_t i = 0; i < train_count/batch_size; i++) {
+                    loss += train_one_batch();
+                }
+                loss /= T(train_count/batch_size);
             }
-            loss /= T(train_count/batch_size);
 
             auto end = chrono::system_clock::now();
             chrono::duration<double> eplased_time = end - start;
             printf(", time: %.2fs", eplased_time.count());
             printf(", loss: %.6f", loss);
+            if (prefetcher) {
+                printf(", data wait: %.2fs", prefetcher->get_wait_seconds());
+                prefetcher->reset_stats();
+            }
+            if (data_parallel) {
+                printf(", reduce: %.2fs", data_parallel->get_reduce_seconds());
+                data_parallel->reset_stats();
+            }
             if (run_test) {
                 double accuracy;
                 accuracy = test();
@@ -175,6 +242,8 @@ namespace gs
             }
             printf("\n");
         }
+        // the worker is a batch ahead, it stops with the training
+        prefetcher.reset();
     }
 
     template class MLPModel<float>;
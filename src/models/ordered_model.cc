@@ -12,12 +12,9 @@ namespace gs
             : net()
             , batch_size(batch_size)
             , num_epoch(num_epoch)
-            , learning_rate(learning_rate) {
-        if (optimizer_name == "sgd") {
-            optimizer = make_shared<SGD_Optimizer<T>>(learning_rate);
-        } else {
-            throw(optimizer_name + " is not implemented");
-        }
+            , learning_rate(learning_rate)
+            , optimizer_name(optimizer_name) {
+        optimizer = make_optimizer<T>(optimizer_name, learning_rate);
     }
 
     template<typename T>
@@ -84,8 +81,14 @@ namespace gs
     }
 
     template<typename T>
-    void OrderedModel<T>::compile() {
+    void OrderedModel<T>::compile(const bool inference) {
+        CHECK(!compiled, "the model should not be compiled before");
+        compiled = true;
         net.fix_net();
+        if (inference) {
+            net.set_inference();
+        }
+        this->inference = inference;
 
         CHECK(pfilters.empty() && params.empty() && grads.empty(), "these should not be set before");
         for (auto pfilter : net.get_pfilters()) {
@@ -112,7 +115,20 @@ namespace gs
                 }
             }
         }
+        if (!params.empty()) {
+            param_buffer = flatten(params);
+            grad_buffer = flatten(grads);
+        }
         optimizer->compile(params, grads);
+        // replicas are cloned before signals are installed, which some filters require
+        if (!inference && num_replicas > 1) {
+            data_parallel.reset(new DataParallel<T>(net, grads, input_signals.size(), output_signals.size(), batch_size, num_replicas));
+        }
+        if (!inference && num_workers > 0) {
+            CHECK(num_replicas == 1, "replicas and hogwild workers could not be used together");
+            hogwild.reset(new Hogwild<T>(net, input_signals.size(), output_signals.size(), batch_size, num_workers,
+                                         optimizer_name, learning_rate, deterministic_workers));
+        }
 
         CHECK(!input_ids.empty(), "input_ids should have been set");
         CHECK(!output_ids.empty(), "output_ids should have been set");
@@ -196,21 +212,71 @@ namespace gs
     }
 
     template<typename T>
-    T OrderedModel<T>::train_one_batch(const bool update) {
-        uniform_int_distribution<> distribution(0, train_count-1);
-        vector<size_t> batch_ids(batch_size);
-        for (size_t i = 0; i < batch_size; i++) {
-            batch_ids[i] = distribution(galois_rn_generator);
+    void OrderedModel<T>::_start_prefetch() {
+        CHECK(!train_data.empty() && !train_target.empty(), "training dataset should have been set");
+        vector<SP_NArray<T>> sources{};
+        vector<Shape> dims{};
+        for (size_t i = 0; i < input_signals.size(); i++) {
+            sources.push_back(train_data[i]);
+            dims.push_back(input_signals[i]->get_data_dims());
+        }
+        for (size_t i = 0; i < output_signals.size(); i++) {
+            sources.push_back(train_target[i]);
+            dims.push_back(output_signals[i]->get_target_dims());
         }
+        // ids are drawn from the generator of this model a batch ahead, in the same order as without prefetch
+        auto count = train_count;
+        auto size = batch_size;
+        prefetcher.reset(new BatchPrefetcher<T>(sources, dims, [this, count, size](vector<size_t> &ids) {
+            uniform_int_distribution<> distribution(0, count-1);
+            ids.resize(size);
+            for (size_t i = 0; i < size; i++) {
+                ids[i] = distribution(galois_rn_generator);
+            }
+        }));
+    }
 
+    template<typename T>
+    T OrderedModel<T>::train_one_batch(const bool update) {
+        CHECK(!inference, "a model compiled for inference could not be trained");
         net.reopaque();
-        for (size_t i = 0; i < input_signals.size(); i++) {
-            input_signals[i]->reopaque();
-            input_signals[i]->get_data()->copy_from(batch_ids, train_data[i]);
+        for (auto input_signal : input_signals) {
+            input_signal->reopaque();
         }
-        for (size_t i = 0; i < output_signals.size(); i++) {
-            output_signals[i]->reopaque();
-            output_signals[i]->get_target()->copy_from(batch_ids, train_target[i]);
+        for (auto output_signal : output_signals) {
+            output_signal->reopaque();
+        }
+        if (prefetch) {
+            if (!prefetcher) {
+                _start_prefetch();
+            }
+            prefetcher->next([this](size_t k, SP_NArray<T> &batch) {
+                if (k < input_signals.size()) {
+                    input_signals[k]->swap_data(batch);
+                } else {
+                    output_signals[k - input_signals.size()]->swap_target(batch);
+                }
+            });
+        } else {
+            uniform_int_distribution<> distribution(0, train_count-1);
+            batch_ids.resize(batch_size);
+            for (size_t i = 0; i < batch_size; i++) {
+                batch_ids[i] = distribution(galois_rn_generator);
+            }
+            for (size_t i = 0; i < input_signals.size(); i++) {
+                input_signals[i]->get_data()->copy_from(batch_ids, train_data[i]);
+            }
+            for (size_t i = 0; i < output_signals.size(); i++) {
+                output_signals[i]->get_target()->copy_from(batch_ids, train_target[i]);
+            }
+        }
+
+        if (data_parallel) {
+            T loss = data_parallel->train_one_batch(input_signals, output_signals);
+            if (update) {
+                optimizer->update();
+            }
+            return loss;
         }
 
         net.forward();
@@ -235,20 +301,15 @@ namespace gs
     double OrderedModel<T>::test() {
         double correctness = 0;
 
-        for (size_t i = 0; i < test_count; i += batch_size) {
-            vector<size_t> batch_ids(batch_size);
-            for (size_t j = 0; j < batch_size; j++) {
-                batch_ids[j] = i+j;
-            }
-
+        // batches are consecutive, so signals read slices of the datasets in place
+        for (size_t start_idx = 0; start_idx < test_count; start_idx += batch_size) {
             net.reopaque();
             for (size_t i = 0; i < input_signals.size(); i++) {
-                input_signals[i]->reopaque();
-                input_signals[i]->get_data()->copy_from(batch_ids, test_data[i]);
+                input_signals[i]->bind_data(test_data[i]->slice(start_idx, start_idx+batch_size));
             }
             for (size_t i = 0; i < output_signals.size(); i++) {
                 output_signals[i]->reopaque();
-                output_signals[i]->get_target()->copy_from(batch_ids, test_target[i]);
+                output_signals[i]->bind_target(test_target[i]->slice(start_idx, start_idx+batch_size));
             }
             net.forward();
 
@@ -256,6 +317,12 @@ namespace gs
                 correctness += compute_correctness(output_signals[i]);
             }
         }
+        for (auto signal : input_signals) {
+            signal->unbind();
+        }
+        for (auto signal : output_signals) {
+            signal->unbind();
+        }
 
         int test_num = test_count / batch_size * batch_size;
         return double(correctness) / double(test_num);
@@ -263,7 +330,9 @@ namespace gs
 
     template<typename T>
     void OrderedModel<T>::fit() {
-        compile();
+        if (!compiled) {
+            compile();
+        }
         CHECK(!train_data.empty() && !train_target.empty(), "training dataset should have been set");
         bool run_test = false;
         if (!test_data.empty() && !test_target.empty()) {
@@ -283,15 +352,27 @@ namespace gs
             auto start = chrono::system_clock::now();
 
             T loss = 0;
-            for (size_t i = 0; i < train_count/batch_size; i++) {
-                loss += train_one_batch();
+            if (hogwild) {
+                loss = hogwild->train(train_data, train_target, train_count/batch_size);
+            } else {
+                for (size_t i = 0; i < train_count/batch_size; i++) {
+                    loss += train_one_batch();
+                }
+                loss /= T(train_count/batch_size);
             }
-            loss /= T(train_count/batch_size);
 
             auto end = chrono::system_clock::now();
             chrono::duration<double> eplased_time = end - start;
             printf(", time: %.2fs", eplased_time.count());
             printf(", loss: %.6f", loss);
+            if (prefetcher) {
+                printf(", data wait: %.2fs", prefetcher->get_wait_seconds());
+                prefetcher->reset_stats();
+            }
+            if (data_parallel) {
+                printf(", reduce: %.2fs", data_parallel->get_reduce_seconds());
+                data_parallel->reset_stats();
+            }
             if (run_test) {
                 double accuracy;
                 accuracy = test();
@@ -299,6 +380,8 @@ namespace gs
             }
             printf("\n");
         }
+        // the worker is a batch ahead, it stops with the training
+        prefetcher.reset();
     }
 
     template class OrderedModel<float>;
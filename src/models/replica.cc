@@ -0,0 +1,93 @@
+#include "galois/models/replica.h"
+#include "galois/utils.h"
+
+namespace gs
+{
+
+    template<typename T>
+    Replica<T>::Replica(GFilter<T> &master, size_t num_inputs, size_t num_outputs, size_t batch_size) {
+        filter = master.clone();
+        auto g = dynamic_pointer_cast<GFilter<T>>(filter);
+        CHECK(g, "a clone of a GFilter should be a GFilter");
+        auto master_filters = master.get_filters();
+        auto replica_filters = g->get_filters();
+        CHECK(master_filters.size() == replica_filters.size(), "the clone should have the same filters");
+        for (size_t k = 0; k < master_filters.size(); k++) {
+            _pair(master_filters[k], replica_filters[k]);
+        }
+
+        for (size_t i = 0; i < num_inputs; i++) {
+            input_signals.push_back(make_shared<Signal<T>>(InputSignal));
+        }
+        for (size_t j = 0; j < num_outputs; j++) {
+            output_signals.push_back(make_shared<Signal<T>>(OutputSignal));
+        }
+        filter->install_signals(input_signals, output_signals);
+        filter->set_dims(batch_size);
+    }
+
+    // walk a filter and its clone together, let params of the clone use the memory of the
+    // params of the filter, and record which grad of the filter each grad of the clone matches
+    template<typename T>
+    void Replica<T>::_pair(SP_Filter<T> master, SP_Filter<T> replica) {
+        if (auto g = dynamic_pointer_cast<GFilter<T>>(master)) {
+            auto master_filters = g->get_filters();
+            auto replica_filters = dynamic_pointer_cast<GFilter<T>>(replica)->get_filters();
+            CHECK(master_filters.size() == replica_filters.size(), "the clone should have the same filters");
+            for (size_t k = 0; k < master_filters.size(); k++) {
+                _pair(master_filters[k], replica_filters[k]);
+            }
+            return;
+        }
+        auto p = dynamic_pointer_cast<PFilter<T>>(master);
+        if (!p) {
+            return;
+        }
+        auto q = dynamic_pointer_cast<PFilter<T>>(replica);
+        auto master_params = p->get_params();
+        auto replica_params = q->get_params();
+        CHECK(master_params.size() == replica_params.size(), "the clone should have the same params");
+        for (size_t k = 0; k < master_params.size(); k++) {
+            CHECK(master_params[k]->get_dims() == replica_params[k]->get_dims(), "the clone should have the same params");
+            replica_params[k]->set_external_data(master_params[k]->get_data(), master_params[k]);
+        }
+
+        if (p->is_params_fixed()) {
+            q->fix_params();
+            return;
+        }
+        auto p_grads = p->get_grads();
+        auto q_grads = q->get_grads();
+        for (size_t k = 0; k < replica_params.size(); k++) {
+            params.push_back(replica_params[k]);
+            grads.push_back(q_grads[k]);
+            master_grads.push_back(p_grads[k]);
+        }
+    }
+
+    template<typename T>
+    void Replica<T>::reopaque() {
+        filter->reopaque();
+        for (auto &signal : input_signals) {
+            signal->reopaque();
+        }
+        for (auto &signal : output_signals) {
+            signal->reopaque();
+        }
+    }
+
+    template<typename T>
+    T Replica<T>::propagate() {
+        filter->forward();
+        filter->backward();
+        T loss = 0;
+        for (auto &signal : output_signals) {
+            loss += *signal->get_loss();
+        }
+        return loss;
+    }
+
+    template class Replica<float>;
+    template class Replica<double>;
+
+}
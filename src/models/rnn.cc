@@ -24,64 +24,74 @@ namespace gs
                 int _num_epoch,
                 T _learning_rate,
                 string _optimizer_name,
-                bool _use_embedding)
+                bool _use_embedding,
+                bool _stateful)
             : Model<T>(_batch_size, _num_epoch, _learning_rate, _optimizer_name)
             , max_len(_max_len)
             , input_size(_input_size)
             , output_size(_output_size)
             , hidden_sizes(_hidden_sizes)
-            , use_embedding(_use_embedding) {
-        auto h2hraw = vector<SP_Filter<T>>();
-        for (auto hsize : hidden_sizes) {
-            h2hraw.push_back(make_shared<Linear<T>>(hsize, hsize));
-        }
-        auto x2hraw = vector<SP_Filter<T>>();
-        for (size_t i = 0; i < hidden_sizes.size(); i++) {
-            if (i == 0) {
-                if (use_embedding) {
-                    x2hraw.push_back(make_shared<Embedding<T>>(input_size, hidden_sizes[i]));
-                } else {
-                    x2hraw.push_back(make_shared<Linear<T>>(input_size, hidden_sizes[i]));
-                }
-            } else {
-                x2hraw.push_back(make_shared<Linear<T>>(hidden_sizes[i-1], hidden_sizes[i]));
-            }
-        }
-        auto h2yraw = make_shared<Linear<T>>(hidden_sizes.back(), output_size);
-        for (size_t i = 0; i < max_len; i++) {
-            for (size_t j = 0; j < hidden_sizes.size(); j++) {
-                string hraw = generate_id("hraw", i, j);
-                string left_h = generate_id("h", i-1, j);
-                string down_h;
+            , use_embedding(_use_embedding)
+            , stateful(_stateful) {
+        // each layer runs over the whole sequence in one filter
+        for (size_t j = 0; j < hidden_sizes.size(); j++) {
+            auto ins = vector<string>();
+            auto outs = vector<string>();
+            for (size_t i = 0; i < max_len; i++) {
                 if (j == 0) {
-                    down_h = generate_id("x", i);
+                    ins.push_back(generate_id("x", i));
                 } else {
-                    down_h = generate_id("h", i, j-1);
-                }
-                if (i > 0) {
-                    this->add_link(left_h, hraw, h2hraw[j]->share());
+                    ins.push_back(generate_id("h", i, j-1));
                 }
-                this->add_link(down_h, hraw, x2hraw[j]->share());
-                string h = generate_id("h", i, j);
-                this->add_link(hraw, h, make_shared<Tanh<T>>());
+                outs.push_back(generate_id("h", i, j));
+            }
+            if (stateful) {
+                ins.push_back(generate_id("h", -1, j));
+            }
+            if (j == 0) {
+                this->add_link(ins, outs, make_shared<RecurrentLayer<T>>(input_size, hidden_sizes[j], use_embedding));
+            } else {
+                this->add_link(ins, outs, make_shared<RecurrentLayer<T>>(hidden_sizes[j-1], hidden_sizes[j]));
             }
-            string yraw = generate_id("yraw", i);
-            string down_h = generate_id("h", i, hidden_sizes.size()-1);
-            this->add_link(down_h, yraw, h2yraw->share());
-            string y = generate_id("y", i);
-            this->add_link(yraw, y, make_shared<CrossEntropy<T>>());
         }
-
+        // the output projection and the loss of all steps in one filter
+        auto down_h_ids = vector<string>();
         auto x_ids = vector<string>();
         auto y_ids = vector<string>();
         for (size_t i = 0; i < max_len; i++) {
+            down_h_ids.push_back(generate_id("h", i, hidden_sizes.size()-1));
             x_ids.push_back(generate_id("x", i));
             y_ids.push_back(generate_id("y", i));
         }
+        projection = make_shared<SeqCrossEntropy<T>>(hidden_sizes.back(), output_size);
+        this->add_link(down_h_ids, y_ids, projection);
+        if (stateful) {
+            // states come after inputs of every step
+            for (size_t j = 0; j < hidden_sizes.size(); j++) {
+                x_ids.push_back(generate_id("h", -1, j));
+            }
+        }
         this->add_input_ids(x_ids);
         this->add_output_ids(y_ids);
 
         this->compile();
+
+        if (stateful) {
+            for (size_t j = 0; j < hidden_sizes.size(); j++) {
+                state_signals.push_back(this->input_signals[max_len+j]);
+                last_hidden_signals.push_back(this->net.get_inner_signal(generate_id("h", max_len-1, j)));
+                carried_states.push_back(make_shared<NArray<T>>(this->batch_size, hidden_sizes[j]));
+            }
+            reset_state();
+        }
+    }
+
+    template<typename T>
+    void RNN<T>::reset_state() {
+        CHECK(stateful, "only a stateful rnn has states");
+        for (auto state_signal : state_signals) {
+            state_signal->get_data()->fill(0);
+        }
     }
 
     template<typename T>
@@ -94,6 +104,10 @@ namespace gs
         train_seq_len = data_dims[0];
         train_X = data;
         train_Y = target;
+        if (stateful) {
+            stream_len = train_seq_len / this->batch_size;
+            CHECK(stream_len >= max_len, "every stream should be at least as long as the rnn");
+        }
     }
 
     template<typename T>
@@ -112,20 +126,62 @@ namespace gs
     template<typename T>
     T RNN<T>::train_one_batch(const int start_from, bool update) {
         this->net.reopaque();
-        for (size_t i = 0; i < this->input_signals.size(); i++) {
-            this->input_signals[i]->reopaque();
-            this->input_signals[i]->get_data()->copy_from(start_from+i, this->batch_size, train_X);
-        }
-        for (size_t i = 0; i < this->output_signals.size(); i++) {
-            this->output_signals[i]->reopaque();
-            this->output_signals[i]->get_target()->copy_from(start_from+i, this->batch_size, train_Y);
+        if (stateful) {
+            CHECK(start_from >= 0 && start_from+max_len <= stream_len, "window should be inside of streams");
+            auto &idxs = this->batch_ids;
+            idxs.resize(this->batch_size);
+            for (size_t i = 0; i < max_len; i++) {
+                for (size_t b = 0; b < this->batch_size; b++) {
+                    idxs[b] = b*stream_len + start_from + i;
+                }
+                this->input_signals[i]->reopaque();
+                this->input_signals[i]->get_data()->copy_from(idxs, train_X);
+                this->output_signals[i]->reopaque();
+                this->output_signals[i]->get_target()->copy_from(idxs, train_Y);
+            }
+        } else {
+            // the window of step i is rows [start_from+i, start_from+i+batch_size), read in place
+            if (window_X.empty()) {
+                for (size_t i = 0; i < this->input_signals.size(); i++) {
+                    window_X.push_back(train_X->slice(start_from+i, start_from+i+this->batch_size));
+                }
+                for (size_t i = 0; i < this->output_signals.size(); i++) {
+                    window_Y.push_back(train_Y->slice(start_from+i, start_from+i+this->batch_size));
+                }
+            } else {
+                for (auto &view : window_X) {
+                    view->slide(start_from - window_start);
+                }
+                for (auto &view : window_Y) {
+                    view->slide(start_from - window_start);
+                }
+            }
+            window_start = start_from;
+            for (size_t i = 0; i < this->input_signals.size(); i++) {
+                this->input_signals[i]->bind_data(window_X[i]);
+            }
+            for (size_t i = 0; i < this->output_signals.size(); i++) {
+                this->output_signals[i]->reopaque();
+                this->output_signals[i]->bind_target(window_Y[i]);
+            }
         }
 
         this->net.forward();
+        if (stateful) {
+            // states are still read by backward, and a memory plan may reuse hidden signals during backward
+            for (size_t j = 0; j < hidden_sizes.size(); j++) {
+                carried_states[j]->copy_from(last_hidden_signals[j]->get_data());
+            }
+        }
         this->net.backward();
         if (update) {
             this->optimizer->update();
         }
+        if (stateful) {
+            for (size_t j = 0; j < hidden_sizes.size(); j++) {
+                state_signals[j]->get_data()->copy_from(carried_states[j]);
+            }
+        }
 
         T loss = 0;
         for (auto output_signal : this->output_signals) {
@@ -144,14 +200,24 @@ namespace gs
             auto start = chrono::system_clock::now();
             T loss = 0;
 
-            int len = train_seq_len - max_len + 1 - this->batch_size + 1;
-            for (int i = 0; i < len; i += this->batch_size) {
-                loss += train_one_batch(i);
-                if (i % 10000 == 0) {
-                    cout << " > " << i << endl;
+            if (stateful) {
+                reset_state();
+                int num_windows = stream_len / max_len;
+                for (int i = 0; i < num_windows; i++) {
+                    loss += train_one_batch(i*max_len);
+                }
+                // per row of a window, as the loss of stateless training below
+                loss /= T(num_windows * this->batch_size);
+            } else {
+                int len = train_seq_len - max_len + 1 - this->batch_size + 1;
+                for (int i = 0; i < len; i += this->batch_size) {
+                    loss += train_one_batch(i);
+                    if (i % 10000 == 0) {
+                        cout << " > " << i << endl;
+                    }
                 }
+                loss /= T(len);
             }
-            loss /= T(len);
 
             auto end = chrono::system_clock::now();
             chrono::duration<double> eplased_time = end - start;
@@ -3,6 +3,7 @@
 #include "galois/filters.h"
 
 #include <chrono>
+#include <algorithm>
 
 namespace gs
 {
@@ -32,96 +33,127 @@ namespace gs
             , input_size(_input_size)
             , output_size(_output_size)
             , hidden_sizes(_hidden_sizes) {
-        auto h2hraw_encoder = vector<SP_Filter<T>>();
-        for (auto hsize : hidden_sizes) {
-            h2hraw_encoder.push_back(make_shared<Linear<T>>(hsize, hsize));
-        }
-        auto h2hraw_decoder = vector<SP_Filter<T>>();
-        for (auto hsize : hidden_sizes) {
-            h2hraw_decoder.push_back(make_shared<Linear<T>>(hsize, hsize));
-        }
-        auto x2hraw_encoder = vector<SP_Filter<T>>();
-        for (size_t i = 0; i < hidden_sizes.size(); i++) {
-            if (i == 0) {
-                    x2hraw_encoder.push_back(make_shared<Embedding<T>>(input_size, hidden_sizes[i]));
+        // both read indexes at the first layer, and the decoder starts from the last states of the encoder
+        for (size_t j = 0; j < hidden_sizes.size(); j++) {
+            if (j == 0) {
+                encoder_layers.push_back(make_shared<RecurrentLayer<T>>(input_size, hidden_sizes[j], true));
             } else {
-                x2hraw_encoder.push_back(make_shared<Linear<T>>(hidden_sizes[i-1], hidden_sizes[i]));
+                encoder_layers.push_back(make_shared<RecurrentLayer<T>>(hidden_sizes[j-1], hidden_sizes[j]));
             }
         }
-        auto x2hraw_decoder = vector<SP_Filter<T>>();
-        for (size_t i = 0; i < hidden_sizes.size(); i++) {
-            if (i == 0) {
-                    x2hraw_decoder.push_back(make_shared<Embedding<T>>(output_size, hidden_sizes[i]));
+        for (size_t j = 0; j < hidden_sizes.size(); j++) {
+            if (j == 0) {
+                decoder_layers.push_back(make_shared<RecurrentLayer<T>>(output_size, hidden_sizes[j], true));
             } else {
-                x2hraw_decoder.push_back(make_shared<Linear<T>>(hidden_sizes[i-1], hidden_sizes[i]));
+                decoder_layers.push_back(make_shared<RecurrentLayer<T>>(hidden_sizes[j-1], hidden_sizes[j]));
             }
         }
-        auto h2yraw_decoder = make_shared<Linear<T>>(hidden_sizes.back(), output_size);
+        projection = make_shared<SeqCrossEntropy<T>>(hidden_sizes.back(), output_size);
 
-        for (size_t i = 0; i < max_len_encoder; i++) {
-            for (size_t j = 0; j < hidden_sizes.size(); j++) {
-                string hraw = seq_generate_id("hraw_encoder", i, j);
-                string left_h = seq_generate_id("h_encoder", i-1, j);
-                if (i > 0) {
-                    this->add_link(left_h, hraw, h2hraw_encoder[j]->share());
-                }
-            }
-            for (size_t j = 0; j < hidden_sizes.size(); j++) {
-                string hraw = seq_generate_id("hraw_encoder", i, j);
-                string down_h;
+        Bucket bucket{max_len_encoder, max_len_decoder, &this->net};
+        auto x_ids = vector<string>();
+        auto y_ids = vector<string>();
+        _link(this->net, bucket, x_ids, y_ids);
+        this->add_input_ids(x_ids);
+        this->add_output_ids(y_ids);
+
+        this->compile();
+
+        bucket.input_signals = this->input_signals;
+        bucket.output_signals = this->output_signals;
+        buckets.push_back(bucket);
+    }
+
+    template<typename T>
+    void SeqEncoderDecoder<T>::_link(OrderedNet<T> &net, Bucket &bucket, vector<string> &x_ids, vector<string> &y_ids) {
+        auto num_layers = hidden_sizes.size();
+        // each layer runs over the whole sentence in one filter
+        for (size_t j = 0; j < num_layers; j++) {
+            auto ins = vector<string>();
+            auto outs = vector<string>();
+            for (size_t i = 0; i < bucket.len_encoder; i++) {
                 if (j == 0) {
-                    down_h = seq_generate_id("x_encoder", i);
+                    ins.push_back(seq_generate_id("x_encoder", i));
                 } else {
-                    down_h = seq_generate_id("h_encoder", i, j-1);
+                    ins.push_back(seq_generate_id("h_encoder", i, j-1));
                 }
-                this->add_link(down_h, hraw, x2hraw_encoder[j]->share());
-                string h = seq_generate_id("h_encoder", i, j);
-                this->add_link(hraw, h, make_shared<Tanh<T>>());
+                outs.push_back(seq_generate_id("h_encoder", i, j));
             }
+            auto layer = dynamic_pointer_cast<RecurrentLayer<T>>(encoder_layers[j]->share());
+            bucket.encoder_layers.push_back(layer);
+            net.add_link(ins, outs, layer);
         }
-        for (size_t i = 0; i < max_len_decoder; i++) {
-            for (size_t j = 0; j < hidden_sizes.size(); j++) {
-                string hraw = seq_generate_id("hraw_decoder", i, j);
-                string left_h;
-                if (i == 0) {
-                    left_h = seq_generate_id("h_encoder", max_len_encoder-1, j);
-                } else {
-                    left_h = seq_generate_id("h_decoder", i-1, j);
-                }
-                this->add_link(left_h, hraw, h2hraw_decoder[j]->share());
-            }
-            for (size_t j = 0; j < hidden_sizes.size(); j++) {
-                string hraw = seq_generate_id("hraw_decoder", i, j);
-                string down_h;
+        for (size_t j = 0; j < num_layers; j++) {
+            auto ins = vector<string>();
+            auto outs = vector<string>();
+            for (size_t i = 0; i < bucket.len_decoder; i++) {
                 if (j == 0) {
-                    down_h = seq_generate_id("x_decoder", i);
+                    ins.push_back(seq_generate_id("x_decoder", i));
                 } else {
-                    down_h = seq_generate_id("h_decoder", i, j-1);
+                    ins.push_back(seq_generate_id("h_decoder", i, j-1));
                 }
-                this->add_link(down_h, hraw, x2hraw_decoder[j]->share());
-                string h = seq_generate_id("h_decoder", i, j);
-                this->add_link(hraw, h, make_shared<Tanh<T>>());
+                outs.push_back(seq_generate_id("h_decoder", i, j));
             }
-            string yraw = seq_generate_id("yraw_decoder", i);
-            string down_h = seq_generate_id("h_decoder", i, hidden_sizes.size()-1);
-            this->add_link(down_h, yraw, h2yraw_decoder->share());
-            string y = seq_generate_id("y_decoder", i);
-            this->add_link(yraw, y, make_shared<CrossEntropy<T>>());
+            ins.push_back(seq_generate_id("h_encoder", bucket.len_encoder-1, j));
+            auto layer = dynamic_pointer_cast<RecurrentLayer<T>>(decoder_layers[j]->share());
+            bucket.decoder_layers.push_back(layer);
+            net.add_link(ins, outs, layer);
         }
 
-        auto x_ids = vector<string>();
-        auto y_ids = vector<string>();
-        for (size_t i = 0; i < max_len_encoder; i++) {
+        auto down_h_ids = vector<string>();
+        for (size_t i = 0; i < bucket.len_encoder; i++) {
             x_ids.push_back(seq_generate_id("x_encoder", i));
         }
-        for (size_t i = 0; i < max_len_decoder; i++) {
+        for (size_t i = 0; i < bucket.len_decoder; i++) {
+            down_h_ids.push_back(seq_generate_id("h_decoder", i, num_layers-1));
             x_ids.push_back(seq_generate_id("x_decoder", i));
             y_ids.push_back(seq_generate_id("y_decoder", i));
         }
-        this->add_input_ids(x_ids);
-        this->add_output_ids(y_ids);
+        // inputs of the decoder are given, so the output projection and the loss of all steps are done at once
+        bucket.projection = dynamic_pointer_cast<SeqCrossEntropy<T>>(projection->share());
+        net.add_link(down_h_ids, y_ids, bucket.projection);
+    }
 
-        this->compile();
+    template<typename T>
+    void SeqEncoderDecoder<T>::add_bucket(size_t len_encoder, size_t len_decoder) {
+        CHECK(train_X == nullptr, "buckets should be added before the train dataset");
+        CHECK(len_encoder > 0 && len_encoder <= max_len_encoder && len_decoder > 0 && len_decoder <= max_len_decoder,
+              "a bucket should not be longer than the model");
+        for (auto const& other : buckets) {
+            CHECK(other.len_encoder != len_encoder || other.len_decoder != len_decoder, "the bucket exists");
+        }
+        // only the network of the model is set up by compile, a bucket trains on its own one
+        CHECK(!this->inference && !this->data_parallel && !this->hogwild && !this->prefetch,
+              "buckets only support a model trained on a single network");
+
+        Bucket bucket{len_encoder, len_decoder, nullptr, make_shared<OrderedNet<T>>()};
+        bucket.net = bucket.own_net.get();
+        auto x_ids = vector<string>();
+        auto y_ids = vector<string>();
+        _link(*bucket.net, bucket, x_ids, y_ids);
+        bucket.net->add_input_ids(x_ids);
+        bucket.net->add_output_ids(y_ids);
+        bucket.net->fix_net();
+        for (size_t i = 0; i < x_ids.size(); i++) {
+            bucket.input_signals.push_back(make_shared<Signal<T>>(InputSignal));
+        }
+        for (size_t i = 0; i < y_ids.size(); i++) {
+            bucket.output_signals.push_back(make_shared<Signal<T>>(OutputSignal));
+        }
+        bucket.net->install_signals(bucket.input_signals, bucket.output_signals);
+        bucket.net->set_dims(this->batch_size);
+        buckets.push_back(bucket);
+    }
+
+    // number of indexes before the padding of a sentence
+    template<typename T>
+    size_t SeqEncoderDecoder<T>::_length(const SP_NArray<T> &sentences, size_t idx) {
+        auto len = sentences->get_dims()[1];
+        auto ptr = sentences->get_data() + idx*len;
+        while (len > 0 && ptr[len-1] == 0) {
+            len--;
+        }
+        return len;
     }
 
     template<typename T>
@@ -136,6 +168,24 @@ namespace gs
         train_seq_count = data_dims[0];
         train_X = data;
         train_Y = target;
+
+        // every sentence goes to the shortest bucket it fits in, the first bucket fits all
+        train_len_encoder.resize(train_seq_count);
+        train_len_decoder.resize(train_seq_count);
+        for (size_t r = 0; r < train_seq_count; r++) {
+            auto le = max<size_t>(1, _length(data, r));
+            auto ld = min(max_len_decoder, _length(target, r) + 1);
+            train_len_encoder[r] = le;
+            train_len_decoder[r] = ld;
+            size_t best = 0;
+            for (size_t k = 1; k < buckets.size(); k++) {
+                if (buckets[k].len_encoder >= le && buckets[k].len_decoder >= ld &&
+                        buckets[k].len_encoder + buckets[k].len_decoder < buckets[best].len_encoder + buckets[best].len_decoder) {
+                    best = k;
+                }
+            }
+            buckets[best].ids.push_back(r);
+        }
     }
 
     template<typename T>
@@ -154,42 +204,65 @@ namespace gs
 
     template<typename T>
     T SeqEncoderDecoder<T>::train_one_batch(bool update) {
-        uniform_int_distribution<> distribution(0, train_seq_count-1);
-        vector<size_t> batch_ids(this->batch_size);
+        CHECK(train_X != nullptr, "the train dataset should be added");
+        // a bucket is drawn as likely as its share of sentences, then the batch from its sentences
+        uniform_int_distribution<size_t> distribution(0, train_seq_count-1);
+        size_t r = distribution(galois_rn_generator);
+        size_t k = 0;
+        while (r >= buckets[k].ids.size()) {
+            r -= buckets[k].ids.size();
+            k++;
+        }
+        auto &bucket = buckets[k];
+        uniform_int_distribution<size_t> bucket_distribution(0, bucket.ids.size()-1);
+        auto &batch_ids = this->batch_ids;
+        batch_ids.resize(this->batch_size);
         for (size_t i = 0; i < this->batch_size; i++) {
-            batch_ids[i] = distribution(galois_rn_generator);
+            batch_ids[i] = bucket.ids[bucket_distribution(galois_rn_generator)];
+        }
+        // rows by decreasing length, so that a step of the encoder only computes rows still inside their sentences
+        sort(batch_ids.begin(), batch_ids.end(), [this](size_t a, size_t b) {
+            return train_len_encoder[a] > train_len_encoder[b];
+        });
+        len_encoder.resize(this->batch_size);
+        len_decoder.resize(this->batch_size);
+        for (size_t i = 0; i < this->batch_size; i++) {
+            len_encoder[i] = train_len_encoder[batch_ids[i]];
+            len_decoder[i] = train_len_decoder[batch_ids[i]];
+        }
+        for (auto const& layer : bucket.encoder_layers) {
+            layer->set_lengths(len_encoder);
         }
+        for (auto const& layer : bucket.decoder_layers) {
+            layer->set_lengths(len_decoder);
+        }
+        bucket.projection->set_lengths(len_decoder);
 
-        this->net.reopaque();
+        bucket.net->reopaque();
 
-        for (size_t i = 0; i < max_len_encoder; i++) {
-            this->input_signals[i]->get_data()->copy_from(batch_ids, i, train_X);
+        auto &inputs = bucket.input_signals;
+        auto &outputs = bucket.output_signals;
+        for (size_t i = 0; i < bucket.len_encoder; i++) {
+            inputs[i]->get_data()->copy_from(batch_ids, i, train_X);
         }
-        this->input_signals[max_len_encoder]->get_data()->fill(0); // <EOS> characters
-
-//        this->net.forward();
-        int num1 = hidden_sizes.size()*2 + (max_len_encoder-1)*hidden_sizes.size()*3;
-        for (int i = 0; i < num1; i++) {
-            this->net.forward(i);
+        // <EOS> characters, then the target shifted by one step
+        inputs[bucket.len_encoder]->get_data()->fill(0);
+        for (size_t i = 1; i < bucket.len_decoder; i++) {
+            inputs[bucket.len_encoder+i]->get_data()->copy_from(batch_ids, i-1, train_Y);
         }
-        for (size_t i = 0; i < max_len_decoder; i++) {
-            if (i > 0) {
-                auto input_data = this->input_signals[max_len_encoder+i]->get_data();
-                auto prev_output_data = this->output_signals[i-1]->get_data();
-                input_data->copy_from(prev_output_data);
-            }
-            int num2 = num1+i*(hidden_sizes.size()*3 + 2);
-            for (size_t j = num2; j < hidden_sizes.size()*3 + 2; j++) {
-                this->net.forward(i);
-            }
+        for (size_t i = 0; i < bucket.len_decoder; i++) {
+            outputs[i]->reopaque();
+            outputs[i]->get_target()->copy_from(batch_ids, i, train_Y);
         }
-        this->net.backward();
+
+        bucket.net->forward();
+        bucket.net->backward();
         if (update) {
             this->optimizer->update();
         }
 
         T loss = 0;
-        for (auto output_signal : this->output_signals) {
+        for (auto output_signal : outputs) {
             loss += *output_signal->get_loss();
         }
         return loss;
@@ -207,7 +280,7 @@ namespace gs
 
             int len = train_seq_count;
             for (int i = 0; i < len; i += this->batch_size) {
-                loss += train_one_batch(i);
+                loss += train_one_batch();
                 if (i % 10000 == 0) {
                     cout << " > " << i << endl;
                 }
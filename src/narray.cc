@@ -1,39 +1,42 @@
 # include "galois/narray.h"
 
+#include <algorithm>
+#include <cstdio>
+
 namespace gs
 {
     template<typename T>
-    NArray<T>::NArray(size_t m) : dims{m}, size{m} {
+    NArray<T>::NArray(size_t m, SP_Allocator allocator) : dims{m}, size{m} {
         CHECK(m > 0, "m should be positive");
-        data = new T[get_size()];
+        _allocate(allocator);
     }
 
     template<typename T>
-    NArray<T>::NArray(size_t m, size_t n) : dims{m, n}, size{m*n} {
+    NArray<T>::NArray(size_t m, size_t n, SP_Allocator allocator) : dims{m, n}, size{m*n} {
         CHECK(m > 0, "m should be positive");
         CHECK(n > 0, "n should be positive");
-        data = new T[get_size()];
+        _allocate(allocator);
     }
 
     template<typename T>
-    NArray<T>::NArray(size_t m, size_t n, size_t o) : dims{m, n, o}, size{m*n*o} {
+    NArray<T>::NArray(size_t m, size_t n, size_t o, SP_Allocator allocator) : dims{m, n, o}, size{m*n*o} {
         CHECK(m > 0, "m should be positive");
         CHECK(n > 0, "n should be positive");
         CHECK(o > 0, "o should be positive");
-        data = new T[get_size()];
+        _allocate(allocator);
     }
 
     template<typename T>
-    NArray<T>::NArray(size_t m, size_t n, size_t o, size_t k) : dims{m, n, o, k}, size{m*n*o*k} {
+    NArray<T>::NArray(size_t m, size_t n, size_t o, size_t k, SP_Allocator allocator) : dims{m, n, o, k}, size{m*n*o*k} {
         CHECK(m > 0, "m should be positive");
         CHECK(n > 0, "n should be positive");
         CHECK(o > 0, "o should be positive");
         CHECK(k > 0, "k should be positive");
-        data = new T[get_size()];
+        _allocate(allocator);
     }
 
     template<typename T>
-    NArray<T>::NArray(vector<size_t> nums) : dims{nums} {
+    NArray<T>::NArray(const Shape &nums, SP_Allocator allocator) : dims(nums) {
         for (auto m : nums) {
             CHECK(m > 0, "each dimension should be positive");
         }
@@ -41,46 +44,177 @@ namespace gs
         for (auto d : dims) {
             size *= d;
         }
-        data = new T[get_size()];
+        _allocate(allocator);
+    }
+
+    template<typename T>
+    NArray<T>::NArray(const Shape &dims, const Shape &strides, T *data, SP_NArray<T> owner, bool opaque)
+            : dims(dims)
+            , size{1}
+            , strides(strides)
+            , owner{owner}
+            , data{data}
+            , own_data{false}
+            , data_opaque{opaque} {
+        // contiguous if strides are those of row major order, except for dimensions of 1
+        size_t expected = 1;
+        for (int k = int(dims.size())-1; k >= 0; k--) {
+            if (dims[k] != 1 && strides[k] != expected) {
+                contiguous = false;
+            }
+            expected *= dims[k];
+        }
+        size = expected;
     }
 
     template<typename T>
     NArray<T>::~NArray() {
-        if (data) {
-            delete[] data;
+        _deallocate();
+    }
+
+    template<typename T>
+    void NArray<T>::_allocate(SP_Allocator allocator) {
+        strides = dims;
+        for (int k = int(dims.size())-1; k >= 0; k--) {
+            strides[k] = k+1 < int(dims.size()) ? strides[k+1] * dims[k+1] : 1;
         }
+        this->allocator = allocator ? allocator : get_default_allocator();
+        data = static_cast<T*>(this->allocator->allocate(get_size() * sizeof(T)));
     }
 
     template<typename T>
-    void NArray<T>::copy_from(const SP_NArray<T> other) {
-        auto other_dims = other->get_dims();
-        CHECK(other_dims == this->dims, "the dimension should be equal");
+    void NArray<T>::_deallocate() {
+        if (data && own_data) {
+            allocator->deallocate(data, get_size() * sizeof(T));
+        }
+        data = nullptr;
+        allocator = nullptr;
+        storage = nullptr;
+    }
+
+    template<typename T>
+    SP_NArray<T> NArray<T>::_view(const Shape &dims, const Shape &strides, T *data) {
+        auto base = owner ? owner : this->shared_from_this();
+        return SP_NArray<T>(new NArray<T>(dims, strides, data, base, data_opaque));
+    }
 
-        auto other_ptr = other->get_data();
-        for (size_t i = 0; i < this->get_size(); i++) {
-            this->data[i] = other_ptr[i];
+    template<typename T>
+    SP_NArray<T> NArray<T>::slice(size_t begin, size_t end) {
+        CHECK(!dims.empty() && begin < end && end <= dims[0], "rows [%zu, %zu) are out of range", begin, end);
+        auto new_dims = dims;
+        new_dims[0] = end - begin;
+        return _view(new_dims, strides, data + begin*strides[0]);
+    }
+
+    template<typename T>
+    SP_NArray<T> NArray<T>::reshape(const Shape &new_dims) {
+        CHECK(contiguous, "only a contiguous array could be reshaped");
+        size_t new_size = 1;
+        for (auto d : new_dims) {
+            new_size *= d;
         }
-        setclear();
+        CHECK(!new_dims.empty() && new_size == size, "the number of elements should not change");
+        auto new_strides = new_dims;
+        for (int k = int(new_dims.size())-1; k >= 0; k--) {
+            new_strides[k] = k+1 < int(new_dims.size()) ? new_strides[k+1] * new_dims[k+1] : 1;
+        }
+        return _view(new_dims, new_strides, data);
     }
 
     template<typename T>
-    void NArray<T>::copy_from(const vector<size_t> &idxs, const SP_NArray<T> dataset) {
-        auto dataset_dims = dataset->get_dims();
-        CHECK(idxs.size() == this->dims[0], "first dimension should be equal to batch size");
-        CHECK((dataset->get_size() / dataset->get_dims()[0]) == this->get_size() / this->dims[0], "rest dimensions should be equal")
+    SP_NArray<T> NArray<T>::transpose(size_t a, size_t b) {
+        CHECK(a < dims.size() && b < dims.size(), "dimensions to swap are out of range");
+        auto new_dims = dims;
+        auto new_strides = strides;
+        swap(new_dims[a], new_dims[b]);
+        swap(new_strides[a], new_strides[b]);
+        return _view(new_dims, new_strides, data);
+    }
 
-        int batch_size = idxs.size();
-        int stride = this->get_size() / batch_size;
-        auto dataset_ptr = dataset->get_data();
-        for (int i = 0; i < batch_size; i++) {
+    template<typename T>
+    SP_NArray<T> NArray<T>::select(size_t dim, size_t idx) {
+        CHECK(dims.size() > 1 && dim < dims.size() && idx < dims[dim], "entry %zu of dimension %zu is out of range", idx, dim);
+        auto new_dims = dims;
+        auto new_strides = strides;
+        new_dims.erase(dim);
+        new_strides.erase(dim);
+        return _view(new_dims, new_strides, data + idx*strides[dim]);
+    }
+
+    template<typename T>
+    void NArray<T>::slide(long rows) {
+        CHECK(owner && !dims.empty(), "only a view could slide");
+        auto first = data + rows*long(strides[0]);
+        auto last = first;
+        for (size_t k = 0; k < dims.size(); k++) {
+            last += (dims[k]-1) * strides[k];
+        }
+        CHECK(first >= owner->data && last < owner->data + owner->size, "a view should stay inside its array");
+        data = first;
+    }
+
+    template<typename T>
+    void NArray<T>::_gather(T *dst, const T *src, const size_t *dims, const size_t *strides, size_t rank) {
+        if (rank == 0) {
+            *dst = *src;
+            return;
+        }
+        if (rank == 1) {
+            for (size_t j = 0; j < dims[0]; j++) {
+                dst[j] = src[j*strides[0]];
+            }
+            return;
+        }
+        size_t inner = 1;
+        for (size_t k = 1; k < rank; k++) {
+            inner *= dims[k];
+        }
+        for (size_t i = 0; i < dims[0]; i++) {
+            _gather(dst + i*inner, src + i*strides[0], dims+1, strides+1, rank-1);
+        }
+    }
+
+    template<typename T>
+    void NArray<T>::_copy_rows(const size_t *idxs, size_t count, const SP_NArray<T> &dataset) {
+        auto &dataset_dims = dataset->dims;
+        CHECK(count == this->dims[0], "first dimension should be equal to batch size");
+        CHECK((dataset->get_size() / dataset_dims[0]) == this->get_size() / this->dims[0], "rest dimensions should be equal")
+
+        auto dst = get_data();
+        size_t stride = this->get_size() / count;
+        auto dataset_ptr = dataset->get_strided_data();
+        for (size_t i = 0; i < count; i++) {
             CHECK(idxs[i] < dataset_dims[0], "invalid index");
-            for (int j = 0; j < stride; j++) {
-                this->data[i*stride + j] = dataset_ptr[idxs[i]*stride + j];
+            if (dataset->contiguous) {
+                copy(dataset_ptr + idxs[i]*stride, dataset_ptr + (idxs[i]+1)*stride, dst + i*stride);
+            } else {
+                _gather(dst + i*stride, dataset_ptr + idxs[i]*dataset->strides[0],
+                        dataset_dims.data() + 1, dataset->strides.data() + 1, dataset_dims.size() - 1);
             }
         }
         setclear();
     }
 
+    template<typename T>
+    void NArray<T>::copy_from(const SP_NArray<T> other) {
+        auto other_dims = other->get_dims();
+        CHECK(other_dims == this->dims, "the dimension should be equal");
+
+        auto dst = get_data();
+        if (other->contiguous) {
+            auto other_ptr = other->get_data();
+            copy(other_ptr, other_ptr + size, dst);
+        } else {
+            _gather(dst, other->get_strided_data(), other->dims.data(), other->strides.data(), other->dims.size());
+        }
+        setclear();
+    }
+
+    template<typename T>
+    void NArray<T>::copy_from(const vector<size_t> &idxs, const SP_NArray<T> dataset) {
+        _copy_rows(idxs.data(), idxs.size(), dataset);
+    }
+
     template<typename T>
     void NArray<T>::copy_from(const vector<size_t> &idx0s, size_t idx1, const SP_NArray<T> dataset) {
         auto dataset_dims = dataset->get_dims();
@@ -89,7 +223,7 @@ namespace gs
         for (size_t i = 2; i < this->dims.size(); i++) {
             CHECK(dataset_dims[i] == this->dims[i-1], "dimensions should be equal");
         }
-        CHECK(idx1 >= 0 && idx1 < this->dims[1], "invalid index");
+        CHECK(idx1 < dataset_dims[1], "invalid index");
 
         int batch_size = this->dims[0];
         int stride = this->get_size() / batch_size;
@@ -114,23 +248,41 @@ namespace gs
         }
         CHECK(start_from >= 0 && start_from+copy_size-1 < dataset_dims[0], "offset is not valid");
 
-        int batch_size = copy_size;
-        int stride = this->get_size() / batch_size;
-        auto dataset_ptr = dataset->get_data();
-        for (int i = 0; i < batch_size; i++) {
-            for (int j = 0; j < stride; j++) {
-                this->data[i*stride + j] = dataset_ptr[(start_from+i)*stride + j];
-            }
+        vector<size_t> idxs(copy_size);
+        for (size_t i = 0; i < copy_size; i++) {
+            idxs[i] = start_from + i;
         }
-        setclear();
+        _copy_rows(idxs.data(), copy_size, dataset);
     }
 
+    template<typename T>
+    void NArray<T>::save(const string &path) {
+        CHECK(contiguous, "only a contiguous array could be saved");
+        auto f = fopen(path.c_str(), "wb");
+        CHECK(f, "could not open %s", path.c_str());
+        auto written = fwrite(data, sizeof(T), size, f);
+        fclose(f);
+        CHECK(written == size, "could not write %s", path.c_str());
+    }
+
+    template<typename T>
+    void NArray<T>::load(const string &path) {
+        CHECK(contiguous, "only a contiguous array could be loaded");
+        auto f = fopen(path.c_str(), "rb");
+        CHECK(f, "could not open %s", path.c_str());
+        auto read = fread(data, sizeof(T), size, f);
+        auto extra = fgetc(f);
+        fclose(f);
+        CHECK(read == size && extra == EOF, "%s should hold %zu elements", path.c_str(), size);
+        data_opaque = false;
+    }
 
     template<typename T>
     void NArray<T>::normalize_for(int dim) {
         // currently, only two dimensional array are supported
         CHECK(dim == NARRAY_DIM_ZERO || dim == NARRAY_DIM_ONE, "only support upto 2 dimensional array");
         CHECK(this->dims.size() == 2, "only support upto 2 dimensional array");
+        CHECK(contiguous, "only a contiguous array could be normalized");
 
         if (dim == NARRAY_DIM_ZERO) {
             for (size_t i = 0; i < this->dims[0]; i++) {
@@ -156,7 +308,61 @@ namespace gs
         }
     }
 
+    template<typename T>
+    void NArray<T>::set_row_sparse() {
+        CHECK(!dims.empty(), "a row sparse array should have rows");
+        CHECK(!owner, "a view could not be row sparse");
+        for (size_t i = 0; i < size; i++) {
+            data[i] = T(0);
+        }
+        row_sparse = true;
+        sparse_rows.clear();
+        row_marks.assign(dims[0], false);
+    }
+
+    template<typename T>
+    void NArray<T>::clear_sparse_rows() {
+        CHECK(row_sparse, "the array should be row sparse");
+        auto row_size = get_row_size();
+        for (auto row : sparse_rows) {
+            for (size_t j = 0; j < row_size; j++) {
+                data[row*row_size + j] = T(0);
+            }
+            row_marks[row] = false;
+        }
+        sparse_rows.clear();
+    }
+
+    template<typename T>
+    vector<size_t> flat_offsets(const vector<SP_NArray<T>> &arrays) {
+        const size_t align = Allocator::ALIGNMENT / sizeof(T);
+        vector<size_t> offsets{0};
+        for (auto &array : arrays) {
+            offsets.push_back(offsets.back() + (array->get_size() + align - 1) / align * align);
+        }
+        return offsets;
+    }
+
+    template<typename T>
+    SP_NArray<T> flatten(const vector<SP_NArray<T>> &arrays) {
+        CHECK(!arrays.empty(), "there should be arrays to flatten");
+        auto offsets = flat_offsets(arrays);
+        auto buffer = make_shared<NArray<T>>(offsets.back());
+        auto base = buffer->get_data();
+        for (size_t i = 0; i < arrays.size(); i++) {
+            auto size = arrays[i]->get_size();
+            copy(arrays[i]->get_data(), arrays[i]->get_data() + size, base + offsets[i]);
+            fill(base + offsets[i] + size, base + offsets[i+1], T(0));
+            arrays[i]->set_external_data(base + offsets[i], buffer);
+        }
+        return buffer;
+    }
+
     template class NArray<float>;
     template class NArray<double>;
+    template vector<size_t> flat_offsets(const vector<SP_NArray<float>>&);
+    template vector<size_t> flat_offsets(const vector<SP_NArray<double>>&);
+    template SP_NArray<float> flatten(const vector<SP_NArray<float>>&);
+    template SP_NArray<double> flatten(const vector<SP_NArray<double>>&);
 
 }
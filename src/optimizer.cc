@@ -0,0 +1,204 @@
+#include "galois/optimizer.h"
+#include "galois/narray_kernels.h"
+
+#include <cmath>
+
+namespace gs
+{
+
+    template<typename T>
+    const size_t Optimizer<T>::CHUNK_SIZE;
+
+    template<typename T>
+    void Optimizer<T>::compile(vector<SP_NArray<T>> params, vector<SP_NArray<T>> grads) {
+        CHECK(this->params.empty() && this->grads.empty(), "params and grads should not be set before");
+        CHECK(params.size() == grads.size(), "params and grads should have equal size");
+        for (size_t i = 0; i < params.size(); i++) {
+            CHECK(params[i]->get_dims() == grads[i]->get_dims(), "param and grad should have the same dimensions");
+        }
+        this->params.insert(this->params.end(), params.begin(), params.end());
+        this->grads.insert(this->grads.end(), grads.begin(), grads.end());
+
+        offsets = flat_offsets(params);
+        state_size = offsets.back();
+        if (num_states > 0 && state_size > 0) {
+            states = make_shared<NArray<T>>(num_states * state_size);
+            states->fill(T(0));
+        }
+
+        // params and grads flattened in this order share the layout of states, so a run of
+        // dense params is swept as one range, across their boundaries
+        bool flat = true;
+        for (size_t i = 0; i < params.size(); i++) {
+            flat = flat && params[i]->get_data() == params[0]->get_data() + offsets[i]
+                        && grads[i]->get_data() == grads[0]->get_data() + offsets[i];
+        }
+
+        vector<Piece> chunk{};
+        size_t chunk_size = 0;
+        auto add_range = [&](size_t i, size_t size) {
+            for (size_t begin = 0; begin < size; ) {
+                auto end = min(size, begin + CHUNK_SIZE - chunk_size);
+                chunk.push_back(Piece{i, begin, end});
+                chunk_size += end - begin;
+                begin = end;
+                if (chunk_size == CHUNK_SIZE) {
+                    chunks.push_back(chunk);
+                    chunk.clear();
+                    chunk_size = 0;
+                }
+            }
+        };
+        for (size_t i = 0; i < params.size(); ) {
+            if (grads[i]->is_row_sparse()) {
+                sparse_params.push_back(i++);
+            } else if (!flat) {
+                add_range(i, params[i]->get_size());
+                i++;
+            } else {
+                auto j = i + 1;
+                while (j < params.size() && !grads[j]->is_row_sparse()) {
+                    j++;
+                }
+                add_range(i, offsets[j-1] + params[j-1]->get_size() - offsets[i]);
+                i = j;
+            }
+        }
+        if (!chunk.empty()) {
+            chunks.push_back(chunk);
+        }
+    }
+
+    template<typename T>
+    void Optimizer<T>::update() {
+        for (size_t i = 0; i < params.size(); i++) {
+            CHECK(!params[i]->opaque(), "param should not be opaque");
+            CHECK(!grads[i]->opaque(), "grad should not be opaque");
+        }
+        _prepare();
+
+        auto run_chunk = [this](size_t c) {
+            for (auto &piece : chunks[c]) {
+                _step(piece.param, piece.begin, piece.end);
+            }
+        };
+        auto run_sparse = [this](size_t i) {
+            auto row_size = grads[i]->get_row_size();
+            for (auto row : grads[i]->get_sparse_rows()) {
+                _step(i, row*row_size, (row+1)*row_size);
+            }
+        };
+        if (pool == nullptr) {
+            for (size_t c = 0; c < chunks.size(); c++) {
+                run_chunk(c);
+            }
+            for (auto i : sparse_params) {
+                run_sparse(i);
+            }
+            return;
+        }
+        for (size_t c = 0; c < chunks.size(); c++) {
+            pool->submit([run_chunk, c]() { run_chunk(c); });
+        }
+        for (auto i : sparse_params) {
+            pool->submit([run_sparse, i]() { run_sparse(i); });
+        }
+        pool->wait_all();
+    }
+
+    template<typename T>
+    void Optimizer<T>::set_num_threads(size_t num_threads) {
+        CHECK(num_threads > 0, "at least one thread is needed");
+        if (num_threads == 1) {
+            pool = nullptr;
+        } else {
+            pool = make_shared<ThreadPool>(num_threads);
+        }
+    }
+
+    template<typename T>
+    void SGD_Optimizer<T>::_step(size_t i, size_t begin, size_t end) {
+        vec_scale(this->params[i]->get_data() + begin, -this->lrate, this->grads[i]->get_data() + begin,
+                  end - begin, false);
+    }
+
+    template<typename T>
+    Momentum_Optimizer<T>::Momentum_Optimizer(T lr, T mu, bool nesterov)
+            : Optimizer<T>(lr)
+            , mu(mu)
+            , nesterov(nesterov) {
+        this->num_states = 1;
+    }
+
+    template<typename T>
+    void Momentum_Optimizer<T>::_step(size_t i, size_t begin, size_t end) {
+        vec_momentum_update(this->params[i]->get_data() + begin, this->_state(0, i) + begin,
+                            this->grads[i]->get_data() + begin, end - begin, this->lrate, mu, nesterov);
+    }
+
+    template<typename T>
+    RMSProp_Optimizer<T>::RMSProp_Optimizer(T lr, T rho, T eps)
+            : Optimizer<T>(lr)
+            , rho(rho)
+            , eps(eps) {
+        this->num_states = 1;
+    }
+
+    template<typename T>
+    void RMSProp_Optimizer<T>::_step(size_t i, size_t begin, size_t end) {
+        vec_rmsprop_update(this->params[i]->get_data() + begin, this->_state(0, i) + begin,
+                           this->grads[i]->get_data() + begin, end - begin, this->lrate, rho, eps);
+    }
+
+    template<typename T>
+    Adam_Optimizer<T>::Adam_Optimizer(T lr, T beta1, T beta2, T eps)
+            : Optimizer<T>(lr)
+            , beta1(beta1)
+            , beta2(beta2)
+            , eps(eps) {
+        this->num_states = 2;
+    }
+
+    template<typename T>
+    void Adam_Optimizer<T>::_prepare() {
+        t++;
+        lr_t = this->lrate * sqrt(T(1) - pow(beta2, T(t))) / (T(1) - pow(beta1, T(t)));
+    }
+
+    template<typename T>
+    void Adam_Optimizer<T>::_step(size_t i, size_t begin, size_t end) {
+        vec_adam_update(this->params[i]->get_data() + begin, this->_state(0, i) + begin, this->_state(1, i) + begin,
+                        this->grads[i]->get_data() + begin, end - begin, lr_t, beta1, beta2, eps);
+    }
+
+    template<typename T>
+    SP_Optimizer<T> make_optimizer(const string &name, T lr) {
+        if (name == "sgd") {
+            return make_shared<SGD_Optimizer<T>>(lr);
+        } else if (name == "momentum") {
+            return make_shared<Momentum_Optimizer<T>>(lr);
+        } else if (name == "nesterov") {
+            return make_shared<Momentum_Optimizer<T>>(lr, T(0.9), true);
+        } else if (name == "rmsprop") {
+            return make_shared<RMSProp_Optimizer<T>>(lr);
+        } else if (name == "adam") {
+            return make_shared<Adam_Optimizer<T>>(lr);
+        } else {
+            throw(name + " is not implemented");
+        }
+    }
+
+    template class Optimizer<float>;
+    template class Optimizer<double>;
+    template class SGD_Optimizer<float>;
+    template class SGD_Optimizer<double>;
+    template class Momentum_Optimizer<float>;
+    template class Momentum_Optimizer<double>;
+    template class RMSProp_Optimizer<float>;
+    template class RMSProp_Optimizer<double>;
+    template class Adam_Optimizer<float>;
+    template class Adam_Optimizer<double>;
+    template SP_Optimizer<float> make_optimizer(const string&, float);
+    template SP_Optimizer<double> make_optimizer(const string&, double);
+
+}
@@ -0,0 +1,126 @@
+#include "galois/thread_pool.h"
+#include "galois/utils.h"
+
+namespace gs
+{
+
+    namespace
+    {
+        // the pool and the queue the current thread works on
+        thread_local ThreadPool *current_pool = nullptr;
+        thread_local size_t current_queue = 0;
+    }
+
+    ThreadPool::ThreadPool(size_t num_threads) : queued(0), pending(0), next_queue(0) {
+        CHECK(num_threads > 0, "number of threads should be positive");
+        for (size_t i = 0; i < num_threads; i++) {
+            queues.push_back(unique_ptr<TaskQueue>(new TaskQueue()));
+        }
+        for (size_t i = 1; i < num_threads; i++) {
+            threads.push_back(thread(&ThreadPool::_work, this, i));
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            lock_guard<mutex> lock(sleep_m);
+            stop = true;
+        }
+        sleep_cv.notify_all();
+        for (auto &t : threads) {
+            t.join();
+        }
+    }
+
+    void ThreadPool::submit(function<void()> task) {
+        size_t idx;
+        if (current_pool == this) {
+            idx = current_queue;
+        } else {
+            idx = next_queue++ % queues.size();
+        }
+        pending++;
+        {
+            lock_guard<mutex> lock(queues[idx]->m);
+            queues[idx]->tasks.push_back(move(task));
+        }
+        queued++;
+        {
+            lock_guard<mutex> lock(sleep_m);
+        }
+        sleep_cv.notify_all();
+    }
+
+    bool ThreadPool::_try_pop(size_t idx, function<void()> &task) {
+        {
+            lock_guard<mutex> lock(queues[idx]->m);
+            auto &tasks = queues[idx]->tasks;
+            if (!tasks.empty()) {
+                task = move(tasks.back());
+                tasks.pop_back();
+                queued--;
+                return true;
+            }
+        }
+        for (size_t k = 1; k < queues.size(); k++) {
+            auto &victim = queues[(idx+k) % queues.size()];
+            lock_guard<mutex> lock(victim->m);
+            if (!victim->tasks.empty()) {
+                task = move(victim->tasks.front());
+                victim->tasks.pop_front();
+                queued--;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void ThreadPool::_finish() {
+        if (--pending == 0) {
+            {
+                lock_guard<mutex> lock(sleep_m);
+            }
+            sleep_cv.notify_all();
+        }
+    }
+
+    void ThreadPool::_work(size_t idx) {
+        current_pool = this;
+        current_queue = idx;
+        function<void()> task;
+        while (true) {
+            if (_try_pop(idx, task)) {
+                task();
+                task = nullptr;
+                _finish();
+                continue;
+            }
+            unique_lock<mutex> lock(sleep_m);
+            sleep_cv.wait(lock, [this]{ return stop || queued > 0; });
+            if (stop) {
+                return;
+            }
+        }
+    }
+
+    void ThreadPool::wait_all() {
+        auto prev_pool = current_pool;
+        auto prev_queue = current_queue;
+        current_pool = this;
+        current_queue = 0;
+        function<void()> task;
+        while (pending > 0) {
+            if (_try_pop(0, task)) {
+                task();
+                task = nullptr;
+                _finish();
+                continue;
+            }
+            unique_lock<mutex> lock(sleep_m);
+            sleep_cv.wait(lock, [this]{ return pending == 0 || queued > 0; });
+        }
+        current_pool = prev_pool;
+        current_queue = prev_queue;
+    }
+
+}
@@ -0,0 +1,33 @@
+#include "galois/models.h"
+#include "galois/filters.h"
+#include <cassert>
+
+using namespace std;
+using namespace gs;
+
+int main()
+{
+    using T = double;
+
+    // params flattened by compile stay valid after the model is gone
+    auto lin = make_shared<Linear<T>>(4, 3);
+    T w0 = lin->get_params()[0]->get_data()[0];
+    {
+        Model<T> scoped(1, 1, 0.01, "sgd");
+        scoped.add_link("x", "raw_y", lin);
+        scoped.add_link("raw_y", "y", make_shared<CrossEntropy<T>>());
+        scoped.add_input_ids("x");
+        scoped.add_output_ids("y");
+        scoped.compile();
+    }
+    // arrays as large as the buffer of params would take its memory if it were freed
+    vector<SP_NArray<T>> others{};
+    for (int k = 0; k < 8; k++) {
+        others.push_back(make_shared<NArray<T>>(flat_offsets(lin->get_params()).back()));
+        others.back()->fill(12345);
+    }
+    assert(lin->get_params()[0]->get_data()[0] == w0);
+    printf("params outlive the model\n");
+
+    return 0;
+}
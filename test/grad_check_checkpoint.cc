@@ -0,0 +1,137 @@
+#include "galois/models.h"
+#include "galois/filters.h"
+#include <cstdlib>
+#include <cassert>
+#include <cmath>
+
+using namespace std;
+using namespace gs;
+
+string step_id(string tag, size_t i) {
+    return tag + "[" + to_string(i) + "]";
+}
+
+// a tanh rnn unrolled over steps, every step shares the filters of the first one
+template<typename T>
+void build(Model<T> &model, size_t steps, size_t in_size, size_t state_size, size_t num_classes) {
+    auto wx = make_shared<Linear<T>>(in_size, state_size);
+    auto wh = make_shared<Linear<T>>(state_size, state_size);
+    auto wy = make_shared<Linear<T>>(state_size, num_classes);
+    vector<string> x_ids{};
+    vector<string> y_ids{};
+    for (size_t i = 0; i < steps; i++) {
+        model.add_link(step_id("x", i), step_id("hraw", i), i == 0 ? wx : wx->share());
+        if (i > 0) {
+            model.add_link(step_id("h", i-1), step_id("hraw", i), wh->share());
+        }
+        model.add_link(step_id("hraw", i), step_id("h", i), make_shared<Tanh<T>>());
+        model.add_link(step_id("h", i), step_id("yraw", i), i == 0 ? wy : wy->share());
+        model.add_link(step_id("yraw", i), step_id("y", i), make_shared<CrossEntropy<T>>());
+        x_ids.push_back(step_id("x", i));
+        y_ids.push_back(step_id("y", i));
+    }
+    model.add_input_ids(x_ids);
+    model.add_output_ids(y_ids);
+    model.compile();
+}
+
+int main()
+{
+    using T = double;
+
+    size_t steps = 16;
+    size_t k = 4;
+    size_t in_size = 3;
+    size_t state_size = 32;
+    size_t num_classes = 4;
+
+    int batch_size = 2;
+    int num_epoch = 1;
+    T learning_rate = 0.01;
+    Model<T> plain(batch_size, num_epoch, learning_rate, "sgd");
+    Model<T> model(batch_size, num_epoch, learning_rate, "sgd");
+    build(plain, steps, in_size, state_size, num_classes);
+    build(model, steps, in_size, state_size, num_classes);
+    plain.plan_memory();
+    // keep the state of every k steps
+    vector<string> checkpoints{};
+    for (size_t i = k-1; i+1 < steps; i += k) {
+        checkpoints.push_back(step_id("h", i));
+    }
+    model.set_checkpoints(checkpoints);
+    model.plan_memory();
+    printf("%zu bytes of signals with checkpoints, %zu bytes without\n",
+           model.get_planned_bytes(), plain.get_planned_bytes());
+    assert(model.get_planned_bytes() < plain.get_planned_bytes());
+
+    // both samples are the same, so every batch is too
+    vector<SP_NArray<T>> X{};
+    vector<SP_NArray<T>> Y{};
+    for (size_t i = 0; i < steps; i++) {
+        X.push_back(make_shared<NArray<T>>(batch_size, in_size));
+        X.back()->uniform(-1, 1);
+        copy(X.back()->get_data(), X.back()->get_data() + in_size, X.back()->get_data() + in_size);
+        Y.push_back(make_shared<NArray<T>>(batch_size));
+        Y.back()->fill(i % num_classes);
+    }
+    plain.add_train_dataset(X, Y);
+    model.add_train_dataset(X, Y);
+    plain.add_test_dataset(X, Y);
+    model.add_test_dataset(X, Y);
+
+    auto params = model.get_params();
+    auto grads = model.get_grads();
+    auto plain_params = plain.get_params();
+    auto plain_grads = plain.get_grads();
+    for (size_t i = 0; i < params.size(); i++) {
+        plain_params[i]->copy_from(params[i]);
+    }
+
+    // segments run again give the same loss and grads as the plain net
+    auto loss = model.train_one_batch(false);
+    auto plain_loss = plain.train_one_batch(false);
+    assert(abs(loss - plain_loss) < 1e-12);
+    for (size_t i = 0; i < grads.size(); i++) {
+        for (size_t j = 0; j < grads[i]->get_size(); j++) {
+            assert(abs(grads[i]->get_data()[j] - plain_grads[i]->get_data()[j]) < 1e-12);
+        }
+    }
+
+    srand(time(NULL));
+    for (int k = 0; k < 20; k++) {
+        int idx;
+        idx = rand() % params.size();
+        auto p = params[idx];
+        auto dp = grads[idx];
+
+        idx = rand() % p->get_size();
+
+        auto old_pi = p->get_data()[idx];
+        T delta = 1e-5;
+        model.train_one_batch(false);
+        auto grad = dp->get_data()[idx];
+
+        p->get_data()[idx] = old_pi + delta;
+        auto loss1 = model.train_one_batch(false);
+
+        p->get_data()[idx] = old_pi - delta;
+        auto loss2 = model.train_one_batch(false);
+        p->get_data()[idx] = old_pi;
+
+        auto grad_ = (loss1-loss2) / (2*delta);
+        auto diff = abs(grad - grad_);
+        assert(diff < delta);
+        printf("%dth gradient check passed\n", k);
+    }
+
+    // fit keeps the plan and the checkpoints of the compiled models
+    plain.fit();
+    model.fit();
+    for (size_t i = 0; i < params.size(); i++) {
+        for (size_t j = 0; j < params[i]->get_size(); j++) {
+            assert(abs(params[i]->get_data()[j] - plain_params[i]->get_data()[j]) < 1e-12);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,106 @@
+#include "galois/models.h"
+#include "galois/filters.h"
+#include <cstdlib>
+#include <cassert>
+#include <cmath>
+
+using namespace std;
+using namespace gs;
+
+template<typename T>
+void build(Model<T> &model, size_t in_size, size_t hidden_size, size_t num_classes) {
+    model.add_link("x", "raw_h", make_shared<Linear<T>>(in_size, hidden_size));
+    model.add_link("raw_h", "h", make_shared<Tanh<T>>());
+    model.add_link("h", "raw_y", make_shared<Linear<T>>(hidden_size, num_classes));
+    model.add_link("raw_y", "y", make_shared<CrossEntropy<T>>());
+    model.add_input_ids("x");
+    model.add_output_ids("y");
+    model.compile();
+}
+
+int main()
+{
+    using T = double;
+
+    size_t in_size = 8;
+    size_t hidden_size = 32;
+    size_t num_classes = 4;
+
+    int batch_size = 2;
+    int num_epoch = 1;
+    T learning_rate = 0.01;
+    Model<T> plain(batch_size, num_epoch, learning_rate, "sgd");
+    Model<T> model(batch_size, num_epoch, learning_rate, "sgd");
+    build(plain, in_size, hidden_size, num_classes);
+    build(model, in_size, hidden_size, num_classes);
+    model.plan_memory();
+    printf("%zu bytes of signals planned, %zu bytes without a plan\n",
+           model.get_planned_bytes(), model.get_naive_bytes());
+
+    // both samples are the same, so every batch is too
+    auto X = make_shared<NArray<T>>(batch_size, in_size);
+    X->uniform(-1, 1);
+    copy(X->get_data(), X->get_data() + in_size, X->get_data() + in_size);
+    auto Y = make_shared<NArray<T>>(batch_size);
+    Y->fill(1);
+    plain.add_train_dataset(X, Y);
+    model.add_train_dataset(X, Y);
+    plain.add_test_dataset(X, Y);
+    model.add_test_dataset(X, Y);
+
+    auto params = model.get_params();
+    auto grads = model.get_grads();
+    auto plain_params = plain.get_params();
+    auto plain_grads = plain.get_grads();
+    for (size_t i = 0; i < params.size(); i++) {
+        plain_params[i]->copy_from(params[i]);
+    }
+
+    // signals sharing the arena give the same loss and grads as the unplanned net
+    auto loss = model.train_one_batch(false);
+    auto plain_loss = plain.train_one_batch(false);
+    assert(abs(loss - plain_loss) < 1e-12);
+    for (size_t i = 0; i < grads.size(); i++) {
+        for (size_t j = 0; j < grads[i]->get_size(); j++) {
+            assert(abs(grads[i]->get_data()[j] - plain_grads[i]->get_data()[j]) < 1e-12);
+        }
+    }
+
+    srand(time(NULL));
+    for (int k = 0; k < 20; k++) {
+        int idx;
+        idx = rand() % params.size();
+        auto p = params[idx];
+        auto dp = grads[idx];
+
+        idx = rand() % p->get_size();
+
+        auto old_pi = p->get_data()[idx];
+        T delta = 1e-5;
+        model.train_one_batch(false);
+        auto grad = dp->get_data()[idx];
+
+        p->get_data()[idx] = old_pi + delta;
+        auto loss1 = model.train_one_batch(false);
+
+        p->get_data()[idx] = old_pi - delta;
+        auto loss2 = model.train_one_batch(false);
+        p->get_data()[idx] = old_pi;
+
+        auto grad_ = (loss1-loss2) / (2*delta);
+        auto diff = abs(grad - grad_);
+        assert(diff < delta);
+        printf("%dth gradient check passed\n", k);
+    }
+
+    // fit trains the compiled model with its memory plan
+    plain.fit();
+    model.fit();
+    for (size_t i = 0; i < params.size(); i++) {
+        for (size_t j = 0; j < params[i]->get_size(); j++) {
+            assert(abs(params[i]->get_data()[j] - plain_params[i]->get_data()[j]) < 1e-12);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,82 @@
+#include "galois/models.h"
+#include "galois/filters.h"
+#include "galois/gfilters/scan.h"
+#include <cstdlib>
+#include <cassert>
+#include <cmath>
+
+using namespace std;
+using namespace gs;
+
+int main()
+{
+    using T = double;
+
+    size_t max_steps = 5;
+    size_t in_size = 3;
+    size_t state_size = 6;
+    size_t num_classes = 4;
+
+    auto cell = make_shared<OrderedNet<T>>();
+    cell->add_link({"x"}, {"hraw"}, make_shared<Linear<T>>(in_size, state_size));
+    cell->add_link({"h_prev"}, {"hraw"}, make_shared<Linear<T>>(state_size, state_size));
+    cell->add_link({"hraw"}, {"h"}, make_shared<Tanh<T>>());
+    cell->add_input_ids({"x", "h_prev"});
+    cell->add_output_ids("h");
+    cell->fix_net();
+    auto scan = make_shared<Scan<T>>(cell, in_size, state_size, max_steps);
+
+    int batch_size = 2;
+    int num_epoch = 1;
+    T learning_rate = 0.01;
+    Model<T> model(batch_size, num_epoch, learning_rate, "sgd");
+    model.add_link("x", {"hs", "h_last"}, scan);
+    model.add_link("hs", "raw_y", make_shared<Linear<T>>(max_steps*state_size, num_classes));
+    model.add_link("h_last", "raw_y", make_shared<Linear<T>>(state_size, num_classes));
+    model.add_link("raw_y", "predictions", make_shared<CrossEntropy<T>>());
+    model.add_input_ids("x");
+    model.add_output_ids("predictions");
+    model.compile();
+
+    auto X = make_shared<NArray<T>>(1, max_steps, in_size);
+    X->uniform(-1, 1);
+    auto Y = make_shared<NArray<T>>(1);
+    Y->get_data()[0] = 2;
+    model.add_train_dataset(X, Y);
+
+    auto params = model.get_params();
+    auto grads = model.get_grads();
+
+    // the full sequence, then a shorter one with the same net
+    srand(time(NULL));
+    for (size_t num_steps : {max_steps, size_t(3)}) {
+        scan->set_num_steps(num_steps);
+        for (int k = 0; k < 20; k++) {
+            int idx;
+            idx = rand() % params.size();
+            auto p = params[idx];
+            auto dp = grads[idx];
+
+            idx = rand() % p->get_size();
+
+            auto old_pi = p->get_data()[idx];
+            T delta = 1e-5;
+            model.train_one_batch(false);
+            auto grad = dp->get_data()[idx];
+
+            p->get_data()[idx] = old_pi + delta;
+            auto loss1 = model.train_one_batch(false);
+
+            p->get_data()[idx] = old_pi - delta;
+            auto loss2 = model.train_one_batch(false);
+            p->get_data()[idx] = old_pi;
+
+            auto grad_ = (loss1-loss2) / (2*delta);
+            auto diff = abs(grad - grad_);
+            assert(diff < delta);
+            printf("%zu steps, %dth gradient check passed\n", num_steps, k);
+        }
+    }
+
+    return 0;
+}
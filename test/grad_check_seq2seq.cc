@@ -0,0 +1,68 @@
+#include "galois/models.h"
+#include <cstdlib>
+#include <cassert>
+#include <cmath>
+
+using namespace std;
+using namespace gs;
+
+int main()
+{
+    using T = double;
+
+    size_t len_encoder = 6;
+    size_t len_decoder = 5;
+    size_t vocab_size = 7;
+
+    int batch_size = 3;
+    int num_epoch = 1;
+    T learning_rate = 0.01;
+    SeqEncoderDecoder<T> model(len_encoder, len_decoder, vocab_size, vocab_size, {8, 6},
+                               batch_size, num_epoch, learning_rate, "sgd");
+    model.add_bucket(4, 4);
+
+    // the sentence is shorter than its bucket, so padded steps are masked
+    auto X = make_shared<NArray<T>>(1, len_encoder);
+    auto Y = make_shared<NArray<T>>(1, len_decoder);
+    X->fill(0);
+    Y->fill(0);
+    srand(time(NULL));
+    for (size_t i = 0; i < 3; i++) {
+        X->get_data()[i] = 1 + rand() % (vocab_size-1);
+    }
+    for (size_t i = 0; i < 2; i++) {
+        Y->get_data()[i] = 1 + rand() % (vocab_size-1);
+    }
+    model.add_train_dataset(X, Y);
+
+    auto params = model.get_params();
+    auto grads = model.get_grads();
+
+    for (int k = 0; k < 20; k++) {
+        int idx;
+        idx = rand() % params.size();
+        auto p = params[idx];
+        auto dp = grads[idx];
+
+        idx = rand() % p->get_size();
+
+        auto old_pi = p->get_data()[idx];
+        T delta = 1e-5;
+        model.train_one_batch(false);
+        auto grad = dp->get_data()[idx];
+
+        p->get_data()[idx] = old_pi + delta;
+        auto loss1 = model.train_one_batch(false);
+
+        p->get_data()[idx] = old_pi - delta;
+        auto loss2 = model.train_one_batch(false);
+        p->get_data()[idx] = old_pi;
+
+        auto grad_ = (loss1-loss2) / (2*delta);
+        auto diff = abs(grad - grad_);
+        assert(diff < delta);
+        printf("%dth gradient check passed\n", k);
+    }
+
+    return 0;
+}
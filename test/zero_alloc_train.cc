@@ -0,0 +1,92 @@
+#include "galois/models.h"
+#include "galois/filters.h"
+#include <cstdlib>
+#include <cassert>
+#include <new>
+#include <atomic>
+
+using namespace std;
+using namespace gs;
+
+// every allocation through operator new is counted while counting is on, on any thread,
+// such as the worker of a prefetcher
+static atomic<bool> counting(false);
+static atomic<size_t> num_allocs(0);
+
+void* operator new(size_t size) {
+    if (counting) {
+        num_allocs++;
+    }
+    void *p = malloc(size ? size : 1);
+    if (!p) {
+        throw bad_alloc();
+    }
+    return p;
+}
+void* operator new[](size_t size) { return operator new(size); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+template<typename STEP>
+size_t allocs_of(STEP step, int warmup, int steps) {
+    for (int k = 0; k < warmup; k++) {
+        step(k);
+    }
+    num_allocs = 0;
+    counting = true;
+    for (int k = warmup; k < warmup + steps; k++) {
+        step(k);
+    }
+    counting = false;
+    return num_allocs.load();
+}
+
+int main()
+{
+    using T = float;
+    size_t n = 200;
+    size_t vocab = 20;
+
+    auto X = make_shared<NArray<T>>(n, vocab);
+    X->uniform(-1, 1);
+    auto Y = make_shared<NArray<T>>(n);
+    for (size_t i = 0; i < n; i++) {
+        Y->get_data()[i] = i % 4;
+    }
+    // the default model and one gathering its batches in background
+    for (bool prefetch : {false, true}) {
+        Model<T> model(10, 1, 0.1, "adam");
+        model.add_link("x", "raw_h", make_shared<Linear<T>>(vocab, 16));
+        model.add_link("raw_h", "h", make_shared<Tanh<T>>());
+        model.add_link("h", "raw_y", make_shared<Linear<T>>(16, 4));
+        model.add_link("raw_y", "predictions", make_shared<CrossEntropy<T>>());
+        model.add_input_ids("x");
+        model.add_output_ids("predictions");
+        model.add_train_dataset(X, Y);
+        model.compile();
+        if (prefetch) {
+            model.enable_prefetch();
+        }
+        auto model_allocs = allocs_of([&](int) { model.train_one_batch(); }, 3, 10);
+        printf("%s model: %zu allocations in 10 steps\n", prefetch ? "prefetching" : "default", model_allocs);
+        assert(model_allocs == 0);
+    }
+
+    auto seq_X = make_shared<NArray<T>>(n);
+    auto seq_Y = make_shared<NArray<T>>(n);
+    for (size_t i = 0; i < n; i++) {
+        seq_X->get_data()[i] = i % vocab;
+        seq_Y->get_data()[i] = (i*7) % vocab;
+    }
+    for (bool stateful : {false, true}) {
+        RNN<T> rnn(8, vocab, vocab, {16, 16}, 10, 1, 0.1, "sgd", true, stateful);
+        rnn.add_train_dataset(seq_X, seq_Y);
+        auto rnn_allocs = allocs_of([&](int k) { rnn.train_one_batch(stateful ? k % 2 * 8 : k); }, 3, 10);
+        printf("%s rnn: %zu allocations in 10 steps\n", stateful ? "stateful" : "stateless", rnn_allocs);
+        assert(rnn_allocs == 0);
+    }
+
+    return 0;
+}